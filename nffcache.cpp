@@ -0,0 +1,272 @@
+//---------------------------------------------------------------------------
+// nffcache.cpp
+// Binary cache of scenes read from NFF files.
+//---------------------------------------------------------------------------
+
+#include "nffcache.h"
+
+// standard headers
+#include <cstdio>
+#include <cstring>
+
+static const char _magic[4] = { 'N', 'F', 'F', 'C' };
+
+template <typename T>
+static void
+_append(std::vector<char> &buffer, const T &value)
+{
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void
+_copyVec(float *dest, const nff_vec3 &v)
+{
+  dest[0] = v.x; dest[1] = v.y; dest[2] = v.z;
+}
+
+static void
+_copyCol(float *dest, const nff_col3 &c)
+{
+  dest[0] = c.r; dest[1] = c.g; dest[2] = c.b;
+}
+
+NFFCache::NFFCache():
+  _mapping(NULL), _mappingSize(0), _header(NULL), _materials(NULL), _lightGroups(NULL),
+  _pointLights(NULL), _triangles(NULL), _spheres(NULL)
+{
+}
+
+NFFCache::~NFFCache()
+{
+  Close();
+}
+
+bool
+NFFCache::Open(const char *cacheName, uint64_t sourceHash)
+{
+  Close();
+  _mapping = MapNFFFile(cacheName, _mappingSize);
+  if (!_mapping)
+    return false;
+  if (!_use(static_cast<const char *>(_mapping), _mappingSize, sourceHash)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool
+NFFCache::Attach(const std::vector<char> &buffer, uint64_t sourceHash)
+{
+  Close();
+  return _use(buffer.data(), buffer.size(), sourceHash);
+}
+
+void
+NFFCache::Close()
+{
+  if (_mapping)
+    UnmapNFFFile(_mapping, _mappingSize);
+  _mapping = NULL;
+  _mappingSize = 0;
+  _header = NULL;
+}
+
+bool
+NFFCache::_use(const char *data, size_t size, uint64_t sourceHash)
+{
+  if (size < sizeof(NFFCacheHeader))
+    return false;
+
+  const NFFCacheHeader *header = reinterpret_cast<const NFFCacheHeader *>(data);
+  if (memcmp(header->magic, _magic, sizeof(_magic)) != 0 || header->version != NFF_CACHE_VERSION || header->sourceHash != sourceHash)
+    return false;
+
+  // sizes are summed in 64 bits so that damaged counts cannot overflow them
+  const uint64_t expected = sizeof(NFFCacheHeader)
+    + (uint64_t)header->materialCount * sizeof(NFFCacheMaterial)
+    + (uint64_t)header->lightGroupCount * sizeof(NFFCacheLightGroup)
+    + (uint64_t)header->pointLightCount * sizeof(NFFCachePointLight)
+    + (uint64_t)header->triangleCount * sizeof(NFFCacheTriangle)
+    + (uint64_t)header->sphereCount * sizeof(NFFCacheSphere);
+  if (expected != size || memchr(header->hdrName, 0, sizeof(header->hdrName)) == NULL)
+    return false;
+
+  const char *next = data + sizeof(NFFCacheHeader);
+  const NFFCacheMaterial *materials = reinterpret_cast<const NFFCacheMaterial *>(next);
+  next += header->materialCount * sizeof(NFFCacheMaterial);
+  const NFFCacheLightGroup *lightGroups = reinterpret_cast<const NFFCacheLightGroup *>(next);
+  next += header->lightGroupCount * sizeof(NFFCacheLightGroup);
+  _pointLights = reinterpret_cast<const NFFCachePointLight *>(next);
+  next += header->pointLightCount * sizeof(NFFCachePointLight);
+  _triangles = reinterpret_cast<const NFFCacheTriangle *>(next);
+  next += header->triangleCount * sizeof(NFFCacheTriangle);
+  _spheres = reinterpret_cast<const NFFCacheSphere *>(next);
+
+  // ranges have to stay within the arrays
+  for (uint32_t i = 0; i < header->materialCount; i++) {
+    const NFFCacheMaterial &m = materials[i];
+    if ((uint64_t)m.firstTriangle + m.triangleCount > header->triangleCount || (uint64_t)m.firstSphere + m.sphereCount > header->sphereCount)
+      return false;
+  }
+  for (uint32_t i = 0; i < header->lightGroupCount; i++) {
+    const NFFCacheLightGroup &g = lightGroups[i];
+    if ((uint64_t)g.firstTriangle + g.triangleCount > header->triangleCount)
+      return false;
+  }
+
+  _header = header;
+  _materials = materials;
+  _lightGroups = lightGroups;
+  return true;
+}
+
+std::vector<char>
+NFFCache::Serialize(const NFFStore &store, const std::string &hdrName, uint64_t sourceHash)
+{
+  NFFCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.sourceHash = sourceHash;
+  _copyCol(header.background, store.bg_col);
+  _copyVec(header.from, store.from);
+  _copyVec(header.at, store.at);
+  _copyVec(header.up, store.up);
+  header.angle = store.angle;
+  header.hither = store.hither;
+  header.width = store.width;
+  header.height = store.height;
+  strncpy(header.hdrName, hdrName.c_str(), sizeof(header.hdrName) - 1);
+
+  std::vector<NFFCacheMaterial> materials;
+  std::vector<NFFCacheLightGroup> lightGroups;
+  std::vector<NFFCachePointLight> pointLights;
+  std::vector<NFFCacheTriangle> triangles;
+  std::vector<NFFCacheSphere> spheres;
+
+  NFFCacheTriangle triangle;
+  NFFStore::TMatGroupList::const_iterator giter = store.matgroups.begin();
+  for (; giter != store.matgroups.end(); ++giter) {
+    const NFFStore::Material &m = giter->material;
+    NFFCacheMaterial material;
+    _copyCol(material.col, m.col);
+    material.kd = m.kd; material.ks = m.ks; material.shine = m.shine; material.T = m.T; material.ior = m.ior;
+
+    material.firstTriangle = (uint32_t)triangles.size();
+    NFFStore::TriangleList::const_iterator titer = giter->geometry.begin();
+    for (; titer != giter->geometry.end(); ++titer) {
+      for (int i = 0; i < 3; i++)
+        _copyVec(triangle.vertices[i], titer->vertices[i]);
+      triangles.push_back(triangle);
+    }
+    material.triangleCount = (uint32_t)triangles.size() - material.firstTriangle;
+
+    material.firstSphere = (uint32_t)spheres.size();
+    NFFStore::SphereList::const_iterator siter = giter->spheres.begin();
+    for (; siter != giter->spheres.end(); ++siter) {
+      NFFCacheSphere sphere;
+      _copyVec(sphere.center, siter->center);
+      sphere.radius = siter->radius;
+      spheres.push_back(sphere);
+    }
+    material.sphereCount = (uint32_t)spheres.size() - material.firstSphere;
+    materials.push_back(material);
+  }
+
+  std::list<NFFStore::PointLight>::const_iterator liter = store.pointLights.begin();
+  for (; liter != store.pointLights.end(); ++liter) {
+    NFFCachePointLight light;
+    _copyVec(light.position, liter->position);
+    _copyCol(light.intensity, liter->intensity);
+    pointLights.push_back(light);
+  }
+
+  NFFStore::TLightGroupList::const_iterator aliter = store.lightgroups.begin();
+  for (; aliter != store.lightgroups.end(); ++aliter) {
+    NFFCacheLightGroup group;
+    _copyCol(group.intensity, aliter->intensity);
+    _copyVec(group.atten, aliter->atten);
+    group.firstTriangle = (uint32_t)triangles.size();
+    NFFStore::TriangleList::const_iterator titer = aliter->geometry.begin();
+    for (; titer != aliter->geometry.end(); ++titer) {
+      for (int i = 0; i < 3; i++)
+        _copyVec(triangle.vertices[i], titer->vertices[i]);
+      triangles.push_back(triangle);
+    }
+    group.triangleCount = (uint32_t)triangles.size() - group.firstTriangle;
+    lightGroups.push_back(group);
+  }
+
+  return Pack(header, materials, lightGroups, pointLights, triangles, spheres);
+}
+
+std::vector<char>
+NFFCache::Pack(NFFCacheHeader header, const std::vector<NFFCacheMaterial> &materials,
+               const std::vector<NFFCacheLightGroup> &lightGroups, const std::vector<NFFCachePointLight> &pointLights,
+               const std::vector<NFFCacheTriangle> &triangles, const std::vector<NFFCacheSphere> &spheres)
+{
+  memcpy(header.magic, _magic, sizeof(_magic));
+  header.version = NFF_CACHE_VERSION;
+  header.materialCount = (uint32_t)materials.size();
+  header.lightGroupCount = (uint32_t)lightGroups.size();
+  header.pointLightCount = (uint32_t)pointLights.size();
+  header.triangleCount = (uint32_t)triangles.size();
+  header.sphereCount = (uint32_t)spheres.size();
+
+  std::vector<char> buffer;
+  buffer.reserve(sizeof(header) + materials.size() * sizeof(NFFCacheMaterial) + lightGroups.size() * sizeof(NFFCacheLightGroup)
+                 + pointLights.size() * sizeof(NFFCachePointLight) + triangles.size() * sizeof(NFFCacheTriangle)
+                 + spheres.size() * sizeof(NFFCacheSphere));
+  _append(buffer, header);
+  for (size_t i = 0; i < materials.size(); i++) _append(buffer, materials[i]);
+  for (size_t i = 0; i < lightGroups.size(); i++) _append(buffer, lightGroups[i]);
+  for (size_t i = 0; i < pointLights.size(); i++) _append(buffer, pointLights[i]);
+  for (size_t i = 0; i < triangles.size(); i++) _append(buffer, triangles[i]);
+  for (size_t i = 0; i < spheres.size(); i++) _append(buffer, spheres[i]);
+  return buffer;
+}
+
+bool
+NFFCache::Write(const char *cacheName, const std::vector<char> &buffer)
+{
+  // written under a temporary name first, so that a reader never maps a partial cache
+  std::string tempName = std::string(cacheName) + ".tmp";
+  FILE *fout = fopen(tempName.c_str(), "wb");
+  if (!fout)
+    return false;
+  bool ok = fwrite(buffer.data(), 1, buffer.size(), fout) == buffer.size();
+  ok = (fclose(fout) == 0) && ok;
+  if (ok) {
+    remove(cacheName);
+    ok = rename(tempName.c_str(), cacheName) == 0;
+  }
+  if (!ok)
+    remove(tempName.c_str());
+  return ok;
+}
+
+bool
+NFFCache::HashFile(const char *fileName, uint64_t &hash)
+{
+  hash = 14695981039346656037ull;
+
+  size_t size = 0;
+  void *data = MapNFFFile(fileName, size);
+  if (!data) {
+    // empty files cannot be mapped
+    FILE *fin = fopen(fileName, "rb");
+    if (!fin)
+      return false;
+    bool empty = fgetc(fin) == EOF;
+    fclose(fin);
+    return empty;
+  }
+
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  UnmapNFFFile(data, size);
+  return true;
+}
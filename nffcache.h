@@ -0,0 +1,133 @@
+//---------------------------------------------------------------------------
+// nffcache.h
+// Binary cache of scenes read from NFF files.
+//---------------------------------------------------------------------------
+
+#ifndef __NFFCACHE_H__
+#define __NFFCACHE_H__
+
+// standard headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// project headers
+#include "nffstore.h"
+
+/// Version of the layout below, caches of other versions are ignored and written again
+#define NFF_CACHE_VERSION 1
+
+/// Header at the start of a cache file, followed by the arrays it counts in this order:
+/// materials, light groups, point lights, triangles and spheres. Triangles of the
+/// materials come first, then the ones of the light groups. All values are 4-byte
+/// aligned so that the arrays are used in place of a mapped file.
+struct NFFCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  /// hash of the NFF file the cache was made of
+  uint64_t sourceHash;
+
+  uint32_t materialCount;
+  uint32_t lightGroupCount;
+  uint32_t pointLightCount;
+  uint32_t triangleCount;
+  uint32_t sphereCount;
+
+  float background[3];
+  float from[3], at[3], up[3];
+  float angle, hither;
+  int32_t width, height;
+  /// HDR environment map, empty if the scene has none
+  char hdrName[256];
+};
+
+/// material with the ranges of triangles and spheres it is assigned to
+struct NFFCacheMaterial
+{
+  float col[3];
+  float kd, ks, shine, T, ior;
+  uint32_t firstTriangle, triangleCount;
+  uint32_t firstSphere, sphereCount;
+};
+
+/// emissive material with the range of triangles it is assigned to
+struct NFFCacheLightGroup
+{
+  float intensity[3];
+  float atten[3];
+  uint32_t firstTriangle, triangleCount;
+};
+
+struct NFFCachePointLight
+{
+  float position[3];
+  float intensity[3];
+};
+
+struct NFFCacheTriangle
+{
+  float vertices[3][3];
+};
+
+struct NFFCacheSphere
+{
+  float center[3];
+  float radius;
+};
+
+/// Flattened scene of an NFF file, read without parsing from a memory mapped cache file.
+/** The cache is keyed by a hash of the NFF file, a cache of a changed file is stale and
+    replaced by parsing the file again. */
+class NFFCache
+{
+public:
+  NFFCache();
+  ~NFFCache();
+
+  /// Maps the cache file. Fails if it is missing, damaged, of another version or not made
+  /// of the NFF file with the given hash
+  bool Open(const char *cacheName, uint64_t sourceHash);
+  /// Uses a cache made by Serialize in place, the buffer has to outlive the cache
+  bool Attach(const std::vector<char> &buffer, uint64_t sourceHash);
+  /// Unmaps the file of the cache
+  void Close();
+
+  const NFFCacheHeader &Header() const { return *_header; }
+  const NFFCacheMaterial *Materials() const { return _materials; }
+  const NFFCacheLightGroup *LightGroups() const { return _lightGroups; }
+  const NFFCachePointLight *PointLights() const { return _pointLights; }
+  const NFFCacheTriangle *Triangles() const { return _triangles; }
+  const NFFCacheSphere *Spheres() const { return _spheres; }
+
+  /// Flattens the scene read by the store (with untesselated spheres) into a cache
+  static std::vector<char> Serialize(const NFFStore &store, const std::string &hdrName, uint64_t sourceHash);
+  /// Lays out a cache of the arrays, the header is completed by their counts
+  static std::vector<char> Pack(NFFCacheHeader header, const std::vector<NFFCacheMaterial> &materials,
+                                const std::vector<NFFCacheLightGroup> &lightGroups, const std::vector<NFFCachePointLight> &pointLights,
+                                const std::vector<NFFCacheTriangle> &triangles, const std::vector<NFFCacheSphere> &spheres);
+  static bool Write(const char *cacheName, const std::vector<char> &buffer);
+  /// 64-bit FNV-1a hash of the file contents
+  static bool HashFile(const char *fileName, uint64_t &hash);
+
+private:
+  NFFCache(const NFFCache &);
+  NFFCache &operator=(const NFFCache &);
+
+  /// Checks the header and the sizes of the arrays, then points the accessors into data
+  bool _use(const char *data, size_t size, uint64_t sourceHash);
+
+  /// mapped file, NULL for attached buffers
+  void *_mapping;
+  size_t _mappingSize;
+
+  const NFFCacheHeader *_header;
+  const NFFCacheMaterial *_materials;
+  const NFFCacheLightGroup *_lightGroups;
+  const NFFCachePointLight *_pointLights;
+  const NFFCacheTriangle *_triangles;
+  const NFFCacheSphere *_spheres;
+};
+
+#endif // __NFFCACHE_H__
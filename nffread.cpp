@@ -8,10 +8,24 @@
 #include "nffread.h"
 
 // standard headers
+#include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <cstdint>
 #include <cstring>
+#include <string>
+#include <thread>
 #include <vector>
 
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
 static void
 _getNextToken(FILE* fin,char *nexttok)
 {
@@ -274,3 +288,551 @@ ReadNFF(FILE *fin, char *errstring, NFFCallbacks *callbacks)
     }
  }
 }
+
+//---------------------------------------------------------------------------
+// Memory mapped reader
+//---------------------------------------------------------------------------
+
+/// sequences of at least this many polygons / patches are split among threads
+#define NFF_PARALLEL_POLYGONS 4096
+
+void *
+MapNFFFile(const char *fileName, size_t &size)
+{
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return NULL;
+  LARGE_INTEGER fileSize;
+  void *data = NULL;
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+    size = (size_t)fileSize.QuadPart;
+  }
+  CloseHandle(file);
+  return data;
+#else
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  void *data = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+      data = NULL;
+    size = (size_t)st.st_size;
+  }
+  // the mapping stays valid after the file is closed
+  close(fd);
+  return data;
+#endif
+}
+
+void
+UnmapNFFFile(void *data, size_t size)
+{
+#ifdef _WIN32
+  (void)size;
+  UnmapViewOfFile(data);
+#else
+  munmap(data, size);
+#endif
+}
+
+/// position in a mapped file, which is not terminated
+struct _Scanner
+{
+  const char *p;
+  const char *end;
+};
+
+static inline bool
+_isSpace(char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline bool
+_isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+/// skip white space and comments running from '#' to the end of the line
+static void
+_skipSpace(_Scanner &s)
+{
+  while (s.p < s.end) {
+    if (_isSpace(*s.p))
+      s.p++;
+    else if (*s.p == '#')
+      while (s.p < s.end && *s.p != '\n') s.p++;
+    else
+      return;
+  }
+}
+
+/// next run of non-white characters, false at the end of the file
+static bool
+_scanToken(_Scanner &s, const char *&token, size_t &length)
+{
+  _skipSpace(s);
+  token = s.p;
+  while (s.p < s.end && !_isSpace(*s.p)) s.p++;
+  length = s.p - token;
+  return length > 0;
+}
+
+/// literal text, as a format string of fscanf matches it
+static bool
+_scanKeyword(_Scanner &s, const char *keyword)
+{
+  _skipSpace(s);
+  const size_t length = strlen(keyword);
+  if ((size_t)(s.end - s.p) < length || memcmp(s.p, keyword, length) != 0)
+    return false;
+  s.p += length;
+  return true;
+}
+
+static bool
+_scanInt(_Scanner &s, int &value)
+{
+  _skipSpace(s);
+  const char *p = s.p;
+  if (p < s.end && *p == '+') p++;
+  std::from_chars_result result = std::from_chars(p, s.end, value);
+  if (result.ec != std::errc())
+    return false;
+  s.p = result.ptr;
+  return true;
+}
+
+/// powers of ten represented exactly by a double
+static const double _pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/// number in the format of %g, read independently of the locale.
+/**
+  Decimal numbers of up to 19 significant digits and exponents small enough for the
+  power of ten to be exact are computed in double precision, which rounds them correctly,
+  and then rounded to float. That gives the correctly rounded float unless the double
+  lies exactly halfway between two floats. Such numbers and all others (long mantissas,
+  large exponents, infinities, NaNs) are left to std::from_chars.
+*/
+static bool
+_scanFloat(_Scanner &s, float &value)
+{
+  _skipSpace(s);
+  const char *p = s.p;
+  bool negative = false;
+  if (p < s.end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  const char *start = p;
+
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; p < s.end && _isDigit(*p); p++) {
+    any = true;
+    if (mantissa == 0 && *p == '0')
+      continue;
+    if (digits < 19)
+      mantissa = mantissa * 10 + (*p - '0');
+    else
+      exponent++;
+    digits++;
+  }
+  if (p < s.end && *p == '.') {
+    for (p++; p < s.end && _isDigit(*p); p++) {
+      any = true;
+      if (mantissa == 0 && *p == '0') {
+        exponent--;
+        continue;
+      }
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+      digits++;
+    }
+  }
+
+  bool fast = any && digits <= 19;
+  if (any && p < s.end && (*p == 'e' || *p == 'E')) {
+    const char *e = p + 1;
+    bool negativeExponent = false;
+    if (e < s.end && (*e == '-' || *e == '+')) {
+      negativeExponent = *e == '-';
+      e++;
+    }
+    if (e < s.end && _isDigit(*e)) {
+      int written = 0;
+      for (; e < s.end && _isDigit(*e); e++)
+        if (written < 10000) written = written * 10 + (*e - '0');
+      exponent += negativeExponent ? -written : written;
+      p = e;
+    }
+  }
+
+  if (fast && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+    double d = (double)mantissa;
+    d = exponent < 0 ? d / _pow10[-exponent] : d * _pow10[exponent];
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    // doubles within the normal range of floats keep 29 more mantissa bits, exactly half of
+    // them set is a tie of the second rounding
+    const bool normal = d == 0 || (d >= 1.1754943508222875e-38 && d <= 3.4028234663852886e+38);
+    if (normal && (bits & 0x1fffffffull) != 0x10000000ull) {
+      value = negative ? -(float)d : (float)d;
+      s.p = p;
+      return true;
+    }
+  }
+
+  // from_chars would accept a second minus sign
+  if (start == s.end || *start == '-' || *start == '+')
+    return false;
+  std::from_chars_result result = std::from_chars(start, s.end, value);
+  if (result.ec != std::errc() && result.ec != std::errc::result_out_of_range)
+    return false;
+  if (negative)
+    value = -value;
+  s.p = result.ptr;
+  return true;
+}
+
+static bool
+_scanVec(_Scanner &s, nff_vec3 &v)
+{
+  return _scanFloat(s, v.x) && _scanFloat(s, v.y) && _scanFloat(s, v.z);
+}
+
+/// number of values read, the way fscanf counts them
+static int
+_scanFloats(_Scanner &s, float *const *values, int count)
+{
+  for (int i = 0; i < count; i++)
+    if (!_scanFloat(s, *values[i]))
+      return i;
+  return count;
+}
+
+static bool
+_scanPolygon(_Scanner &s, bool patch, int num, nff_vec3 *vertices, nff_vec3 *normals, char *errstring)
+{
+  for (int i = 0; i < num; i++) {
+    if (!_scanVec(s, vertices[i])) {
+      sprintf(errstring, "Could not read polygon / patch vertex #%d.", i);
+      return false;
+    }
+    if (patch && !_scanVec(s, normals[i])) {
+      sprintf(errstring, "Could not read polygon / patch normal #%d.", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+/// polygon / patch of a sequence parsed by several threads
+struct _Polygon
+{
+  const char *data;
+  int num;
+  bool patch;
+  /// first vertex (and normal) in the arrays of the sequence
+  size_t first;
+};
+
+/// parse a sequence of polygons / patches, starting at the current one, on several threads.
+/**
+  The sequence is delimited first by skipping over the tokens of its polygons, the threads
+  then read the numbers of their part of it. Callbacks follow in order once all is read.
+  @param serialEnd end of a sequence too short to pay off, to be read serially
+  @return 0 if the sequence is too short, when nothing has been read
+*/
+static int
+_readPolygons(_Scanner &s, char *errstring, NFFCallbacks *callbacks, int threads, const char *&serialEnd)
+{
+  std::vector<_Polygon> polygons;
+  size_t total = 0;
+  _Scanner next = s;
+  while (1) {
+    const _Scanner start = next;
+    const char *token;
+    size_t length;
+    int num;
+    if (!_scanToken(next, token, length) || token[0] != 'p' || !_scanInt(next, num)) {
+      // a damaged count is reported by the serial reader
+      next = start;
+      break;
+    }
+
+    _Polygon polygon = { next.p, num, length > 1 && token[1] == 'p', total };
+    const int values = num > 0 ? num * (polygon.patch ? 6 : 3) : 0;
+    for (int i = 0; i < values && _scanToken(next, token, length); i++) {}
+    polygons.push_back(polygon);
+    total += num > 0 ? num : 0;
+  }
+
+  if (polygons.size() < NFF_PARALLEL_POLYGONS) {
+    serialEnd = next.p;
+    return 0;
+  }
+
+  std::vector<nff_vec3> vertices(total), normals(total);
+  // first polygon that could not be read by each thread, with its error
+  std::vector<size_t> failed(threads, polygons.size());
+  std::vector<std::string> errors(threads);
+
+  std::vector<std::thread> workers;
+  const size_t chunk = (polygons.size() + threads - 1) / threads;
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      char error[4000];
+      const size_t last = std::min(polygons.size(), (t + 1) * chunk);
+      for (size_t i = t * chunk; i < last; i++) {
+        const _Polygon &polygon = polygons[i];
+        _Scanner ps = { polygon.data, s.end };
+        if (!_scanPolygon(ps, polygon.patch, polygon.num, &vertices[polygon.first], &normals[polygon.first], error)) {
+          failed[t] = i;
+          errors[t] = error;
+          return;
+        }
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+
+  std::vector<nff_vec3> polygonVertices, polygonNormals;
+  for (size_t i = 0; i < polygons.size(); i++) {
+    for (int t = 0; t < threads; t++) {
+      if (failed[t] == i) {
+        strcpy(errstring, errors[t].c_str());
+        return -1;
+      }
+    }
+
+    const _Polygon &polygon = polygons[i];
+    if (polygon.num <= 0)
+      continue;
+    polygonVertices.assign(vertices.begin() + polygon.first, vertices.begin() + polygon.first + polygon.num);
+    if (polygon.patch)
+      polygonNormals.assign(normals.begin() + polygon.first, normals.begin() + polygon.first + polygon.num);
+    else
+      polygonNormals.clear();
+    callbacks->PolyPatch(polygonVertices, polygonNormals);
+  }
+
+  s = next;
+  return 1;
+}
+
+static int
+_readNFF(_Scanner &s, char *errstring, NFFCallbacks *callbacks, int threads)
+{
+  const char *token;
+  size_t length;
+  // polygons before this are not worth splitting among threads
+  const char *serialEnd = s.p;
+
+  while (1) {
+    const _Scanner start = s;
+    if (!_scanToken(s, token, length))
+      return 0;
+
+    switch (token[0]) {
+
+    case 'v':
+      {
+        nff_vec3 from, at, up;
+        float angle, hither;
+        int width, height;
+
+        if (!(_scanKeyword(s, "from") && _scanVec(s, from) &&
+              _scanKeyword(s, "at") && _scanVec(s, at) &&
+              _scanKeyword(s, "up") && _scanVec(s, up) &&
+              _scanKeyword(s, "angle") && _scanFloat(s, angle) &&
+              _scanKeyword(s, "hither") && _scanFloat(s, hither) &&
+              _scanKeyword(s, "resolution") && _scanInt(s, width) && _scanInt(s, height))) {
+          sprintf(errstring, "Could not read camera.");
+          return -1;
+        }
+
+        callbacks->Camera(from,at,up,angle,hither,width,height);
+      }
+      break;
+
+    case 'b':
+      {
+        nff_col3 col;
+        float *const values[] = { &col.r, &col.g, &col.b };
+        if (_scanFloats(s, values, 3) != 3) {
+          sprintf(errstring, "Could not read background.");
+          return -1;
+        }
+
+        callbacks->Background(col);
+      }
+      break;
+
+    case 'l':
+      {
+        nff_vec3 pos;
+        nff_col3 i;
+        float *const values[] = { &pos.x, &pos.y, &pos.z, &i.r, &i.g, &i.b };
+        int ret = _scanFloats(s, values, 6);
+        if ( ret != 6 && ret != 3 ) {
+          sprintf(errstring, "Could not read point light.");
+          return -1;
+        }
+
+        if(ret == 3)
+          i.r = i.g = i.b = 1.0;
+
+        callbacks->AddPointLight(pos,i);
+      }
+      break;
+
+    case 'B':
+      {
+        if (!_scanToken(s, token, length)) {
+          sprintf(errstring, "Could not read env map name.");
+          return -1;
+        }
+
+        callbacks->HDRBackground(std::string(token, length).c_str());
+      }
+      break;
+
+    case 'L':
+      {
+        nff_col3 i;
+        nff_vec3 atten(0, 0, 0);
+        float m;
+        float *const values[] = { &i.r, &i.g, &i.b, &m };
+        int ret = _scanFloats(s, values, 4);
+        if (ret == 4 && _scanKeyword(s, "atten")) {
+          float *const attenuation[] = { &atten.x, &atten.y, &atten.z };
+          ret += _scanFloats(s, attenuation, 3);
+        }
+
+        if ( ret != 4 && ret != 7 ) {
+          sprintf(errstring, "Could not read area light.");
+          return -1;
+        }
+
+        i.r *= m/M_PI;
+        i.g *= m/M_PI;
+        i.b *= m/M_PI;
+
+        if (ret == 4 && i.r == 0 && i.g == 0 && i.b == 0 && m == 0)
+          callbacks->AreaLightEnd();
+        else
+          callbacks->AreaLightBegin(i, atten);
+      }
+      break;
+
+    case 'f':
+      {
+        nff_col3 col;
+        float kd,ks,shine,T,ior;
+        float *const values[] = { &col.r, &col.g, &col.b, &kd, &ks, &shine, &T, &ior };
+        if (_scanFloats(s, values, 8) != 8) {
+          sprintf(errstring, "Could not read material.");
+          return -1;
+        }
+
+        callbacks->SetMaterial(col,kd,ks,shine,T,ior);
+      }
+      break;
+
+    case 's':
+      {
+        nff_vec3 c;
+        float    r;
+        if (!(_scanVec(s, c) && _scanFloat(s, r))) {
+          sprintf(errstring, "Could not read sphere.");
+          return -1;
+        }
+        callbacks->AddSphere(c,r);
+      }
+      break;
+
+    case 'p':
+      {
+        if (threads > 1 && start.p >= serialEnd) {
+          s = start;
+          int ret = _readPolygons(s, errstring, callbacks, threads, serialEnd);
+          if (ret < 0)
+            return ret;
+          if (ret > 0)
+            break;
+          // too few polygons for threads, read this one serially
+          _scanToken(s, token, length);
+        }
+
+        bool patch = length > 1 && token[1]=='p';
+        int num;
+        if (!_scanInt(s, num)) {
+          sprintf(errstring, "Could not read number of polygon / patch vertices.");
+          return -1;
+        }
+        if (num <= 0)
+          break;
+
+        std::vector<nff_vec3> vertices(num), normals(patch ? num : 0);
+        if (!_scanPolygon(s, patch, num, vertices.data(), normals.data(), errstring))
+          return -1;
+
+        callbacks->PolyPatch(vertices, normals);
+      }
+      break;
+
+    case '_':
+      return 0;
+
+    default:
+      sprintf(errstring, "Unknown nff command: %.*s ", (int)std::min<size_t>(length, 256), token);
+      return -1;
+    }
+  }
+}
+
+int
+ReadNFF(const char *fileName, char *errstring, NFFCallbacks *callbacks, int threads)
+{
+  size_t size = 0;
+  void *data = MapNFFFile(fileName, size);
+  if (!data) {
+    // empty files cannot be mapped and hold no scene
+    FILE *fin = fopen(fileName, "rb");
+    if (!fin) {
+      sprintf(errstring, "Could not open %s.", fileName);
+      return -1;
+    }
+    const bool empty = fgetc(fin) == EOF;
+    fclose(fin);
+    if (!empty) {
+      sprintf(errstring, "Could not map %s.", fileName);
+      return -1;
+    }
+    return 0;
+  }
+
+  _Scanner s = { static_cast<const char *>(data), static_cast<const char *>(data) + size };
+  int ret = _readNFF(s, errstring, callbacks, threads > 1 ? threads : 1);
+  UnmapNFFFile(data, size);
+  return ret;
+}
@@ -9,6 +9,7 @@
 #define __NFFREAD_H__
 
 // standard headers
+#include <cstddef>
 #include <cstdio>
 #include <vector>
 #include <cmath>
@@ -109,4 +110,24 @@ public:
 */
 int ReadNFF(FILE *fin, char *errstring, NFFCallbacks *callbacks);
 
+/// parse the NFF file 'fileName', memory mapped and tokenized in place.
+/**
+  Numbers are read without the C locale by a dedicated scanner, which makes this much faster
+  than reading from a stream. Callbacks are called from the calling thread in the order of
+  the file, exactly as by the stream version.
+  @param fileName name of the NFF file
+  @param errstring upon error, this contains error description
+  @param callbacks implementation of the CNFFCallbacks class, must not be NULL
+  @param threads number of threads parsing long sequences of polygons / patches
+  @return negative value if an error occurs
+*/
+int ReadNFF(const char *fileName, char *errstring, NFFCallbacks *callbacks, int threads = 1);
+
+/// map a whole file for reading.
+/** @return NULL if the file cannot be mapped, which is also the case for empty files */
+void *MapNFFFile(const char *fileName, size_t &size);
+
+/// unmap a file mapped by MapNFFFile
+void UnmapNFFFile(void *data, size_t size);
+
 #endif // __NFFREAD_H__
@@ -0,0 +1,255 @@
+//---------------------------------------------------------------------------
+// nffscene.cpp
+// Scenes of NFF files specified in the sgl context while they are parsed.
+//---------------------------------------------------------------------------
+
+#include "nffscene.h"
+
+// standard headers
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// project headers
+#include "sgl.h"
+
+static void
+_copyVec(float *dest, const nff_vec3 &v)
+{
+  dest[0] = v.x; dest[1] = v.y; dest[2] = v.z;
+}
+
+static void
+_copyCol(float *dest, const nff_col3 &c)
+{
+  dest[0] = c.r; dest[1] = c.g; dest[2] = c.b;
+}
+
+static void
+_specifyTriangles(const NFFCacheTriangle *triangles, uint32_t count)
+{
+  if (count > 0)
+    sglTriangles((int)count, &triangles[0].vertices[0][0]);
+}
+
+NFFScene::NFFScene(bool keepGeometry):
+  _keepGeometry(keepGeometry), _areaLightMode(false), _pendingMaterial(false)
+{
+  memset(&_header, 0, sizeof(_header));
+}
+
+void
+NFFScene::Background(const nff_col3 &col)
+{
+  _copyCol(_header.background, col);
+}
+
+void
+NFFScene::HDRBackground(const char *hdr_name)
+{
+  // the map itself is loaded by the application before the scene ends
+  strncpy(_header.hdrName, hdr_name, sizeof(_header.hdrName) - 1);
+}
+
+void
+NFFScene::Camera(
+  const nff_vec3 &from, const nff_vec3 &at, const nff_vec3 &up,
+  const float angle, const float hither,
+  int width, int height)
+{
+  _copyVec(_header.from, from);
+  _copyVec(_header.at, at);
+  _copyVec(_header.up, up);
+  _header.angle = angle;
+  _header.hither = hither;
+  _header.width = width;
+  _header.height = height;
+}
+
+void
+NFFScene::AddPointLight(const nff_vec3 &pos, const nff_col3 &intensity)
+{
+  NFFCachePointLight light;
+  _copyVec(light.position, pos);
+  _copyCol(light.intensity, intensity);
+  if (_keepGeometry)
+    _pointLights.push_back(light);
+  sglPointLight(pos.x, pos.y, pos.z, intensity.r, intensity.g, intensity.b);
+}
+
+void
+NFFScene::SetMaterial(const nff_col3 &col, float kd, float ks, float shine, float T, float ior)
+{
+  _flushMaterial();
+
+  NFFCacheMaterial material;
+  _copyCol(material.col, col);
+  material.kd = kd; material.ks = ks; material.shine = shine; material.T = T; material.ior = ior;
+  material.firstTriangle = (uint32_t)_triangles.size();
+  material.triangleCount = 0;
+  material.firstSphere = (uint32_t)_spheres.size();
+  material.sphereCount = 0;
+  _materials.push_back(material);
+  _pendingMaterial = true;
+}
+
+void
+NFFScene::AddSphere(const nff_vec3 &c, float r)
+{
+  // default materials (in case material not specified)
+  if (_materials.empty())
+    SetMaterial(nff_col3(1,1,1),0.7,0.0,32,0,1);
+
+  NFFCacheSphere sphere;
+  _copyVec(sphere.center, c);
+  sphere.radius = r;
+  _spheres.push_back(sphere);
+  _materials.back().sphereCount++;
+}
+
+void
+NFFScene::PolyPatch(const std::vector<nff_vec3> &vertices, const std::vector<nff_vec3> & /* normals */)
+{
+  // sanity check
+  if (vertices.size() < 3) return;
+
+  if (_areaLightMode) {
+    _triangulateInto(_lightTriangles, vertices);
+    NFFCacheLightGroup &group = _lightGroups.back();
+    group.triangleCount = (uint32_t)_lightTriangles.size() - group.firstTriangle;
+  } else {
+    // default materials (in case material not specified)
+    if (_materials.empty())
+      SetMaterial(nff_col3(1,1,1),0.7,0.0,32,0,1);
+
+    _triangulateInto(_triangles, vertices);
+    NFFCacheMaterial &material = _materials.back();
+    material.triangleCount = (uint32_t)_triangles.size() - material.firstTriangle;
+  }
+}
+
+void
+NFFScene::AreaLightBegin(const nff_col3 &intensity, const nff_vec3 &atten)
+{
+  NFFCacheLightGroup group;
+  _copyCol(group.intensity, intensity);
+  _copyVec(group.atten, atten);
+  group.firstTriangle = (uint32_t)_lightTriangles.size();
+  group.triangleCount = 0;
+  _lightGroups.push_back(group);
+  _areaLightMode = true;
+}
+
+void
+NFFScene::AreaLightEnd()
+{
+  _areaLightMode = false;
+}
+
+void
+NFFScene::Finish()
+{
+  _flushMaterial();
+
+  for (size_t g = 0; g < _lightGroups.size(); g++) {
+    const NFFCacheLightGroup &l = _lightGroups[g];
+    sglEmissiveMaterial(l.intensity[0], l.intensity[1], l.intensity[2], l.atten[0], l.atten[1], l.atten[2]);
+    _specifyTriangles(_lightTriangles.data() + l.firstTriangle, l.triangleCount);
+  }
+  if (!_keepGeometry) {
+    _lightGroups.clear();
+    _lightTriangles.clear();
+  }
+}
+
+std::vector<char>
+NFFScene::Serialize(uint64_t sourceHash) const
+{
+  assert(_keepGeometry);
+
+  NFFCacheHeader header = _header;
+  header.sourceHash = sourceHash;
+
+  // emissive triangles follow the ones of the materials
+  std::vector<NFFCacheTriangle> triangles(_triangles);
+  triangles.insert(triangles.end(), _lightTriangles.begin(), _lightTriangles.end());
+  std::vector<NFFCacheLightGroup> lightGroups(_lightGroups);
+  for (size_t g = 0; g < lightGroups.size(); g++)
+    lightGroups[g].firstTriangle += (uint32_t)_triangles.size();
+
+  return NFFCache::Pack(header, _materials, lightGroups, _pointLights, triangles, _spheres);
+}
+
+void
+NFFScene::Replay(const NFFCache &cache)
+{
+  const NFFCacheHeader &header = cache.Header();
+
+  for (uint32_t g = 0; g < header.materialCount; g++) {
+    const NFFCacheMaterial &m = cache.Materials()[g];
+    sglMaterial(m.col[0], m.col[1], m.col[2], m.kd, m.ks, m.shine, m.T, m.ior);
+    _specifyTriangles(cache.Triangles() + m.firstTriangle, m.triangleCount);
+    const NFFCacheSphere *spheres = cache.Spheres() + m.firstSphere;
+    for (uint32_t i = 0; i < m.sphereCount; i++)
+      sglSphere(spheres[i].center[0], spheres[i].center[1], spheres[i].center[2], spheres[i].radius);
+  }
+
+  for (uint32_t i = 0; i < header.pointLightCount; i++) {
+    const NFFCachePointLight &l = cache.PointLights()[i];
+    sglPointLight(l.position[0], l.position[1], l.position[2], l.intensity[0], l.intensity[1], l.intensity[2]);
+  }
+
+  for (uint32_t g = 0; g < header.lightGroupCount; g++) {
+    const NFFCacheLightGroup &l = cache.LightGroups()[g];
+    sglEmissiveMaterial(l.intensity[0], l.intensity[1], l.intensity[2], l.atten[0], l.atten[1], l.atten[2]);
+    _specifyTriangles(cache.Triangles() + l.firstTriangle, l.triangleCount);
+  }
+}
+
+void
+NFFScene::_flushMaterial()
+{
+  if (!_pendingMaterial)
+    return;
+
+  const NFFCacheMaterial &m = _materials.back();
+  sglMaterial(m.col[0], m.col[1], m.col[2], m.kd, m.ks, m.shine, m.T, m.ior);
+  _specifyTriangles(_triangles.data() + m.firstTriangle, m.triangleCount);
+  const NFFCacheSphere *spheres = _spheres.data() + m.firstSphere;
+  for (uint32_t i = 0; i < m.sphereCount; i++)
+    sglSphere(spheres[i].center[0], spheres[i].center[1], spheres[i].center[2], spheres[i].radius);
+  _pendingMaterial = false;
+
+  if (!_keepGeometry) {
+    // the buffers start over with the next material
+    _triangles.clear();
+    _spheres.clear();
+  }
+}
+
+void
+NFFScene::_triangulateInto(std::vector<NFFCacheTriangle> &dest, const std::vector<nff_vec3> &vertices)
+{
+  if (vertices.size() > 4) {
+    fprintf(stdout,"Cannot triangulate polygons with more than 4 vertices.\n");
+    exit(2);
+  }
+
+  // same split as NFFStore, along the shorter diagonal of a quad
+  int indices[6] = { 0, 1, 2, -1, -1, -1 };
+  if (vertices.size() == 4) {
+    float d1 = sqrdist(vertices[0],vertices[2]);
+    float d2 = sqrdist(vertices[1],vertices[3]);
+    const int split1[6] = { 0, 1, 2, 0, 2, 3 };
+    const int split2[6] = { 0, 1, 3, 1, 2, 3 };
+    memcpy(indices, d1 < d2 ? split1 : split2, sizeof(indices));
+  }
+
+  NFFCacheTriangle triangle;
+  for (int t = 0; t < 2 && indices[3 * t] >= 0; t++) {
+    for (int i = 0; i < 3; i++)
+      _copyVec(triangle.vertices[i], vertices[indices[3 * t + i]]);
+    dest.push_back(triangle);
+  }
+}
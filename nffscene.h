@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------
+// nffscene.h
+// Scenes of NFF files specified in the sgl context while they are parsed.
+//---------------------------------------------------------------------------
+
+#ifndef __NFFSCENE_H__
+#define __NFFSCENE_H__
+
+// standard headers
+#include <cstdint>
+#include <vector>
+
+// project headers
+#include "nffcache.h"
+#include "nffread.h"
+
+/// Specifies the scene of an NFF file in the current sgl context while it is parsed.
+/** Use between sglBeginScene() and sglEndScene() and call Finish() once ReadNFF is done.
+    Triangles of a material are gathered in a contiguous buffer, handed over by
+    sglTriangles() when the next material starts. Emissive geometry follows all other
+    geometry, the order a cache is replayed in. Spheres are not tesselated. */
+class NFFScene:
+  public NFFCallbacks
+{
+public:
+  /// @param keepGeometry keep all the geometry for Serialize, otherwise the buffers
+  ///        are reused by each material
+  NFFScene(bool keepGeometry = false);
+  virtual ~NFFScene() {}
+
+  virtual void Background(const nff_col3 &col);
+  virtual void HDRBackground(const char *hdr_name);
+  virtual void Camera(
+    const nff_vec3 &from, const nff_vec3 &at, const nff_vec3 &up,
+    const float angle, const float hither,
+    int width, int height);
+  virtual void AddPointLight(const nff_vec3 &pos, const nff_col3 &intensity);
+  virtual void SetMaterial(const nff_col3 &col, float kd, float ks, float shine, float T, float ior);
+  virtual void AddSphere(const nff_vec3 &c, float r);
+  virtual void PolyPatch(const std::vector<nff_vec3> &vertices, const std::vector<nff_vec3> &normals);
+  virtual void AreaLightBegin(const nff_col3 &intensity, const nff_vec3 &atten);
+  virtual void AreaLightEnd();
+
+  /// specifies the geometry still buffered, the emissive one in particular
+  void Finish();
+
+  /// background, camera and HDR map of the scene, the counts are not filled in
+  const NFFCacheHeader &Header() const { return _header; }
+
+  /// flattens the scene into a cache, the scene has to keep its geometry
+  std::vector<char> Serialize(uint64_t sourceHash) const;
+
+  /// specifies the scene of a cache in the current sgl context
+  static void Replay(const NFFCache &cache);
+
+private:
+  /// specifies the geometry of the current material
+  void _flushMaterial();
+  void _triangulateInto(std::vector<NFFCacheTriangle> &dest, const std::vector<nff_vec3> &vertices);
+
+  bool _keepGeometry;
+  bool _areaLightMode;
+  /// the geometry of the last material has not been specified yet
+  bool _pendingMaterial;
+
+  NFFCacheHeader _header;
+  std::vector<NFFCacheMaterial> _materials;
+  std::vector<NFFCacheLightGroup> _lightGroups;
+  std::vector<NFFCachePointLight> _pointLights;
+  /// triangles of the materials, ranges of light groups index the emissive ones
+  std::vector<NFFCacheTriangle> _triangles;
+  std::vector<NFFCacheTriangle> _lightTriangles;
+  std::vector<NFFCacheSphere> _spheres;
+};
+
+#endif // __NFFSCENE_H__
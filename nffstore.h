@@ -15,6 +15,7 @@
 #include <cmath>
 #include <stack>
 #include <list>
+#include <string>
 #include <iostream>
 using namespace std;
 
@@ -105,6 +106,8 @@ public: // data
   nff_col3 bg_col;
 
   HDRLoaderResult envMap;
+  /// file name of the HDR environment map, empty if there is none
+  std::string hdrName;
 
   /// camera
   nff_vec3 from, at, up;
@@ -135,6 +138,7 @@ public: // methods
   // not implemented yet
   virtual void HDRBackground(const char *hdr_name) {
     HDRLoader loader;
+    hdrName = hdr_name;
 
     if (!loader.load(hdr_name, envMap)) {
       cout<<"Cound not read hdr env map !"<<hdr_name<<endl;
@@ -185,14 +185,8 @@ int main (int argc,char **argv)
   }
 
   // read the NFF file specified on the cmmand line
-  FILE *f = fopen(argv[1],"rt");
-  if(!f) {
-    fprintf(stderr,"Could not open %s for reading.\n",argv[1]);
-    return 2;
-  }
-
   char errstring[4000];
-  if( ReadNFF(f,errstring,&nffstore) < 0 ) {
+  if( ReadNFF(argv[1],errstring,&nffstore) < 0 ) {
     fprintf(stderr,"Error in NFF file %s:\n",argv[1],errstring);
     return 2;
   }
@@ -112,9 +112,58 @@ typedef enum {
 /// Enum for sglEnable() / sglDisable()
 typedef enum {
   /// enable/disable depth test
-  SGL_DEPTH_TEST = 1
+  SGL_DEPTH_TEST = 1,
+  /// enable/disable deferring filled polygons until sglFlush() or sglFinish(), which rasterize
+  /// them by tiles on SGL_RENDER_THREADS threads
+  SGL_DEFERRED_RASTER = 2
 } sglEEnableFlags;
 
+/// Enum for ray tracing parameters. Passed to sglRenderParameteri().
+typedef enum {
+  /// Number of threads rendering the image (0 selects the number of hardware threads, default)
+  SGL_RENDER_THREADS = 0,
+  /// Side of the square image tiles distributed among the threads in pixels (16 by default)
+  SGL_RENDER_TILE_SIZE = 1,
+  /// Trace coherent primary and shadow rays in packets of four (nonzero by default)
+  SGL_RENDER_PACKETS = 2,
+  /// Minimum number of samples per pixel taken by the adaptive sampler (1 by default)
+  SGL_RENDER_MIN_SAMPLES = 3,
+  /// Maximum number of samples per pixel taken by the adaptive sampler (16 by default)
+  SGL_RENDER_MAX_SAMPLES = 4,
+  /// Relative error at which the adaptive sampler considers a pixel converged (0.1 by default),
+  /// set with sglRenderParameterf()
+  SGL_RENDER_NOISE_TARGET = 5,
+  /// Builder of the acceleration structure used by the following sglEndScene() calls,
+  /// one of sglEBvhBuilder (SGL_BVH_SAH by default)
+  SGL_RENDER_BVH_BUILDER = 6,
+  /// Take the first hits of the pixel centers from the rasterized scene instead of tracing
+  /// primary rays (zero by default)
+  SGL_RENDER_HYBRID = 7
+} sglERenderParameter;
+
+/// Builders of the acceleration structure, selected with SGL_RENDER_BVH_BUILDER
+typedef enum {
+  /// Binned surface area heuristic, slower to build but the fastest to trace
+  SGL_BVH_SAH = 0,
+  /// Primitives sorted along a Morton curve, the fastest to build for interactive or edited scenes
+  SGL_BVH_LBVH = 1
+} sglEBvhBuilder;
+
+/// Statistics of the acceleration structure. Passed to sglGetBvhStatistic().
+typedef enum {
+  /// Duration of the last build in milliseconds
+  SGL_BVH_BUILD_TIME = 0,
+  /// Number of (four-wide) nodes
+  SGL_BVH_NODE_COUNT = 1,
+  /// Number of leaves
+  SGL_BVH_LEAF_COUNT = 2,
+  /// Number of node levels
+  SGL_BVH_DEPTH = 3,
+  /// Expected cost of tracing a ray in units of a primitive intersection
+  /// according to the surface area heuristic, lower is better
+  SGL_BVH_SAH_COST = 4
+} sglEBvhStatistic;
+
 //---------------------------------------------------------------------------
 // Error handling functions
 //---------------------------------------------------------------------------
@@ -164,7 +213,8 @@ void sglInit(void);
 
 /// Library finalization.
 /**
-  Finalizes the SGL and disposes the internal data structures.
+  Finalizes the SGL and disposes the internal data structures. Polygons deferred by
+  SGL_DEFERRED_RASTER in any context are rasterized first.
 
   ERRORS:
    - none
@@ -317,6 +367,134 @@ void sglVertex3f(float x, float y, float z);
  */
 void sglVertex2f(float x, float y);
 
+/// Vertex array definition.
+/**
+  Sets the array the vertices of sglDrawArrays() and sglDrawElements() are read
+  from. The array is not copied, it has to stay valid while it is drawn from.
+
+  @param size [in] number of coordinates per vertex, 2 (assuming z = 0, w = 1),
+                   3 (assuming w = 1) or 4
+  @param stride [in] byte offset between consecutive vertices, 0 if they are
+                     tightly packed
+  @param pointer [in] first coordinate of the first vertex, NULL unsets the array
+
+  ERRORS:
+   - SGL_INVALID_VALUE
+    size is not 2, 3 or 4 or stride is negative.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglVertexPointer() is called within a
+    sglBegin() / sglEnd() sequence.
+ */
+void sglVertexPointer(int size, int stride, const float *pointer);
+
+/// Drawing an element from the vertex array.
+/**
+  Draws count consecutive vertices of the array set by sglVertexPointer(),
+  starting at first, with the same result as sglBegin(mode), a sglVertex4f()
+  call per vertex and sglEnd(), with far less overhead per vertex. SGL_TRIANGLES
+  are independent triangles of three vertices each.
+
+  During the scene (or mesh) specification, only SGL_TRIANGLES and SGL_POLYGON
+  of three vertices are accepted and the triangles are added to the scene the
+  way sglTriangles() adds them.
+
+  @param mode [in] the element type, SGL_POINTS to SGL_POLYGON
+  @param first [in] index of the first vertex
+  @param count [in] number of vertices
+
+  ERRORS:
+   - SGL_INVALID_ENUM
+    mode is set to an unacceptable value.
+   - SGL_INVALID_VALUE
+    first or count is negative.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet, no vertex array has been set,
+    sglDrawArrays() is called within a sglBegin() / sglEnd() sequence or mode
+    is not accepted during the scene specification.
+ */
+void sglDrawArrays(sglEElementType mode, int first, int count);
+
+/// Drawing an indexed element from the vertex array.
+/**
+  Same as sglDrawArrays(), except that the vertices are the ones of the array
+  at the given indices.
+
+  @param mode [in] the element type, SGL_POINTS to SGL_POLYGON
+  @param count [in] number of indices
+  @param indices [in] indices into the vertex array
+
+  ERRORS:
+   - SGL_INVALID_ENUM
+    mode is set to an unacceptable value.
+   - SGL_INVALID_VALUE
+    count is negative or indices is NULL.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet, no vertex array has been set,
+    sglDrawElements() is called within a sglBegin() / sglEnd() sequence or mode
+    is not accepted during the scene specification.
+ */
+void sglDrawElements(sglEElementType mode, int count, const unsigned *indices);
+
+/// Starting display list recording.
+/**
+  Starts recording a display list. Until sglEndList(), primitives specified by
+  sglBegin() / sglEnd(), sglDrawArrays(), sglDrawElements(), sglCircle(),
+  sglEllipse() and sglArc() are recorded instead of drawn, together with the
+  changes made by sglColor3f(), sglAreaMode(), sglPointSize(), sglEnable() and
+  sglDisable(). Modelview transformations specified while recording start from
+  the identity, standing for the modelview the list is called with, and are
+  applied to the recorded vertices right away, sglLoadIdentity() and
+  sglLoadMatrix() loading relative to it as well. A list of static content is
+  thus processed once and replayed by sglCallList() with a single matrix for
+  all of its vertices.
+
+  While recording, sglClear(), sglFlush(), sglViewport(), sglOrtho(),
+  sglFrustum(), sglMatrixMode(SGL_PROJECTION), scene and mesh specification,
+  sglRayTraceScene(), sglRayTraceSceneProgressive() and sglRasterizeScene()
+  fail with SGL_INVALID_OPERATION.
+
+  @return id of the new list, -1 on error
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglNewList() is called within a
+    sglBegin() / sglEnd(), sglNewList() / sglEndList(), sglBeginScene() /
+    sglEndScene() or sglBeginMesh() / sglEndMesh() sequence.
+ */
+int sglNewList(void);
+
+/// Ending display list recording.
+/**
+  Ends recording the display list started by sglNewList(). The matrix stacks,
+  the matrix mode and the state recorded are restored to what they were when
+  recording started.
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglEndList() is called within a
+    sglBegin() / sglEnd() sequence or outside a sglNewList() / sglEndList()
+    sequence.
+ */
+void sglEndList(void);
+
+/// Display list replay.
+/**
+  Draws a display list with the current transformations, as its recorded calls
+  would. The state it recorded stays set afterwards, and the current modelview
+  matrix is multiplied by the one the list ended with.
+
+  @param list [in] id returned by sglNewList()
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglCallList() is called within a
+    sglBegin() / sglEnd(), sglNewList() / sglEndList(), sglBeginScene() /
+    sglEndScene() or sglBeginMesh() / sglEndMesh() sequence.
+   - SGL_INVALID_VALUE
+    list is not the id of a completely recorded list.
+ */
+void sglCallList(int list);
+
 /// Drawing a circle.
 /**
   Draws a circle to the current context color buffer.
@@ -729,6 +907,19 @@ void sglEnable(sglEEnableFlags cap);
  */
 void sglDisable(sglEEnableFlags cap);
 
+/// Rasterizing deferred polygons.
+/**
+  Rasterizes the polygons the current context deferred since SGL_DEFERRED_RASTER was enabled,
+  tiles of the image in parallel. The buffers end up the same as if the polygons were drawn
+  right away. Drawing anything else, clearing and sglGetColorBufferPointer() flush them as well.
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglFlush() is called within a
+    sglBegin() / sglEnd() sequence.
+ */
+void sglFlush(void);
+
 /// Starting scene description.
 /**
   Denotes the start of scene specification. The scene is initially empty.
@@ -739,7 +930,7 @@ void sglDisable(sglEEnableFlags cap);
   ERRORS:
    - SGL_INVALID_OPERATION
     No context has been allocated yet or sglBeginScene() is called within a
-    sglBegin() / sglEnd() sequence.
+    sglBegin() / sglEnd() or sglBeginMesh() / sglEndMesh() sequence.
  */
 void sglBeginScene();
 
@@ -767,13 +958,123 @@ void sglEndScene();
    - SGL_INVALID_OPERATION
     No context has been allocated yet or sglSphere() is called within a
     sglBegin() / sglEnd() sequence or sglSphere() is called outside
-    sglBeginScene() / sglEndScene() sequence.
+    sglBeginScene() / sglEndScene() and sglBeginMesh() / sglEndMesh() sequences.
  */
 void sglSphere(const float x,
                const float y,
                const float z,
                const float radius);
 
+/// Triangles definition.
+/**
+  Adds triangles to the primitive list with the current material, as if each
+  of them was specified by sglBegin(SGL_POLYGON), three sglVertex3f() calls and
+  sglEnd(). Large scenes are stored this way without a call per vertex.
+
+  @param count [in] number of triangles
+  @param vertices [in] 9 * count coordinates, x, y and z of the three vertices
+                       of the first triangle followed by those of the others
+
+  ERRORS:
+   - SGL_INVALID_VALUE
+    count is negative or vertices is NULL while count is positive.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglTriangles() is called within a
+    sglBegin() / sglEnd() sequence or sglTriangles() is called outside
+    sglBeginScene() / sglEndScene() and sglBeginMesh() / sglEndMesh() sequences.
+ */
+void sglTriangles(int count, const float *vertices);
+
+/// Starting mesh description.
+/**
+  Denotes the start of mesh specification. Primitives specified by
+  sglBegin(SGL_POLYGON) / sglEnd() or sglSphere() until sglEndMesh() form a
+  mesh in its own object space instead of being added to a scene. Meshes are
+  kept by the context across scenes and placed into them by sglInstance(), so
+  geometry repeated many times is stored and its acceleration structure built
+  only once.
+
+  @return id of the new mesh, -1 on error
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglBeginMesh() is called within a
+    sglBegin() / sglEnd(), sglBeginScene() / sglEndScene() or
+    sglBeginMesh() / sglEndMesh() sequence.
+ */
+int sglBeginMesh(void);
+
+/// Mesh update.
+/**
+  Starts specifying primitives of an existing mesh again, replacing the ones
+  it had. The description is ended by sglEndMesh(), which moves all instances
+  of the mesh along without specifying the scene again. When the mesh keeps
+  its number of primitives, its acceleration structure is only refitted to
+  their new positions, which is much cheaper than building it (as long as the
+  primitives do not move so far that the structure loses too much quality,
+  it is rebuilt then).
+
+  @param mesh [in] id returned by sglBeginMesh()
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglUpdateMesh() is called within a
+    sglBegin() / sglEnd(), sglBeginScene() / sglEndScene() or
+    sglBeginMesh() / sglEndMesh() sequence.
+   - SGL_INVALID_VALUE
+    mesh is not the id of a completely specified mesh.
+ */
+void sglUpdateMesh(int mesh);
+
+/// Ending mesh description.
+/**
+  Denotes the end of mesh specification and builds its acceleration structure.
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglEndMesh() is called within a
+    sglBegin() / sglEnd() sequence or outside a sglBeginMesh() / sglEndMesh()
+    sequence.
+ */
+void sglEndMesh(void);
+
+/// Mesh instance definition.
+/**
+  Places a mesh into the scene transformed by the current modelview matrix.
+  Emissive triangles of the mesh light the scene from every instance.
+
+  @param mesh [in] id returned by sglBeginMesh()
+  @return handle of the instance, valid until the next sglBeginScene(), -1 on error
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglInstance() is called within a
+    sglBegin() / sglEnd() sequence or outside a sglBeginScene() / sglEndScene()
+    sequence.
+   - SGL_INVALID_VALUE
+    mesh is not the id of a completely specified mesh.
+ */
+int sglInstance(int mesh);
+
+/// Instance transformation update.
+/**
+  Moves an instance to the current modelview matrix. Scenes animated this way
+  only refit the acceleration structure over their instances before the next
+  sglRayTraceScene() or sglRayTraceSceneProgressive() instead of being
+  specified and built again. Progressive accumulation starts over.
+
+  @param instance [in] handle returned by sglInstance()
+
+  ERRORS:
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglInstanceTransform() is called
+    within a sglBegin() / sglEnd(), sglBeginScene() / sglEndScene(),
+    sglBeginMesh() / sglEndMesh() or sglNewList() / sglEndList() sequence.
+   - SGL_INVALID_VALUE
+    instance is not a handle of an instance of the current scene.
+ */
+void sglInstanceTransform(int instance);
+
 
 /// Surface material specification.
 /**
@@ -836,25 +1137,160 @@ void sglPointLight(const float x,
 
 /// Rendering the image (ray tracing).
 /**
-  Computes an image of the scene using ray tracing.
+  Computes an image of the scene using ray tracing. Every pixel is first
+  sampled through its center; the adaptive sampler then adds jittered samples
+  to each pixel until the standard error of its mean luminance, relative to the
+  luminance, drops to SGL_RENDER_NOISE_TARGET or the pixel has
+  SGL_RENDER_MAX_SAMPLES samples. Pixels with a single sample estimate their
+  variance from their four neighbours.
 
   ERRORS:
    - SGL_INVALID_OPERATION
     No context has been allocated yet or sglRayTraceScene() is called within a
     sglBegin() / sglEnd() sequence or sglRayTraceScene() is called within a
-    sglBeginScene() / sglEndScene() sequence.
+    sglBeginScene() / sglEndScene() or sglBeginMesh() / sglEndMesh() sequence.
 */
 void sglRayTraceScene();
 
-/// Rendering the image (ray tracing).
+/// Progressive rendering (ray tracing).
+/**
+  Adds samples per pixel to the accumulation buffer of the current context and
+  stores the average of all accumulated samples in the color buffer, so that
+  a usable image is available after the first call and refined by each
+  following one. The first sample of a pixel passes through its center, the
+  following ones are jittered over the pixel area. Accumulation starts over
+  after sglEndScene() and whenever the transformation matrices or the viewport
+  differ from those of the previous call.
+
+  @param samples [in] number of samples per pixel added by this call
+
+  ERRORS:
+   - SGL_INVALID_VALUE
+    samples is not positive.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglRayTraceSceneProgressive() is
+    called within a sglBegin() / sglEnd() sequence or within a
+    sglBeginScene() / sglEndScene() or sglBeginMesh() / sglEndMesh() sequence.
+*/
+void sglRayTraceSceneProgressive(int samples);
+
+/// Number of accumulated samples.
+/**
+  Returns the number of samples per pixel accumulated by
+  sglRayTraceSceneProgressive() since the accumulation last started over, or 0
+  if no context has been allocated yet (no error code set).
+
+  ERRORS:
+   - none
+*/
+int sglGetSampleCount(void);
+
+/// Convergence estimate of the progressive image.
+/**
+  Returns the mean over pixels of the standard error of the accumulated pixel
+  luminance relative to the luminance itself. The value decreases towards 0 as
+  the image converges; it is 1 until at least two samples are accumulated or
+  if no context has been allocated yet (no error code set).
+
+  ERRORS:
+   - none
+*/
+float sglGetNoiseEstimate(void);
+
+/// Acceleration structure statistics.
+/**
+  Returns a statistic of the acceleration structure built by the last
+  sglEndScene() of the current context, 0 if no scene has been specified yet.
+  Build time and SAH cost allow comparing the builders selected with
+  SGL_RENDER_BVH_BUILDER.
+
+  @param pname [in] statistic identification, one of sglEBvhStatistic
+
+  ERRORS:
+   - SGL_INVALID_ENUM
+    pname is not an accepted value.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet.
+*/
+float sglGetBvhStatistic(sglEBvhStatistic pname);
+
+/// Ray tracing parameter specification.
 /**
-  Computes an image of the scene using rasterization.
+  Sets a parameter of sglRayTraceScene() for the current context. The image is
+  split into square tiles which are rendered in parallel; the resulting image
+  does not depend on the number of threads nor on the tile size.
+
+  @param pname [in] parameter identification:
+                    - SGL_RENDER_THREADS: number of rendering threads,
+                      0 selects the number of hardware threads
+                    - SGL_RENDER_TILE_SIZE: tile side in pixels
+                    - SGL_RENDER_PACKETS: nonzero traces primary rays of
+                      2x2 pixel blocks and shadow rays towards the same light
+                      together using SIMD, zero traces every ray on its own;
+                      both modes produce the same image
+                    - SGL_RENDER_MIN_SAMPLES: samples every pixel receives
+                    - SGL_RENDER_MAX_SAMPLES: samples no pixel exceeds, a value
+                      below the minimum acts as the minimum
+                    - SGL_RENDER_BVH_BUILDER: SGL_BVH_SAH or SGL_BVH_LBVH, the
+                      builder of the acceleration structure of scenes ended
+                      afterwards; both use all rendering threads
+                    - SGL_RENDER_HYBRID: nonzero rasterizes the scene as
+                      sglRasterizeScene() does, the primitive covering each
+                      pixel is then intersected by its central ray alone and
+                      tracing goes on from that hit with shadow, reflection and
+                      refraction rays; zero traces primary rays through the
+                      whole scene. Pixels differ only along the edges of
+                      primitives, where coverage and central rays disagree
+  @param value [in] new value of the parameter
+
+  ERRORS:
+   - SGL_INVALID_ENUM
+    pname is not an accepted value.
+   - SGL_INVALID_VALUE
+    value is negative, the tile size or a sample count is not positive or the
+    builder is not one of sglEBvhBuilder.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglRenderParameteri() is called within
+    a sglBegin() / sglEnd() sequence.
+*/
+void sglRenderParameteri(sglERenderParameter pname, int value);
+
+/// Floating point ray tracing parameter specification.
+/**
+  Sets a floating point parameter of sglRayTraceScene() for the current context.
+
+  @param pname [in] parameter identification:
+                    - SGL_RENDER_NOISE_TARGET: relative error of the mean pixel
+                      luminance below which the adaptive sampler stops adding
+                      samples to a pixel
+  @param value [in] new value of the parameter
+
+  ERRORS:
+   - SGL_INVALID_ENUM
+    pname is not an accepted value.
+   - SGL_INVALID_VALUE
+    value is negative.
+   - SGL_INVALID_OPERATION
+    No context has been allocated yet or sglRenderParameterf() is called within
+    a sglBegin() / sglEnd() sequence.
+*/
+void sglRenderParameterf(sglERenderParameter pname, float value);
+
+/// Rendering the image (rasterization).
+/**
+  Computes a preview of the image sglRayTraceScene() renders, by rasterizing
+  the scene into the color and depth buffers. Spheres are tessellated and
+  every pixel is lit by all lights of the scene with the Phong model, without
+  shadows, reflections or refractions. Area lights shine from the centroid of
+  their triangle. Pixels not covered by the scene get the color of the
+  environment map or the clear color. Afterwards the depth buffer holds the
+  depths of the scene.
 
   ERRORS:
    - SGL_INVALID_OPERATION
     No context has been allocated yet or sglRasterizeScene() is called within a
     sglBegin() / sglEnd() sequence or sglRasterizeScene() is called within a
-    sglBeginScene() / sglEndScene() sequence.
+    sglBeginScene() / sglEndScene() or sglBeginMesh() / sglEndMesh() sequence.
 */
 void sglRasterizeScene();
 
@@ -0,0 +1,641 @@
+#include "bvh.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <numeric>
+
+namespace sgl
+{
+
+// Chunks the loops over primitives are split into, one for serial loops
+static uint32_t chunkCount(ThreadPool* threadPool)
+{
+    return threadPool ? threadPool->getThreadCount() * 4 : 1;
+}
+
+// Calls func(chunk, first, last) for consecutive ranges covering [begin, end), in parallel
+// with a thread pool
+template <typename Func>
+static void forEachChunk(ThreadPool* threadPool, uint32_t chunks, uint32_t begin, uint32_t end, Func&& func)
+{
+    const uint32_t chunkSize = (end - begin + chunks - 1) / chunks;
+    auto runChunk = [&](uint32_t chunk) {
+        const uint32_t first = std::min(begin + chunk * chunkSize, end);
+        func(chunk, first, std::min(first + chunkSize, end));
+    };
+
+    if (!threadPool)
+    {
+        for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+        {
+            runChunk(chunk);
+        }
+        return;
+    }
+    threadPool->parallelFor(chunks, [&](uint32_t chunk, uint32_t /* threadIdx */) { runChunk(chunk); });
+}
+
+// Spreads the lower ten bits of v to every third bit
+static uint32_t expandBits(uint32_t v)
+{
+    v = (v * 0x00010001u) & 0xff0000ffu;
+    v = (v * 0x00000101u) & 0x0f00f00fu;
+    v = (v * 0x00000011u) & 0xc30c30c3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+void Bvh::build(const std::vector<AABB>& primitiveBounds, Builder builder, ThreadPool* threadPool)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    clear();
+    m_statistics.builder = builder;
+    if (primitiveBounds.empty())
+    {
+        return;
+    }
+
+    const uint32_t count = static_cast<uint32_t>(primitiveBounds.size());
+    if (threadPool && threadPool->getThreadCount() == 1)
+    {
+        threadPool = nullptr;
+    }
+    BuildState state = { primitiveBounds, std::vector<vec3>(count), {}, builder, threadPool, count };
+    if (threadPool)
+    {
+        // Several tasks per thread balance subtrees of uneven cost
+        state.taskSize = std::max(MIN_TASK_SIZE, count / (threadPool->getThreadCount() * 8));
+    }
+
+    forEachChunk(threadPool, chunkCount(threadPool), 0, count, [&](uint32_t /* chunk */, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i)
+        {
+            state.centroids[i] = primitiveBounds[i].centroid();
+        }
+    });
+
+    m_primitiveIndices.resize(count);
+    std::iota(m_primitiveIndices.begin(), m_primitiveIndices.end(), 0);
+    if (builder == Builder::LBVH)
+    {
+        sortMorton(state);
+    }
+
+    std::vector<BuildNode> buildNodes;
+    buildNodes.reserve(2 * primitiveBounds.size());
+    std::vector<BuildTask> tasks;
+    buildRecursive(state, buildNodes, 0, count, 0, threadPool ? &tasks : nullptr);
+
+    if (!tasks.empty())
+    {
+        std::vector<std::vector<BuildNode>> subtrees(tasks.size());
+        threadPool->parallelFor(static_cast<uint32_t>(tasks.size()), [&](uint32_t taskIdx, uint32_t /* threadIdx */) {
+            const BuildTask& task = tasks[taskIdx];
+            subtrees[taskIdx].reserve(2 * (task.end - task.begin));
+            buildRecursive(state, subtrees[taskIdx], task.begin, task.end, task.depth, nullptr);
+        });
+
+        // The root of every subtree replaces its placeholder, the remaining nodes are appended
+        const uint32_t topNodeCount = static_cast<uint32_t>(buildNodes.size());
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            const uint32_t base = static_cast<uint32_t>(buildNodes.size()) - 1;
+            auto remap = [&](uint32_t idx) { return idx == 0 ? tasks[i].node : base + idx; };
+            for (size_t j = 0; j < subtrees[i].size(); ++j)
+            {
+                BuildNode node = subtrees[i][j];
+                if (!node.isLeaf())
+                {
+                    node.children[0] = remap(node.children[0]);
+                    node.children[1] = remap(node.children[1]);
+                }
+                if (j == 0)
+                {
+                    buildNodes[tasks[i].node] = node;
+                }
+                else
+                {
+                    buildNodes.push_back(node);
+                }
+            }
+        }
+        refit(buildNodes, 0, topNodeCount);
+    }
+
+    m_nodes.reserve(buildNodes.size() / 2 + 1);
+    if (buildNodes[0].isLeaf())
+    {
+        // The root has to be an inner node, a single leaf becomes its only child
+        m_nodes.emplace_back();
+        BvhNode& root = m_nodes[0];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            root.min[axis][0] = buildNodes[0].bounds.min[axis];
+            root.max[axis][0] = buildNodes[0].bounds.max[axis];
+        }
+        root.child[0] = buildNodes[0].offset;
+        root.count[0] = buildNodes[0].count;
+        root.childCount = 1;
+    }
+    else
+    {
+        collapse(buildNodes, 0);
+    }
+
+    updateStatistics();
+    m_statistics.builtSahCost = m_statistics.sahCost;
+    m_statistics.buildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Bvh::refit(const std::vector<AABB>& primitiveBounds)
+{
+    assert(primitiveBounds.size() == m_primitiveIndices.size());
+    if (m_nodes.empty())
+    {
+        return true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    refitNode(primitiveBounds, 0);
+    updateStatistics();
+    m_statistics.buildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return m_statistics.sahCost <= MAX_REFIT_COST_RATIO * m_statistics.builtSahCost;
+}
+
+void Bvh::clear()
+{
+    m_nodes.clear();
+    m_primitiveIndices.clear();
+    m_statistics = Statistics();
+}
+
+bool Bvh::isEmpty() const
+{
+    return m_nodes.empty();
+}
+
+uint32_t Bvh::getPrimitiveCount() const
+{
+    return static_cast<uint32_t>(m_primitiveIndices.size());
+}
+
+const Bvh::Statistics& Bvh::getStatistics() const
+{
+    return m_statistics;
+}
+
+const std::vector<uint32_t>& Bvh::getPrimitiveIndices() const
+{
+    return m_primitiveIndices;
+}
+
+uint32_t Bvh::buildRecursive(BuildState& state, std::vector<BuildNode>& buildNodes, uint32_t begin, uint32_t end, uint32_t depth, std::vector<BuildTask>* tasks)
+{
+    uint32_t nodeIdx = static_cast<uint32_t>(buildNodes.size());
+    buildNodes.emplace_back();
+
+    if (tasks && end - begin <= state.taskSize)
+    {
+        tasks->push_back({ nodeIdx, begin, end, depth });
+        return nodeIdx;
+    }
+
+    // Degenerate input can make either builder peel off a few primitives at a time, past some depth
+    // the rest is halved so that the hierarchy fits the traversal stack
+    const bool balanced = depth >= BALANCED_DEPTH;
+    AABB bounds;
+    uint32_t mid = begin;
+    bool isInner = state.builder == Builder::SAH
+        ? splitSah(state, begin, end, tasks != nullptr, balanced, bounds, mid)
+        : splitMorton(state, begin, end, balanced, mid);
+
+    if (!isInner)
+    {
+        if (state.builder == Builder::LBVH)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                bounds.extend(state.primitiveBounds[m_primitiveIndices[i]]);
+            }
+        }
+        buildNodes[nodeIdx].bounds = bounds;
+        buildNodes[nodeIdx].offset = begin;
+        buildNodes[nodeIdx].count = end - begin;
+        return nodeIdx;
+    }
+
+    uint32_t first = buildRecursive(state, buildNodes, begin, mid, depth + 1, tasks);
+    uint32_t second = buildRecursive(state, buildNodes, mid, end, depth + 1, tasks);
+
+    if (state.builder == Builder::LBVH)
+    {
+        // Codes say nothing about the bounds, they are gathered from the children
+        // (placeholders among them are refit once their task finished)
+        bounds = buildNodes[first].bounds;
+        bounds.extend(buildNodes[second].bounds);
+    }
+
+    BuildNode& node = buildNodes[nodeIdx];
+    node.bounds = bounds;
+    node.offset = 0;
+    node.count = 0;
+    node.children[0] = first;
+    node.children[1] = second;
+
+    return nodeIdx;
+}
+
+bool Bvh::splitSah(BuildState& state, uint32_t begin, uint32_t end, bool parallel, bool balanced, AABB& bounds, uint32_t& mid)
+{
+    // Nodes above the tasks hold many primitives, their loops are split among the threads
+    ThreadPool* threadPool = parallel ? state.threadPool : nullptr;
+    const uint32_t chunks = chunkCount(threadPool);
+
+    std::vector<AABB> chunkBounds(chunks);
+    std::vector<AABB> chunkCentroidBounds(chunks);
+    forEachChunk(threadPool, chunks, begin, end, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i)
+        {
+            chunkBounds[chunk].extend(state.primitiveBounds[m_primitiveIndices[i]]);
+            chunkCentroidBounds[chunk].extend(state.centroids[m_primitiveIndices[i]]);
+        }
+    });
+
+    AABB centroidBounds;
+    for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        bounds.extend(chunkBounds[chunk]);
+        centroidBounds.extend(chunkCentroidBounds[chunk]);
+    }
+
+    uint32_t count = end - begin;
+    int axis = centroidBounds.maxExtent();
+    float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+
+    // Coincident centroids cannot be binned, they are split by count like the balanced nodes
+    if (balanced || extent <= 0)
+    {
+        if (count <= MAX_LEAF_SIZE)
+        {
+            return false;
+        }
+        mid = begin + count / 2;
+        std::nth_element(m_primitiveIndices.begin() + begin, m_primitiveIndices.begin() + mid, m_primitiveIndices.begin() + end,
+            [&](uint32_t a, uint32_t b) { return state.centroids[a][axis] < state.centroids[b][axis]; });
+        return true;
+    }
+
+    if (count <= 1)
+    {
+        return false;
+    }
+
+    // Bin centroids along the longest axis and evaluate the SAH for every bin boundary
+    struct Bin
+    {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+
+    float binScale = BIN_COUNT / extent;
+    auto binIdx = [&](uint32_t primitiveIdx) {
+        int idx = static_cast<int>((state.centroids[primitiveIdx][axis] - centroidBounds.min[axis]) * binScale);
+        return std::min(idx, BIN_COUNT - 1);
+    };
+
+    std::vector<std::array<Bin, BIN_COUNT>> chunkBins(chunks);
+    forEachChunk(threadPool, chunks, begin, end, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i)
+        {
+            Bin& bin = chunkBins[chunk][binIdx(m_primitiveIndices[i])];
+            bin.bounds.extend(state.primitiveBounds[m_primitiveIndices[i]]);
+            ++bin.count;
+        }
+    });
+
+    Bin bins[BIN_COUNT];
+    for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        for (int i = 0; i < BIN_COUNT; ++i)
+        {
+            bins[i].bounds.extend(chunkBins[chunk][i].bounds);
+            bins[i].count += chunkBins[chunk][i].count;
+        }
+    }
+
+    float rightArea[BIN_COUNT - 1];
+    AABB rightBounds;
+    for (int i = BIN_COUNT - 1; i > 0; --i)
+    {
+        rightBounds.extend(bins[i].bounds);
+        rightArea[i - 1] = rightBounds.surfaceArea();
+    }
+
+    float bestCost = std::numeric_limits<float>::max();
+    int bestSplit = -1;
+    AABB leftBounds;
+    uint32_t leftCount = 0;
+    for (int i = 0; i < BIN_COUNT - 1; ++i)
+    {
+        leftBounds.extend(bins[i].bounds);
+        leftCount += bins[i].count;
+        float cost = leftBounds.surfaceArea() * leftCount + rightArea[i] * (count - leftCount);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestSplit = i;
+        }
+    }
+
+    // Traversal step is assumed to cost as much as a single primitive intersection
+    float leafCost = static_cast<float>(count);
+    float splitCost = 1 + bestCost / bounds.surfaceArea();
+    if (count <= MAX_LEAF_SIZE && leafCost <= splitCost)
+    {
+        return false;
+    }
+
+    auto middle = std::partition(m_primitiveIndices.begin() + begin, m_primitiveIndices.begin() + end,
+        [&](uint32_t primitiveIdx) { return binIdx(primitiveIdx) <= bestSplit; });
+    mid = static_cast<uint32_t>(std::distance(m_primitiveIndices.begin(), middle));
+
+    if (mid == begin || mid == end)
+    {
+        mid = begin + count / 2;
+    }
+
+    return true;
+}
+
+bool Bvh::splitMorton(const BuildState& state, uint32_t begin, uint32_t end, bool balanced, uint32_t& mid) const
+{
+    if (end - begin <= MAX_LEAF_SIZE)
+    {
+        return false;
+    }
+
+    const uint32_t firstCode = state.mortonCodes[begin];
+    const uint32_t lastCode = state.mortonCodes[end - 1];
+    if (balanced || firstCode == lastCode)
+    {
+        mid = begin + (end - begin) / 2;
+        return true;
+    }
+
+    // Sorted codes of the range share all bits above the highest differing one,
+    // the split goes where that bit turns to one
+    uint32_t bit = firstCode ^ lastCode;
+    while (bit & (bit - 1))
+    {
+        bit &= bit - 1;
+    }
+    auto middle = std::partition_point(state.mortonCodes.begin() + begin, state.mortonCodes.begin() + end,
+        [bit](uint32_t code) { return !(code & bit); });
+    mid = static_cast<uint32_t>(std::distance(state.mortonCodes.begin(), middle));
+
+    return true;
+}
+
+void Bvh::sortMorton(BuildState& state)
+{
+    const uint32_t count = static_cast<uint32_t>(m_primitiveIndices.size());
+    ThreadPool* threadPool = state.threadPool;
+    const uint32_t chunks = chunkCount(threadPool);
+
+    std::vector<AABB> chunkBounds(chunks);
+    forEachChunk(threadPool, chunks, 0, count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i)
+        {
+            chunkBounds[chunk].extend(state.centroids[i]);
+        }
+    });
+    AABB centroidBounds;
+    for (const AABB& bounds : chunkBounds)
+    {
+        centroidBounds.extend(bounds);
+    }
+
+    // Centroids are quantized to a grid over their bounds, flat axes map to its first cell
+    constexpr uint32_t cells = 1u << MORTON_BITS;
+    vec3 scale;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+        scale[axis] = extent > 0 ? cells / extent : 0.f;
+    }
+
+    // Keys hold the code above the primitive index
+    std::vector<uint64_t> keys(count);
+    forEachChunk(threadPool, chunks, 0, count, [&](uint32_t /* chunk */, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i)
+        {
+            uint32_t code = 0;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                uint32_t cell = std::min(static_cast<uint32_t>((state.centroids[i][axis] - centroidBounds.min[axis]) * scale[axis]), cells - 1);
+                code |= expandBits(cell) << (2 - axis);
+            }
+            keys[i] = (static_cast<uint64_t>(code) << 32) | i;
+        }
+    });
+
+    // Stable least significant digit radix sort, MORTON_BITS per pass. Chunks count their digits
+    // in parallel and scatter to offsets ordered by digit and then by chunk
+    constexpr uint32_t radix = 1u << MORTON_BITS;
+    std::vector<uint64_t> sorted(count);
+    std::vector<uint32_t> offsets(chunks * radix);
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        const int shift = 32 + pass * MORTON_BITS;
+        auto digit = [&](uint64_t key) { return static_cast<uint32_t>(key >> shift) & (radix - 1); };
+
+        std::fill(offsets.begin(), offsets.end(), 0);
+        forEachChunk(threadPool, chunks, 0, count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; ++i)
+            {
+                ++offsets[chunk * radix + digit(keys[i])];
+            }
+        });
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < radix; ++d)
+        {
+            for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                uint32_t digitCount = offsets[chunk * radix + d];
+                offsets[chunk * radix + d] = offset;
+                offset += digitCount;
+            }
+        }
+
+        forEachChunk(threadPool, chunks, 0, count, [&](uint32_t chunk, uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; ++i)
+            {
+                sorted[offsets[chunk * radix + digit(keys[i])]++] = keys[i];
+            }
+        });
+        keys.swap(sorted);
+    }
+
+    state.mortonCodes.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        m_primitiveIndices[i] = static_cast<uint32_t>(keys[i]);
+        state.mortonCodes[i] = static_cast<uint32_t>(keys[i] >> 32);
+    }
+}
+
+AABB Bvh::refit(std::vector<BuildNode>& buildNodes, uint32_t buildIdx, uint32_t topNodeCount)
+{
+    if (buildNodes[buildIdx].isLeaf() || buildIdx >= topNodeCount)
+    {
+        return buildNodes[buildIdx].bounds;
+    }
+
+    AABB bounds = refit(buildNodes, buildNodes[buildIdx].children[0], topNodeCount);
+    bounds.extend(refit(buildNodes, buildNodes[buildIdx].children[1], topNodeCount));
+    buildNodes[buildIdx].bounds = bounds;
+    return bounds;
+}
+
+AABB Bvh::refitNode(const std::vector<AABB>& primitiveBounds, uint32_t nodeIdx)
+{
+    AABB nodeBounds;
+    for (uint32_t i = 0; i < m_nodes[nodeIdx].childCount; ++i)
+    {
+        AABB bounds;
+        if (m_nodes[nodeIdx].isLeaf(i))
+        {
+            const uint32_t first = m_nodes[nodeIdx].child[i];
+            for (uint32_t position = first; position < first + m_nodes[nodeIdx].count[i]; ++position)
+            {
+                bounds.extend(primitiveBounds[m_primitiveIndices[position]]);
+            }
+        }
+        else
+        {
+            bounds = refitNode(primitiveBounds, m_nodes[nodeIdx].child[i]);
+        }
+
+        BvhNode& node = m_nodes[nodeIdx];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.min[axis][i] = bounds.min[axis];
+            node.max[axis][i] = bounds.max[axis];
+        }
+        nodeBounds.extend(bounds);
+    }
+    return nodeBounds;
+}
+
+uint32_t Bvh::collapse(const std::vector<BuildNode>& buildNodes, uint32_t buildIdx)
+{
+    // Children of the binary node are opened, largest surface area first,
+    // until there are as many subtrees as a wide node holds
+    uint32_t children[BvhNode::WIDTH] = { buildNodes[buildIdx].children[0], buildNodes[buildIdx].children[1] };
+    uint32_t childCount = 2;
+    while (childCount < BvhNode::WIDTH)
+    {
+        int largest = -1;
+        float largestArea = -1;
+        for (uint32_t i = 0; i < childCount; ++i)
+        {
+            const BuildNode& child = buildNodes[children[i]];
+            if (!child.isLeaf() && child.bounds.surfaceArea() > largestArea)
+            {
+                largest = i;
+                largestArea = child.bounds.surfaceArea();
+            }
+        }
+        if (largest < 0)
+        {
+            break;
+        }
+
+        uint32_t opened = children[largest];
+        children[largest] = buildNodes[opened].children[0];
+        children[childCount++] = buildNodes[opened].children[1];
+    }
+
+    uint32_t nodeIdx = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    m_nodes[nodeIdx].childCount = childCount;
+
+    for (uint32_t i = 0; i < BvhNode::WIDTH; ++i)
+    {
+        // Unused slots get empty boxes, traversal masks them out by childCount anyway
+        AABB bounds = i < childCount ? buildNodes[children[i]].bounds : AABB();
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            m_nodes[nodeIdx].min[axis][i] = bounds.min[axis];
+            m_nodes[nodeIdx].max[axis][i] = bounds.max[axis];
+        }
+        m_nodes[nodeIdx].child[i] = 0;
+        m_nodes[nodeIdx].count[i] = 0;
+    }
+
+    for (uint32_t i = 0; i < childCount; ++i)
+    {
+        const BuildNode& child = buildNodes[children[i]];
+        if (child.isLeaf())
+        {
+            m_nodes[nodeIdx].child[i] = child.offset;
+            m_nodes[nodeIdx].count[i] = child.count;
+        }
+        else
+        {
+            // Recursion may reallocate m_nodes, the node is addressed by index afterwards
+            uint32_t childIdx = collapse(buildNodes, children[i]);
+            m_nodes[nodeIdx].child[i] = childIdx;
+        }
+    }
+
+    return nodeIdx;
+}
+
+void Bvh::updateStatistics()
+{
+    m_statistics.nodeCount = static_cast<uint32_t>(m_nodes.size());
+    m_statistics.leafCount = 0;
+    m_statistics.maxLeafSize = 0;
+    m_statistics.sahCost = 0;
+    m_statistics.depth = computeStatistics(0, 1);
+
+    AABB rootBounds;
+    for (uint32_t i = 0; i < m_nodes[0].childCount; ++i)
+    {
+        rootBounds.extend(m_nodes[0].getBounds(i));
+    }
+    // Areas were summed unnormalized, a ray always visits the root
+    const float rootArea = rootBounds.surfaceArea();
+    m_statistics.sahCost = 1 + (rootArea > 0 ? m_statistics.sahCost / rootArea : 0.f);
+}
+
+uint32_t Bvh::computeStatistics(uint32_t nodeIdx, uint32_t depth)
+{
+    // Sums surface areas weighted by the cost of what lies inside them, normalized by the caller
+    const BvhNode& node = m_nodes[nodeIdx];
+    uint32_t maxDepth = depth;
+    for (uint32_t i = 0; i < node.childCount; ++i)
+    {
+        const float area = node.getBounds(i).surfaceArea();
+        if (node.isLeaf(i))
+        {
+            ++m_statistics.leafCount;
+            m_statistics.maxLeafSize = std::max(m_statistics.maxLeafSize, node.count[i]);
+            m_statistics.sahCost += area * node.count[i];
+        }
+        else
+        {
+            m_statistics.sahCost += area;
+            maxDepth = std::max(maxDepth, computeStatistics(node.child[i], depth + 1));
+        }
+    }
+    return maxDepth;
+}
+
+} // namespace sgl
@@ -0,0 +1,330 @@
+#pragma once
+
+#include "math/aabb.h"
+#include "math/simd.h"
+#include "math/vector.h"
+#include "context/ray.h"
+#include "context/ray_packet.h"
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace sgl
+{
+
+class ThreadPool;
+
+// Node of the four-wide hierarchy, bounds of the children are stored as structure
+// of arrays so that a ray is tested against all of them at once
+struct BvhNode
+{
+    static const int WIDTH = 4;
+
+    float min[3][WIDTH];
+    float max[3][WIDTH];
+    // Node index for inner children, first primitive (in leaf order) for leaf children
+    uint32_t child[WIDTH];
+    // Number of primitives of leaf children, zero for inner children
+    uint32_t count[WIDTH];
+    uint32_t childCount;
+
+    bool isLeaf(int i) const { return count[i] > 0; }
+
+    AABB getBounds(int i) const
+    {
+        return AABB(vec3(min[0][i], min[1][i], min[2][i]), vec3(max[0][i], max[1][i], max[2][i]));
+    }
+
+    // Slab test of a single ray (broadcast to all lanes) against the children, the same as
+    // AABB::intersect lane by lane. Returns entry distances, infinity for missed or unused children
+    float4 intersect(const vec3x4& origin, const vec3x4& invDir, const float4& tMax) const
+    {
+        const float4 farScale(AABB::FAR_SCALE);
+        const float4* origins[3] = { &origin.x, &origin.y, &origin.z };
+        const float4* invDirs[3] = { &invDir.x, &invDir.y, &invDir.z };
+
+        float4 tNear(0.f);
+        float4 tFar = tMax * farScale;
+        for (int i = 0; i < 3; ++i)
+        {
+            float4 t0 = (float4::load(min[i]) - *origins[i]) * *invDirs[i];
+            float4 t1 = (float4::load(max[i]) - *origins[i]) * *invDirs[i];
+            mask4 swap = t0 > t1;
+            float4 lo = select(swap, t1, t0);
+            float4 hi = select(swap, t0, t1) * farScale;
+            tNear = select(lo > tNear, lo, tNear);
+            tFar = select(hi < tFar, hi, tFar);
+        }
+
+        mask4 hit = (tNear <= tFar) & mask4::fromBits((1 << childCount) - 1);
+        return select(hit, tNear, float4(std::numeric_limits<float>::infinity()));
+    }
+};
+
+// Four-wide bounding volume hierarchy, built as a binary tree whose levels are then collapsed
+class Bvh
+{
+public:
+    static const int MAX_LEAF_SIZE = 4;
+    static const int BIN_COUNT = 16;
+    static const int STACK_SIZE = 256;
+    // Deepest level of the binary hierarchy. Traversal keeps at most WIDTH - 1 siblings on the stack
+    // for every wide node above a leaf, and wide nodes are no deeper than the binary ones they collapse
+    static constexpr uint32_t MAX_DEPTH = (STACK_SIZE - 1) / (BvhNode::WIDTH - 1) - 1;
+    // Nodes this deep are split at their median, which halves any number of primitives down to
+    // leaves within the remaining levels
+    static constexpr uint32_t BALANCED_DEPTH = MAX_DEPTH - 32;
+    // Bits of a Morton code per axis
+    static constexpr int MORTON_BITS = 10;
+    // Subtrees with fewer primitives are built by a single thread
+    static constexpr uint32_t MIN_TASK_SIZE = 1024;
+    // Refitted hierarchies more expensive than this many times their built cost should be rebuilt
+    static constexpr float MAX_REFIT_COST_RATIO = 2.f;
+
+    enum class Builder
+    {
+        // Binned surface area heuristic, the fastest traversal
+        SAH,
+        // Primitives sorted along a Morton curve and split by their codes, the fastest build
+        LBVH
+    };
+
+    struct Statistics
+    {
+        Builder builder = Builder::SAH;
+        // Duration of the build (or of the last refit) in milliseconds
+        float buildTime = 0;
+        uint32_t nodeCount = 0;
+        uint32_t leafCount = 0;
+        // Primitives of the largest leaf
+        uint32_t maxLeafSize = 0;
+        uint32_t depth = 0;
+        // Expected cost of tracing a ray in units of a single primitive intersection, with a node
+        // visit costing as much (the surface area heuristic of the final tree)
+        float sahCost = 0;
+        // Cost right after the build, refits keep it while sahCost follows the moving primitives
+        float builtSahCost = 0;
+    };
+
+    Bvh() = default;
+
+    // Builds the hierarchy over primitives given by their bounding boxes. With a thread pool the
+    // upper levels split their primitives in parallel and the subtrees below are built as
+    // separate tasks, the resulting hierarchy does not depend on the number of threads
+    void build(const std::vector<AABB>& primitiveBounds, Builder builder = Builder::SAH, ThreadPool* threadPool = nullptr);
+    // Updates bounds of all nodes to primitives that moved since the build, keeping the topology.
+    // Returns false once the hierarchy costs more than MAX_REFIT_COST_RATIO times its built cost
+    bool refit(const std::vector<AABB>& primitiveBounds);
+    void clear();
+    bool isEmpty() const;
+    uint32_t getPrimitiveCount() const;
+
+    const Statistics& getStatistics() const;
+
+    // Primitive indices in the order leaves refer to them
+    const std::vector<uint32_t>& getPrimitiveIndices() const;
+
+    // Visits leaves hit by the ray closer than tMax, front to back. The visitor is called as
+    // visitor(first, count, tMax) for primitives getPrimitiveIndices()[first, first + count)
+    // and may shrink tMax, returning true terminates the traversal.
+    template <typename Visitor>
+    void traverse(const Ray& ray, float tMax, Visitor&& visitor) const;
+
+    // Visits leaves hit by at least one active ray of the packet. The visitor is called as
+    // visitor(first, count, packet) and may shrink packet.tMax or clear bits of packet.active,
+    // the traversal ends once no lane is active.
+    template <typename Visitor>
+    void traverse(RayPacket& packet, Visitor&& visitor) const;
+
+private:
+    // Node of the intermediate binary hierarchy
+    struct BuildNode
+    {
+        AABB bounds;
+        // First primitive and primitive count of leaves, the count is zero for inner nodes
+        uint32_t offset;
+        uint32_t count;
+        uint32_t children[2];
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    // Input of a build shared by all threads taking part in it
+    struct BuildState
+    {
+        const std::vector<AABB>& primitiveBounds;
+        std::vector<vec3> centroids;
+        // Morton code of every primitive in leaf order, LBVH only
+        std::vector<uint32_t> mortonCodes;
+        Builder builder;
+        ThreadPool* threadPool;
+        // Nodes of at most this many primitives become tasks of the parallel build
+        uint32_t taskSize;
+    };
+
+    // Subtree of the parallel build, its root replaces the placeholder node
+    struct BuildTask
+    {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+
+    struct StackEntry
+    {
+        uint32_t index;
+        uint32_t count;
+        float tEntry;
+    };
+
+    // Builds the subtree over primitives [begin, end) at the given depth, nodes small enough to
+    // become tasks are left as placeholders and appended to tasks when they are given
+    uint32_t buildRecursive(BuildState& state, std::vector<BuildNode>& buildNodes, uint32_t begin, uint32_t end, uint32_t depth, std::vector<BuildTask>* tasks);
+    // Both return false when the primitives should form a leaf and set mid otherwise, the SAH
+    // split also computes the bounds of the node. Balanced splits put half of the primitives
+    // on each side
+    bool splitSah(BuildState& state, uint32_t begin, uint32_t end, bool parallel, bool balanced, AABB& bounds, uint32_t& mid);
+    bool splitMorton(const BuildState& state, uint32_t begin, uint32_t end, bool balanced, uint32_t& mid) const;
+    // Sorts m_primitiveIndices by Morton codes of their centroids
+    void sortMorton(BuildState& state);
+    // Bounds of the nodes above the tasks, which were not known before the tasks finished
+    AABB refit(std::vector<BuildNode>& buildNodes, uint32_t buildIdx, uint32_t topNodeCount);
+    // Bounds of the wide node after its subtree was refitted
+    AABB refitNode(const std::vector<AABB>& primitiveBounds, uint32_t nodeIdx);
+    uint32_t collapse(const std::vector<BuildNode>& buildNodes, uint32_t buildIdx);
+    // Fills node and leaf counts, depth and cost of the finished hierarchy
+    void updateStatistics();
+    // Counts leaves and sums the cost of the subtree into m_statistics, returns its depth
+    uint32_t computeStatistics(uint32_t nodeIdx, uint32_t depth);
+
+    // Pushes children with a finite entry distance far to near, so that the nearest one is popped first
+    static void pushChildren(const BvhNode& node, const float4& tEntries, StackEntry* stack, int& stackSize);
+
+    std::vector<BvhNode> m_nodes;
+    std::vector<uint32_t> m_primitiveIndices;
+    Statistics m_statistics;
+};
+
+inline void Bvh::pushChildren(const BvhNode& node, const float4& tEntries, StackEntry* stack, int& stackSize)
+{
+    float entries[BvhNode::WIDTH];
+    tEntries.store(entries);
+
+    const int first = stackSize;
+    for (uint32_t i = 0; i < node.childCount; ++i)
+    {
+        if (entries[i] == std::numeric_limits<float>::infinity())
+        {
+            continue;
+        }
+
+        // Insertion sort by decreasing entry distance
+        assert(stackSize < STACK_SIZE);
+        StackEntry entry = { node.child[i], node.count[i], entries[i] };
+        int j = stackSize++;
+        while (j > first && stack[j - 1].tEntry < entry.tEntry)
+        {
+            stack[j] = stack[j - 1];
+            --j;
+        }
+        stack[j] = entry;
+    }
+}
+
+template <typename Visitor>
+void Bvh::traverse(const Ray& ray, float tMax, Visitor&& visitor) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    const vec3x4 origin = vec3x4::broadcast(ray.origin);
+    const vec3x4 invDir = vec3x4::broadcast(vec3(1.f / ray.dir.x, 1.f / ray.dir.y, 1.f / ray.dir.z));
+
+    StackEntry stack[STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0.f };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.tEntry > tMax * AABB::FAR_SCALE)
+        {
+            continue;
+        }
+
+        if (entry.count > 0)
+        {
+            if (visitor(entry.index, entry.count, tMax))
+            {
+                return;
+            }
+            continue;
+        }
+
+        const BvhNode& node = m_nodes[entry.index];
+        pushChildren(node, node.intersect(origin, invDir, float4(tMax)), stack, stackSize);
+    }
+}
+
+template <typename Visitor>
+void Bvh::traverse(RayPacket& packet, Visitor&& visitor) const
+{
+    if (m_nodes.empty() || packet.active == 0)
+    {
+        return;
+    }
+
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+
+    // Rays of a coherent packet mostly agree on the order of children, so the first
+    // active ray orders them while all active rays decide which children are visited
+    int lead = 0;
+    while (!(packet.active & (1 << lead)))
+    {
+        ++lead;
+    }
+    const vec3x4 leadOrigin(float4(packet.origin.x[lead]), float4(packet.origin.y[lead]), float4(packet.origin.z[lead]));
+    const vec3x4 leadInvDir(float4(packet.invDir.x[lead]), float4(packet.invDir.y[lead]), float4(packet.invDir.z[lead]));
+    const float4 noLimit(std::numeric_limits<float>::max());
+
+    StackEntry stack[STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0, 0.f };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.count > 0)
+        {
+            visitor(entry.index, entry.count, packet);
+            if (packet.active == 0)
+            {
+                return;
+            }
+            continue;
+        }
+
+        const BvhNode& node = m_nodes[entry.index];
+        float order[BvhNode::WIDTH];
+        node.intersect(leadOrigin, leadInvDir, noLimit).store(order);
+
+        float entries[BvhNode::WIDTH] = { infinity, infinity, infinity, infinity };
+        for (uint32_t i = 0; i < node.childCount; ++i)
+        {
+            if (node.getBounds(i).intersect(packet.origin, packet.invDir, packet.tMax).bits() & packet.active)
+            {
+                // Children missed by the lead ray are visited last
+                entries[i] = order[i] != infinity ? order[i] : std::numeric_limits<float>::max();
+            }
+        }
+        pushChildren(node, float4::load(entries), stack, stackSize);
+    }
+}
+
+}
@@ -0,0 +1,171 @@
+#include "clipper.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace sgl
+{
+
+Clipper::Clipper(int width, int height)
+    : m_width(static_cast<float>(width)),
+      m_height(static_cast<float>(height))
+{
+}
+
+bool Clipper::clipPoint(const vec4& vertex, vec3& point) const
+{
+    if ((outsideGuardBand(vertex) & (1 << NEAR)) || !(vertex.w > 0))
+    {
+        return false;
+    }
+    point = vec3(vertex / vertex.w);
+    return true;
+}
+
+bool Clipper::clipLine(const vec4& a, const vec4& b, vec3& from, vec3& to) const
+{
+    if (outsideBuffer(a) & outsideBuffer(b))
+    {
+        return false;
+    }
+
+    // Parameters of the line from a to b that are left, cut down by each plane one of them is outside of
+    const uint32_t outside = outsideGuardBand(a) | outsideGuardBand(b);
+    float start = 0;
+    float end = 1;
+    for (int plane = 0; plane < PLANE_COUNT; ++plane)
+    {
+        if (!(outside & (1 << plane)))
+        {
+            continue;
+        }
+        const float distanceA = distance(a, plane, GUARD_BAND);
+        const float distanceB = distance(b, plane, GUARD_BAND);
+        if (distanceA < 0 && distanceB < 0)
+        {
+            return false;
+        }
+        const float t = distanceA / (distanceA - distanceB);
+        if (distanceA < 0)
+        {
+            start = std::max(start, t);
+        }
+        else if (distanceB < 0)
+        {
+            end = std::min(end, t);
+        }
+    }
+    if (start > end)
+    {
+        return false;
+    }
+
+    // The vertices inside are kept as they are
+    const vec4 clippedA = start > 0 ? a + start * (b - a) : a;
+    const vec4 clippedB = end < 1 ? a + end * (b - a) : b;
+    from = vec3(clippedA / clippedA.w);
+    to = vec3(clippedB / clippedB.w);
+    return true;
+}
+
+const std::vector<vec4>& Clipper::clipPolygon(const vec4* vertices, size_t count)
+{
+    m_clipped.clear();
+    uint32_t outsideAll = ~0u;
+    uint32_t outsideAny = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        outsideAll &= outsideBuffer(vertices[i]);
+        outsideAny |= outsideGuardBand(vertices[i]);
+    }
+    if (count == 0 || outsideAll)
+    {
+        return m_clipped;
+    }
+
+    if (outsideAny == 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_clipped.push_back(vertices[i] / vertices[i].w);
+        }
+        return m_clipped;
+    }
+
+    // Each plane a vertex is outside of cuts the polygon in turn, keeping the vertices inside of it and
+    // adding the points where the edges cross it
+    m_polygon.assign(vertices, vertices + count);
+    for (int plane = 0; plane < PLANE_COUNT && !m_polygon.empty(); ++plane)
+    {
+        if (!(outsideAny & (1 << plane)))
+        {
+            continue;
+        }
+        for (size_t i = 0; i < m_polygon.size(); ++i)
+        {
+            const vec4& a = m_polygon[i];
+            const vec4& b = m_polygon[(i + 1) % m_polygon.size()];
+            const float distanceA = distance(a, plane, GUARD_BAND);
+            const float distanceB = distance(b, plane, GUARD_BAND);
+            if (distanceA >= 0)
+            {
+                m_clipped.push_back(a);
+            }
+            if ((distanceA < 0) != (distanceB < 0))
+            {
+                m_clipped.push_back(a + (distanceA / (distanceA - distanceB)) * (b - a));
+            }
+        }
+        std::swap(m_polygon, m_clipped);
+        m_clipped.clear();
+    }
+
+    if (m_polygon.size() >= 3)
+    {
+        for (const vec4& v : m_polygon)
+        {
+            m_clipped.push_back(v / v.w);
+        }
+    }
+    return m_clipped;
+}
+
+float Clipper::distance(const vec4& vertex, int plane, float margin) const
+{
+    switch (plane)
+    {
+        case NEAR:
+            return vertex.z + vertex.w;
+        case LEFT:
+            return vertex.x + margin * vertex.w;
+        case RIGHT:
+            return (m_width + margin) * vertex.w - vertex.x;
+        case BOTTOM:
+            return vertex.y + margin * vertex.w;
+        default:
+            return (m_height + margin) * vertex.w - vertex.y;
+    }
+}
+
+uint32_t Clipper::outsideBuffer(const vec4& vertex) const
+{
+    // A pixel past the sides, which coordinates truncated toward zero still reach
+    uint32_t outside = 0;
+    for (int plane = 0; plane < PLANE_COUNT; ++plane)
+    {
+        outside |= static_cast<uint32_t>(distance(vertex, plane, 1.f) < 0) << plane;
+    }
+    return outside;
+}
+
+uint32_t Clipper::outsideGuardBand(const vec4& vertex) const
+{
+    uint32_t outside = 0;
+    for (int plane = 0; plane < PLANE_COUNT; ++plane)
+    {
+        outside |= static_cast<uint32_t>(distance(vertex, plane, GUARD_BAND) < 0) << plane;
+    }
+    return outside;
+}
+
+}
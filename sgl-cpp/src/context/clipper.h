@@ -0,0 +1,67 @@
+#pragma once
+
+#include "math/vector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sgl
+{
+
+// Clips primitives in homogeneous window coordinates, the ones the PVM matrix gives before the
+// divide by w, and divides what is left of them. The frustum is clipped at the near plane, z of at
+// least -w, which takes out whatever lies behind the camera before w changes sign. Along x and y it is
+// clipped only at a guard band around the buffer. Primitives within the guard band are drawn whole and
+// the rasterizer skips their pixels outside the buffer, which costs nothing for the rows and columns
+// it never visits, without the vertices clipping at the sides of the buffer would add. Depths beyond
+// the far plane are drawn as they always were.
+//
+// A primitive with every vertex outside the same side of the buffer, or in front of the near plane,
+// is rejected before anything else is done with it.
+class Clipper
+{
+public:
+    // Pixels the guard band reaches past each side of the buffer. Coordinates within it stay far from
+    // Rasterizer::MAX_COORDINATE, and lines walk at most as many pixels outside the buffer.
+    static constexpr float GUARD_BAND = 4096.f;
+
+    Clipper() = default;
+    Clipper(int width, int height);
+
+    // Window coordinates of the point, false when it lies in front of the near plane
+    bool clipPoint(const vec4& vertex, vec3& point) const;
+    // Window coordinates of the part of the line from a to b behind the near plane and within the
+    // guard band, false when there is none
+    bool clipLine(const vec4& a, const vec4& b, vec3& from, vec3& to) const;
+    // Window coordinates of the polygon clipped to the near plane and the guard band, with w of 1. Empty
+    // when it is rejected or nothing of it is left, valid until the next call
+    const std::vector<vec4>& clipPolygon(const vec4* vertices, size_t count);
+
+private:
+    // Near plane and sides of the buffer or of the guard band, a vertex is inside one when its distance
+    // is not negative
+    enum Plane
+    {
+        NEAR,
+        LEFT,
+        RIGHT,
+        BOTTOM,
+        TOP,
+        PLANE_COUNT
+    };
+
+    // Distance of the vertex to the plane scaled by w, with the sides moved out by margin pixels
+    float distance(const vec4& vertex, int plane, float margin) const;
+    // Bit 1 << plane for every side of the buffer the vertex lies outside of
+    uint32_t outsideBuffer(const vec4& vertex) const;
+    // Bit 1 << plane for every plane the vertex lies outside of, the sides being the ones of the guard band
+    uint32_t outsideGuardBand(const vec4& vertex) const;
+
+    float m_width = 0;
+    float m_height = 0;
+    std::vector<vec4> m_polygon;
+    std::vector<vec4> m_clipped;
+};
+
+}
@@ -17,6 +17,8 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <new>
+#include <tuple>
 
 #pragma GCC diagnostic ignored "-Wsign-compare"
 
@@ -48,13 +50,23 @@ namespace sgl
           m_drawColor(0.0, 0.0, 0.0),
           m_colorBuffer(width * height, sgl::vec3(0.0, 0.0, 0.0)),
           m_depthBuffer(width * height, std::numeric_limits<float>::max()),
+          m_hierarchicalZ(width, height, std::numeric_limits<float>::max()),
           m_areaMode(SGL_LINE),
-          m_fillFunc(std::bind(&Context::fill, this, std::placeholders::_1)),
+          m_fillFunc(&Context::fill),
+          m_clipper(width, height),
           m_elementType(SGL_LAST_ELEMENT_TYPE),
           m_PVM(mat4::identity),
           m_isSpecifyingScene(false),
           m_scenePrimitives(0),
-          m_currentMaterial(nullptr)
+          m_currentMaterial(nullptr),
+          m_threadCount(0),
+          m_tileSize(16),
+          m_packetTracing(true),
+          m_hybridTracing(false),
+          m_minSamples(1),
+          m_maxSamples(16),
+          m_noiseTarget(0.1f),
+          m_bvhBuilder(Bvh::Builder::SAH)
     {
         m_modelStack.push_back(mat4::identity);
         m_projectionStack.push_back(mat4::identity);
@@ -67,6 +79,7 @@ namespace sgl
 
     void Context::clearBuffers(unsigned what)
     {
+        flushRaster();
         if (what & SGL_COLOR_BUFFER_BIT)
         {
             std::fill(m_colorBuffer.begin(), m_colorBuffer.end(), m_clearColor);
@@ -74,11 +87,13 @@ namespace sgl
         if (what & SGL_DEPTH_BUFFER_BIT)
         {
             std::fill(m_depthBuffer.begin(), m_depthBuffer.end(), std::numeric_limits<float>::max());
+            m_hierarchicalZ.clear(std::numeric_limits<float>::max());
         }
     }
 
     float* Context::colorBufferData()
     {
+        flushRaster();
         if (m_colorBuffer.size() == 0) return nullptr;
         return reinterpret_cast<float*>(m_colorBuffer.data());
     }
@@ -91,15 +106,24 @@ namespace sgl
     void Context::setDrawColor(const vec3& color) 
     {
         m_drawColor = color;
+        if (m_isRecordingList)
+        {
+            recordCommand(DisplayList::CommandType::COLOR, 0, color, 0);
+        }
     }
 
     void Context::setPointSize(float newSize) 
     {    
         m_pointSize = newSize;
+        if (m_isRecordingList)
+        {
+            recordCommand(DisplayList::CommandType::POINT_SIZE, 0, vec3(), newSize);
+        }
     }
 
     void Context::drawLine(vec3 p1f, vec3 p2f) 
     {
+        flushRaster();
         vec3i p1(p1f);
         vec3i p2(p2f);
 
@@ -112,7 +136,7 @@ namespace sgl
         int err = dx - dy;
 
         std::function putPixelFunc = [&](const vec3i& p, const vec3& color) { putPixel(p, color); };
-        if (m_features.test(SGL_DEPTH_TEST))
+        if (isFeatureEnabled(SGL_DEPTH_TEST))
         {
             putPixelFunc = [&](const vec3i& p, const vec3& c) { putPixelDepth(p, c); };
         }
@@ -155,8 +179,11 @@ namespace sgl
 
         if (features & SGL_DEPTH_TEST)
         {
-            using namespace std::placeholders;
-            m_fillFunc = std::bind(&Context::fillDepth, this, _1);
+            m_fillFunc = &Context::fillDepth;
+        }
+        if (m_isRecordingList)
+        {
+            recordCommand(DisplayList::CommandType::ENABLE, features, vec3(), 0);
         }
     }
 
@@ -166,11 +193,19 @@ namespace sgl
 
         if (features & SGL_DEPTH_TEST)
         {
-            using namespace std::placeholders;
-            m_fillFunc = std::bind(&Context::fill, this, _1);
+            m_fillFunc = &Context::fill;
+        }
+        if (m_isRecordingList)
+        {
+            recordCommand(DisplayList::CommandType::DISABLE, features, vec3(), 0);
         }
     }
 
+    bool Context::isFeatureEnabled(uint32_t feature) const
+    {
+        return (m_features.to_ulong() & feature) != 0;
+    }
+
     void Context::putPixel(int x, int y, const vec3& color)
     {
         assert(m_isInitialized);
@@ -192,6 +227,7 @@ namespace sgl
         if (z < m_depthBuffer[idx])
         {
             m_depthBuffer[idx] = z;
+            m_hierarchicalZ.write(x, y, z);
             m_colorBuffer[idx] = color;
         }
     }
@@ -208,9 +244,13 @@ namespace sgl
 
     void Context::putPixelRow(int startX, int endX, int y, const vec3& color)
     {
-        assert(startX <= endX && y >= 0 && y < m_height);
+        assert(startX <= endX);
         startX = std::max(startX, 0);
         endX = std::min(endX, static_cast<int>(m_width));
+        if (y < 0 || y >= m_height || startX >= endX)
+        {
+            return;
+        }
         auto startIt = m_colorBuffer.begin() + point2idx(startX, y);
         auto endIt = m_colorBuffer.begin() + point2idx(endX, y);
         std::fill(startIt, endIt, color);
@@ -218,15 +258,26 @@ namespace sgl
 
     void Context::putPixelRowDepth(int startX, int endX, int y, float startZ, float endZ, const vec3& color)
     {
-        assert(startX <= endX && y >= 0 && y < m_height);
+        assert(startX <= endX);
         startX = std::max(startX, 0);
         endX = std::min(endX, static_cast<int>(m_width));
+        if (y < 0 || y >= m_height)
+        {
+            return;
+        }
 
+        // The columns are within the row, which needs no test of its pixels
         float zStep = (endZ-startZ)/(endX - startX);
         float z = startZ;
+        const int row = point2idx(0, y);
         for (int i = startX; i < endX; ++i)
         {
-            putPixelDepth(i, y, z, color);
+            if (z < m_depthBuffer[row + i])
+            {
+                m_depthBuffer[row + i] = z;
+                m_hierarchicalZ.write(i, y, z);
+                m_colorBuffer[row + i] = color;
+            }
             z += zStep;
         }
     }
@@ -242,20 +293,26 @@ namespace sgl
         putPixelRowDepth(start.x, end.x, start.y, start.z, end.z, color);
     }
 
-    vec3 Context::castRay(const Ray& ray, int depth) const 
+    vec3 Context::castRay(const Ray& ray, Sampler& sampler, OccluderCache& occluders, int depth) const 
     {   
         if (depth > Ray::MAX_DEPTH)
         {
             return m_clearColor;
         }
 
-        vec3 resultColor;
+        return shadeRay(ray, traceRay(ray), sampler, occluders, depth);
+    }
 
-        auto [anyHit, hitPoint, hitPrimitive] = traceRay(ray);
+    vec3 Context::shadeRay(const Ray& ray, const TraceRayResult& hit, Sampler& sampler, OccluderCache& occluders, int depth, const uint8_t* lightVisibility) const
+    {
+        vec3 resultColor;
 
-        if (anyHit)
+        if (hit.anyHit)
         {
-            vec3 normal = hitPrimitive->getNormal(hitPoint);
+            const vec3& hitPoint = hit.hitPoint;
+            const Primitive* hitPrimitive = &getHitPrimitive(hit);
+            const vec3 surfaceNormal = getHitNormal(hit);
+            vec3 normal = surfaceNormal;
             float ior = hitPrimitive->getMaterial().ior;
             
             if (ray.type == Ray::Type::INSIDE)
@@ -267,7 +324,7 @@ namespace sgl
             vec3 reflected = vec3(0);
             if (hitPrimitive->getMaterial().ks != 0) {
                 vec3 reflectedDir = math::reflect(ray.dir, normal);
-                reflected = hitPrimitive->getMaterial().ks * castRay(Ray(hitPoint, reflectedDir, ray.type), depth+1);
+                reflected = hitPrimitive->getMaterial().ks * castRay(Ray(hitPoint, reflectedDir, ray.type), sampler, occluders, depth+1);
             }
 
             vec3 refracted = vec3(0);
@@ -276,21 +333,46 @@ namespace sgl
                 if (refractedDir != vec3())
                 {
                     Ray::Type rayType = ray.type == Ray::Type::INSIDE ? Ray::Type::NORMAL : Ray::Type::INSIDE;
-                    refracted = hitPrimitive->getMaterial().T * castRay(Ray(hitPoint + refractedDir * 0.0018, refractedDir, rayType), depth + 1);
+                    refracted = hitPrimitive->getMaterial().T * castRay(Ray(hitPoint + refractedDir * 0.0018, refractedDir, rayType), sampler, occluders, depth + 1);
                 }
             }
         
-            for (auto light : m_sceneLights)
+            const Material& material = hitPrimitive->getMaterial();
+            if (material.isEmissive())
+            {
+                resultColor = material.getColor();
+            }
+            else
             {
-                resultColor += calculatePhong(hitPrimitive->getMaterial(), hitPoint, hitPrimitive->getNormal(hitPoint), math::normalize(vec3(ray.origin) - hitPoint), *light, hitPrimitive);
+                const vec3 camera = math::normalize(vec3(ray.origin) - hitPoint);
+                const vec3 color = surfaceColor(ray, hit, surfaceNormal);
+                for (size_t j = 0; j < m_sceneLights.size(); ++j)
+                {
+                    const Light& light = *m_sceneLights[j];
+                    if (light.isAreaLight())
+                    {
+                        continue;
+                    }
+                    const uint8_t* visibility = lightVisibility ? &lightVisibility[j] : nullptr;
+                    resultColor += calculatePhong(material, color, hitPoint, surfaceNormal, camera, light, occluders[j], visibility);
+                }
+
+                if (!m_areaLightTree.isEmpty())
+                {
+                    resultColor += calculateAreaLights(material, color, hitPoint, surfaceNormal, camera, sampler, occluders);
+                }
             }
 
             return resultColor + reflected + refracted;
         }
 
+        return background(ray.dir);
+    }
+
+    vec3 Context::background(const vec3& dir) const
+    {
         if (m_hasEnvironmentMap)
         {
-            vec3 dir = ray.dir;
             float d = sqrt(dir.x * dir.x + dir.y * dir.y);
             float r = d > 0.0f ? acos(dir.z) / (2 * M_PI * d) : 0.0f;
             float u = 0.5f + dir.x * r;
@@ -310,50 +392,310 @@ namespace sgl
         return m_clearColor;
     }
 
-    Context::TraceRayResult Context::traceRay(const Ray& cray, bool anyHit, float eps) const 
+    Context::TraceRayResult Context::traceRay(const Ray& cray) const
     {
         Ray ray = cray;
+        ray.dir = math::normalize(ray.dir);
 
-        std::shared_ptr<Primitive> closestPrimitive = nullptr;
-        vec3 closestIntersection;
-
+        TraceRayResult result = { false, vec3(), 0 };
         float closestDistance = std::numeric_limits<float>::max();
-        if (anyHit)
+        result.anyHit = traceGeometry(m_sceneBvh, m_sceneGeometry, ray, closestDistance, result.primitiveIdx, result.hitPoint);
+        if (!m_instances.empty())
         {
-            closestDistance = math::length(ray.dir) - 0.95;
+            traceInstances(ray, closestDistance, result);
         }
-        ray.dir = math::normalize(ray.dir);
-    
-        for (const auto& primitive : m_scenePrimitives)
-        {
-            if (primitive->getMaterial().isEmissive() && anyHit)
+        return result;
+    }
+
+    bool Context::traceGeometry(const Bvh& bvh, const SceneGeometry& geometry, const Ray& ray, float& closestDistance, uint32_t& closestIdx, vec3& closestIntersection) const
+    {
+        bool hasHit = false;
+
+        const vec3x4 origin = vec3x4::broadcast(ray.origin);
+        const vec3x4 dir = vec3x4::broadcast(ray.dir);
+        const bool cullBackFaces = ray.type != Ray::Type::INSIDE;
+
+        bvh.traverse(ray, closestDistance, [&](uint32_t first, uint32_t count, float& tMax) {
+            for (uint32_t position = first; position < first + count; position += BvhNode::WIDTH)
             {
-                continue;
+                const uint32_t lanes = std::min<uint32_t>(first + count - position, BvhNode::WIDTH);
+                vec3x4 points;
+                float4 distances;
+                const int hits = geometry.intersect(position, lanes, origin, dir, cullBackFaces, false, points, distances);
+                if (hits == 0)
+                {
+                    continue;
+                }
+
+                for (uint32_t lane = 0; lane < lanes; ++lane)
+                {
+                    if (!(hits & (1 << lane)))
+                    {
+                        continue;
+                    }
+
+                    const uint32_t primitiveIdx = geometry.getPrimitiveIndex(position + lane);
+                    const float distance = distances[lane];
+                    // Ties are resolved by submission order so the result does not depend on the traversal order
+                    if (distance < closestDistance || (distance == closestDistance && hasHit && primitiveIdx < closestIdx))
+                    {
+                        hasHit = true;
+                        closestDistance = distance;
+                        closestIntersection = vec3(points.x[lane], points.y[lane], points.z[lane]);
+                        closestIdx = primitiveIdx;
+                        tMax = distance;
+                    }
+                }
             }
+            return false;
+        });
+
+        return hasHit;
+    }
 
-            auto [isIntersected, point, t] = primitive->intersect(ray);
-            if (isIntersected)
+    void Context::traceInstances(const Ray& ray, float& closestDistance, TraceRayResult& result) const
+    {
+        m_instanceBvh.traverse(ray, closestDistance, [&](uint32_t first, uint32_t count, float& tMax) {
+            for (uint32_t position = first; position < first + count; ++position)
             {
-                if (ray.type != Ray::Type::INSIDE && math::dotProduct(ray.dir, primitive->getNormal(point)) > 0)
+                const uint32_t instanceIdx = m_instanceBvh.getPrimitiveIndices()[position];
+                const Instance& instance = m_instances[instanceIdx];
+
+                float scale;
+                const Ray objectRay = instance.rayToObject(ray, scale);
+                float distance = closestDistance * scale;
+                uint32_t primitiveIdx;
+                vec3 point;
+                if (!traceGeometry(instance.mesh->getBvh(), instance.mesh->getGeometry(), objectRay, distance, primitiveIdx, point))
                 {
                     continue;
                 }
-                float distance = math::distance(ray.origin, point);
-                if (distance < closestDistance)
+
+                // Instances follow the scene's own primitives in submission order
+                distance /= scale;
+                if (distance < closestDistance || (distance == closestDistance && result.anyHit && result.instanceIdx != NO_INSTANCE
+                    && std::tie(instanceIdx, primitiveIdx) < std::tie(result.instanceIdx, result.primitiveIdx)))
                 {
                     closestDistance = distance;
-                    closestIntersection = point;
-                    closestPrimitive = primitive;
+                    result = { true, vec3(instance.toWorld * vec4(point, 1)), primitiveIdx, instanceIdx };
+                    tMax = distance;
+                }
+            }
+            return false;
+        });
+    }
+
+    void Context::traceRayPacket(const vec3* origins, const vec3* dirs, int count, TraceRayResult* results, Ray::Type type) const
+    {
+        vec3 normalizedDirs[RayPacket::SIZE];
+        float closestDistance[RayPacket::SIZE];
+
+        // Same normalization as traceRay applies to a single ray
+        for (int lane = 0; lane < count; ++lane)
+        {
+            closestDistance[lane] = std::numeric_limits<float>::max();
+            normalizedDirs[lane] = math::normalize(dirs[lane]);
+            results[lane] = { false, vec3(), 0 };
+        }
+
+        RayPacket packet(origins, normalizedDirs, closestDistance, count, type);
+
+        m_sceneBvh.traverse(packet, [&](uint32_t first, uint32_t count, RayPacket& packet) {
+            for (uint32_t position = first; position < first + count && packet.active; ++position)
+            {
+                vec3x4 points;
+                float4 distances;
+                const int lanes = m_sceneGeometry.intersect(position, packet, false, points, distances);
+                if (lanes == 0)
+                {
+                    continue;
+                }
 
-                    if (anyHit)
+                const uint32_t primitiveIdx = m_sceneGeometry.getPrimitiveIndex(position);
+                for (int lane = 0; lane < RayPacket::SIZE; ++lane)
+                {
+                    if (!(lanes & (1 << lane)))
                     {
-                        break;
+                        continue;
+                    }
+
+                    const float distance = distances[lane];
+                    TraceRayResult& result = results[lane];
+                    if (distance < closestDistance[lane] || (distance == closestDistance[lane] && result.anyHit && primitiveIdx < result.primitiveIdx))
+                    {
+                        closestDistance[lane] = distance;
+                        result = { true, vec3(points.x[lane], points.y[lane], points.z[lane]), primitiveIdx };
+                        packet.tMax.set(lane, distance);
+                    }
+                }
+            }
+        });
+
+        // Instances are visited ray by ray, which keeps the results identical to traceRay
+        if (!m_instances.empty())
+        {
+            for (int lane = 0; lane < count; ++lane)
+            {
+                traceInstances(Ray(origins[lane], normalizedDirs[lane], type), closestDistance[lane], results[lane]);
+            }
+        }
+    }
+
+    bool Context::isOccluded(const Ray& ray, float tMax, uint32_t& lastOccluder) const
+    {
+        // Neighbouring shadow rays towards the same light tend to be blocked by the same primitive
+        if (lastOccluder != NO_OCCLUDER && m_sceneGeometry.occlude(lastOccluder, 1, vec3x4::broadcast(ray.origin), vec3x4::broadcast(ray.dir), float4(tMax), ray.type != Ray::Type::INSIDE))
+        {
+            return true;
+        }
+
+        const uint32_t occluder = occludeGeometry(m_sceneBvh, m_sceneGeometry, ray, tMax);
+        if (occluder != NO_OCCLUDER)
+        {
+            lastOccluder = occluder;
+            return true;
+        }
+
+        // Only the scene's own primitives are remembered as occluders
+        return !m_instances.empty() && isOccludedByInstances(ray, tMax);
+    }
+
+    uint32_t Context::occludeGeometry(const Bvh& bvh, const SceneGeometry& geometry, const Ray& ray, float tMax) const
+    {
+        const vec3x4 origin = vec3x4::broadcast(ray.origin);
+        const vec3x4 dir = vec3x4::broadcast(ray.dir);
+        const float4 limit(tMax);
+        const bool cullBackFaces = ray.type != Ray::Type::INSIDE;
+
+        uint32_t occluder = NO_OCCLUDER;
+        bvh.traverse(ray, tMax, [&](uint32_t first, uint32_t count, float& /* tMax */) {
+            for (uint32_t position = first; position < first + count; position += BvhNode::WIDTH)
+            {
+                const uint32_t lanes = std::min<uint32_t>(first + count - position, BvhNode::WIDTH);
+                const int blocked = geometry.occlude(position, lanes, origin, dir, limit, cullBackFaces);
+                if (blocked)
+                {
+                    int lane = 0;
+                    while (!(blocked & (1 << lane)))
+                    {
+                        ++lane;
                     }
+                    occluder = position + lane;
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        return occluder;
+    }
+
+    bool Context::isOccludedByInstances(const Ray& ray, float tMax) const
+    {
+        bool occluded = false;
+        m_instanceBvh.traverse(ray, tMax, [&](uint32_t first, uint32_t count, float& /* tMax */) {
+            for (uint32_t position = first; position < first + count; ++position)
+            {
+                const Instance& instance = m_instances[m_instanceBvh.getPrimitiveIndices()[position]];
+                float scale;
+                const Ray objectRay = instance.rayToObject(ray, scale);
+                if (occludeGeometry(instance.mesh->getBvh(), instance.mesh->getGeometry(), objectRay, tMax * scale) != NO_OCCLUDER)
+                {
+                    occluded = true;
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        return occluded;
+    }
+
+    int Context::isOccluded(const vec3* origins, const vec3* dirs, const float* tMax, int count, uint32_t& lastOccluder) const
+    {
+        RayPacket packet(origins, dirs, tMax, count);
+
+        int occluded = 0;
+        if (lastOccluder != NO_OCCLUDER)
+        {
+            occluded = m_sceneGeometry.occlude(lastOccluder, packet);
+            packet.active &= ~occluded;
+        }
+
+        m_sceneBvh.traverse(packet, [&](uint32_t first, uint32_t count, RayPacket& packet) {
+            for (uint32_t position = first; position < first + count && packet.active; ++position)
+            {
+                const int blocked = m_sceneGeometry.occlude(position, packet);
+                if (blocked)
+                {
+                    lastOccluder = position;
+                    occluded |= blocked;
+                    packet.active &= ~blocked;
+                }
+            }
+        });
+
+        if (!m_instances.empty())
+        {
+            for (int lane = 0; lane < count; ++lane)
+            {
+                if (!(occluded & (1 << lane)) && isOccludedByInstances(Ray(origins[lane], dirs[lane]), tMax[lane]))
+                {
+                    occluded |= 1 << lane;
                 }
             }
         }
 
-        return { closestPrimitive != nullptr, closestIntersection, closestPrimitive };
+        return occluded;
+    }
+
+    void Context::tracePrimaryPacket(const vec3* origins, const vec3* dirs, int count, TraceRayResult* hits, OccluderCache& occluders, uint8_t* lightVisibility) const
+    {
+        traceRayPacket(origins, dirs, count, hits);
+        traceShadowPackets(hits, count, occluders, lightVisibility);
+    }
+
+    void Context::traceShadowPackets(const TraceRayResult* hits, int count, OccluderCache& occluders, uint8_t* lightVisibility) const
+    {
+        const size_t lightCount = m_sceneLights.size();
+        for (size_t j = 0; j < lightCount; ++j)
+        {
+            const Light& light = *m_sceneLights[j];
+            if (light.isAreaLight())
+            {
+                continue;
+            }
+
+            vec3 shadowOrigins[RayPacket::SIZE];
+            vec3 shadowDirs[RayPacket::SIZE];
+            float shadowTMax[RayPacket::SIZE];
+            int shadowLanes[RayPacket::SIZE];
+            int shadowCount = 0;
+
+            for (int lane = 0; lane < count; ++lane)
+            {
+                lightVisibility[lane * lightCount + j] = 1;
+                if (hits[lane].anyHit && !getHitPrimitive(hits[lane]).getMaterial().isEmissive())
+                {
+                    const vec3 lightDir = light.getDirection(hits[lane].hitPoint, vec2());
+                    shadowOrigins[shadowCount] = hits[lane].hitPoint;
+                    shadowDirs[shadowCount] = math::normalize(lightDir);
+                    shadowTMax[shadowCount] = light.getShadowDistance(lightDir);
+                    shadowLanes[shadowCount++] = lane;
+                }
+            }
+
+            if (shadowCount == 0)
+            {
+                continue;
+            }
+
+            const int occluded = isOccluded(shadowOrigins, shadowDirs, shadowTMax, shadowCount, occluders[j]);
+            for (int i = 0; i < shadowCount; ++i)
+            {
+                lightVisibility[shadowLanes[i] * lightCount + j] = !(occluded & (1 << i));
+            }
+        }
     }
 
     void Context::beginPrimitive(uint32_t elementType) 
@@ -367,10 +709,14 @@ namespace sgl
     void Context::addVertex(const vec4& vertex) 
     {
         assert(m_isDrawing);
-        if (!m_isSpecifyingScene)
+        if (m_isRecordingList)
+        {
+            m_vertexBuffer.push_back(getModelView() * vertex);
+        }
+        else if (!m_isSpecifyingScene && !m_isSpecifyingMesh)
         {
-            vec4 transformed = m_PVM * vertex;
-            m_vertexBuffer.push_back(transformed / transformed.w);
+            // Divided by w once clipped, by drawBuffer
+            m_vertexBuffer.push_back(m_PVM * vertex);
         }
         else 
         {
@@ -389,12 +735,29 @@ namespace sgl
         assert(m_elementType != SGL_LAST_ELEMENT_TYPE && m_isDrawing);
         if ((m_elementType > SGL_POINTS && m_vertexBuffer.size() < 2))
         {
+            m_isDrawing = false;
             m_elementType = SGL_LAST_ELEMENT_TYPE;
             m_vertexBuffer.clear();
             return;
         }
 
-        if (m_isSpecifyingScene)
+        if (m_isRecordingList)
+        {
+            DisplayList& list = m_lists.back();
+            const uint32_t first = static_cast<uint32_t>(list.vertices.size());
+            list.vertices.insert(list.vertices.end(), m_vertexBuffer.begin(), m_vertexBuffer.end());
+            list.commands.push_back({ DisplayList::CommandType::PRIMITIVE, m_elementType, first, static_cast<uint32_t>(m_vertexBuffer.size()), vec3(), 0 });
+        }
+        else if (m_isSpecifyingMesh)
+        {
+            assert((m_elementType == SGL_POLYGON || m_elementType == SGL_TRIANGLES) && m_vertexBuffer.size() == 3);
+#ifndef SGL_TEXTURES_ENABLED
+            m_meshes[m_currentMesh]->addPrimitive(std::make_shared<Triangle>(m_currentMaterial, m_vertexBuffer[0], m_vertexBuffer[1], m_vertexBuffer[2]));
+#else
+            m_meshes[m_currentMesh]->addPrimitive(std::make_shared<Triangle>(m_currentMaterial, m_vertexBuffer[0], m_vertexBuffer[1], m_vertexBuffer[2], vec2(1, 1), vec2(1,0), vec2(0, 0)));
+#endif
+        }
+        else if (m_isSpecifyingScene)
         {
             switch (m_elementType)
             {
@@ -432,6 +795,148 @@ namespace sgl
         m_vertexBuffer.clear();
     }
 
+    void Context::setVertexPointer(int size, int stride, const float* pointer)
+    {
+        m_vertexSize = size;
+        m_vertexStride = stride ? stride : size * static_cast<int>(sizeof(float));
+        m_vertexPointer = pointer;
+    }
+
+    bool Context::hasVertexPointer() const
+    {
+        return m_vertexPointer != nullptr;
+    }
+
+    void Context::drawArrays(uint32_t elementType, int first, int count)
+    {
+        drawVertexArray(elementType, count, [first](int i) { return static_cast<uint32_t>(first + i); });
+    }
+
+    void Context::drawElements(uint32_t elementType, int count, const uint32_t* indices)
+    {
+        drawVertexArray(elementType, count, [indices](int i) { return indices[i]; });
+    }
+
+    vec4 Context::getArrayVertex(uint32_t index) const
+    {
+        const float* v = reinterpret_cast<const float*>(reinterpret_cast<const char*>(m_vertexPointer) + static_cast<size_t>(index) * m_vertexStride);
+        return vec4(v[0], v[1], m_vertexSize > 2 ? v[2] : 0.f, m_vertexSize > 3 ? v[3] : 1.f);
+    }
+
+    template <typename Indices>
+    void Context::drawVertexArray(uint32_t elementType, int count, Indices indices)
+    {
+        assert(m_vertexPointer && !m_isDrawing);
+        if (m_isSpecifyingScene || m_isSpecifyingMesh)
+        {
+            assert(elementType == SGL_TRIANGLES || (elementType == SGL_POLYGON && count == 3));
+            const int triangleCount = count / 3;
+            m_arrayTriangles.resize(9 * triangleCount);
+            for (int i = 0; i < 3 * triangleCount; ++i)
+            {
+                const vec4 v = getArrayVertex(indices(i));
+                m_arrayTriangles[3 * i] = v.x;
+                m_arrayTriangles[3 * i + 1] = v.y;
+                m_arrayTriangles[3 * i + 2] = v.z;
+            }
+            addTriangles(m_arrayTriangles.data(), triangleCount);
+            return;
+        }
+
+        beginPrimitive(elementType);
+        m_vertexBuffer.reserve(count);
+        // Recorded lists keep the vertices relative to the modelview they are called with
+        const mat4& transform = m_isRecordingList ? getModelView() : m_PVM;
+        for (int i = 0; i < count; ++i)
+        {
+            m_vertexBuffer.push_back(transform * getArrayVertex(indices(i)));
+        }
+        endPrimitive();
+    }
+
+    int Context::newList()
+    {
+        m_listState = { m_modelStack, m_isModelActive, m_drawColor, m_areaMode, m_pointSize, m_features, m_fillFunc };
+        // Transformations recorded start from the modelview the list is called with
+        m_modelStack.assign(1, mat4::identity);
+        m_isModelActive = true;
+        m_isRecordingList = true;
+        m_lists.emplace_back();
+        return static_cast<int>(m_lists.size() - 1);
+    }
+
+    void Context::endList()
+    {
+        m_lists.back().transform = getModelView();
+        m_isRecordingList = false;
+        m_modelStack = std::move(m_listState.modelStack);
+        m_isModelActive = m_listState.isModelActive;
+        m_drawColor = m_listState.drawColor;
+        m_areaMode = m_listState.areaMode;
+        m_pointSize = m_listState.pointSize;
+        m_features = m_listState.features;
+        m_fillFunc = m_listState.fillFunc;
+        updatePVM();
+    }
+
+    bool Context::isRecordingList() const
+    {
+        return m_isRecordingList;
+    }
+
+    bool Context::hasList(int list) const
+    {
+        return list >= 0 && list < static_cast<int>(m_lists.size()) - (m_isRecordingList ? 1 : 0);
+    }
+
+    void Context::callList(int list)
+    {
+        assert(hasList(list) && !m_isRecordingList && !m_isDrawing);
+        const DisplayList& displayList = m_lists[list];
+        updatePVM();
+        m_listVertices.resize(displayList.vertices.size());
+        for (size_t i = 0; i < displayList.vertices.size(); ++i)
+        {
+            m_listVertices[i] = m_PVM * displayList.vertices[i];
+        }
+
+        for (const DisplayList::Command& command : displayList.commands)
+        {
+            switch (command.type)
+            {
+                case DisplayList::CommandType::COLOR:
+                    setDrawColor(command.vector);
+                    break;
+                case DisplayList::CommandType::AREA_MODE:
+                    setAreaMode(command.value);
+                    break;
+                case DisplayList::CommandType::POINT_SIZE:
+                    setPointSize(command.scalar);
+                    break;
+                case DisplayList::CommandType::ENABLE:
+                    enableFeatures(command.value);
+                    break;
+                case DisplayList::CommandType::DISABLE:
+                    disableFeatures(command.value);
+                    break;
+                case DisplayList::CommandType::PRIMITIVE:
+                    drawPrimitive(command.value, m_listVertices.data() + command.first, static_cast<int>(command.count));
+                    break;
+                case DisplayList::CommandType::CIRCLE:
+                    drawCircle(command.vector, command.scalar);
+                    break;
+            }
+        }
+
+        m_modelStack.back() = m_modelStack.back() * displayList.transform;
+        updatePVM();
+    }
+
+    void Context::recordCommand(DisplayList::CommandType type, uint32_t value, const vec3& vector, float scalar)
+    {
+        m_lists.back().commands.push_back({ type, value, 0, 0, vector, scalar });
+    }
+
     void Context::drawBuffer() 
     {
         assert(m_elementType != SGL_LAST_ELEMENT_TYPE && m_isDrawing);
@@ -441,31 +946,38 @@ namespace sgl
             m_vertexBuffer.clear();
             return;
         }
+        drawPrimitive(m_elementType, m_vertexBuffer.data(), static_cast<int>(m_vertexBuffer.size()));
+    }
 
-        int vertexCount = static_cast<int>(m_vertexBuffer.size());
+    void Context::drawPrimitive(uint32_t elementType, const vec4* vertices, int vertexCount)
+    {
+        if (elementType > SGL_POINTS && vertexCount < 2)
+        {
+            return;
+        }
 
-        switch (m_elementType)
+        switch (elementType)
         {
             case SGL_POINTS:
-                for (const auto& vert : m_vertexBuffer)
+                for (int i = 0; i < vertexCount; ++i)
                 {
-                    drawPoint(vert.x, vert.y, vert.z);
+                    drawClippedPoint(vertices[i]);
                 }
                 break;
 
             case SGL_LINES:
                 for (int i = 1; i < vertexCount; i += 2)
                 {
-                    vec3 p1 = m_vertexBuffer[i-1];
-                    vec3 p2 = m_vertexBuffer[i];
+                    const vec4& p1 = vertices[i-1];
+                    const vec4& p2 = vertices[i];
                     if (m_areaMode == SGL_POINT)
                     {
-                        drawPoint(p1);
-                        drawPoint(p2);
+                        drawClippedPoint(p1);
+                        drawClippedPoint(p2);
                     }
                     else 
                     {
-                        drawLine(p1, p2);
+                        drawClippedLine(p1, p2);
                     }
                 }
                 break;
@@ -475,17 +987,14 @@ namespace sgl
                 {
                     for (int i = 0; i < vertexCount; ++i)
                     {
-                        vec3 p = m_vertexBuffer[i];
-                        drawPoint(p);
+                        drawClippedPoint(vertices[i]);
                     }
                 }
                 else 
                 {
                     for (int i = 0; i < vertexCount-1; ++i)
                     {
-                        vec3 p1 = m_vertexBuffer[i];
-                        vec3 p2 = m_vertexBuffer[(i+1) % vertexCount];
-                        drawLine(p1, p2);
+                        drawClippedLine(vertices[i], vertices[i+1]);
                     }
                 }
                 break;
@@ -495,23 +1004,20 @@ namespace sgl
                 {
                     for (int i = 0; i < vertexCount; ++i)
                     {
-                        vec3 p = m_vertexBuffer[i];
-                        drawPoint(p);
+                        drawClippedPoint(vertices[i]);
                     }
                 }
                 else 
                 {
                     for (int i = 0; i < vertexCount; ++i)
                     {
-                        vec3 p1 = m_vertexBuffer[i];
-                        vec3 p2 = m_vertexBuffer[(i+1) % vertexCount];
-                        drawLine(p1, p2);
+                        drawClippedLine(vertices[i], vertices[(i+1) % vertexCount]);
                     }
                 }
                 break;
 
             case SGL_POLYGON:   // Draw polygon the same way as a line loop
-                if (m_vertexBuffer.size() > 2)
+                if (vertexCount > 2)
                 {
                     switch (m_areaMode)
                     {
@@ -519,8 +1025,7 @@ namespace sgl
                         {
                             for (int i = 0; i < vertexCount; ++i)
                             {
-                                vec3 p = m_vertexBuffer[i];
-                                drawPoint(p);
+                                drawClippedPoint(vertices[i]);
                             }
                             break;
                         }
@@ -528,15 +1033,13 @@ namespace sgl
                         {
                             for (int i = 0; i < vertexCount; ++i)
                             {
-                                vec3 p1 = m_vertexBuffer[i];
-                                vec3 p2 = m_vertexBuffer[(i+1) % vertexCount];
-                                drawLine(p1, p2);
+                                drawClippedLine(vertices[i], vertices[(i+1) % vertexCount]);
                             }
                             break;
                         }
                         case SGL_FILL:
                         {
-                            m_fillFunc(m_vertexBuffer);
+                            fillClipped(vertices, vertexCount);
                             break;
                         }
                     }
@@ -547,70 +1050,246 @@ namespace sgl
                 {
                     case SGL_POINT:
                     {
-                        for (int i = 2; i < vertexCount; ++i)
+                        for (int i = 2; i < vertexCount; i += 3)
                         {
-                            vec4 p1 = m_vertexBuffer[i-2];
-                            vec4 p2 = m_vertexBuffer[i-1];
-                            vec4 p3 = m_vertexBuffer[i];
-                            drawPoint(p1);
-                            drawPoint(p2);
-                            drawPoint(p3);                         
+                            drawClippedPoint(vertices[i-2]);
+                            drawClippedPoint(vertices[i-1]);
+                            drawClippedPoint(vertices[i]);
                         }
                         break;
                     }
                     case SGL_LINE:
                     {
-                        for (int i = 2; i < vertexCount; ++i)
+                        for (int i = 2; i < vertexCount; i += 3)
                         {
-                            vec4 p1 = m_vertexBuffer[i-2];
-                            vec4 p2 = m_vertexBuffer[i-1];
-                            vec4 p3 = m_vertexBuffer[i];
-                            drawLine(p1, p2);
-                            drawLine(p2, p3);
-                            drawLine(p3, p1);    
+                            const vec4& p1 = vertices[i-2];
+                            const vec4& p2 = vertices[i-1];
+                            const vec4& p3 = vertices[i];
+                            drawClippedLine(p1, p2);
+                            drawClippedLine(p2, p3);
+                            drawClippedLine(p3, p1);
                         }
                         break;
                     }
                     case SGL_FILL:
                     {
-                        for (int i = 2; i < vertexCount; ++i)
+                        for (int i = 2; i < vertexCount; i += 3)
                         {
-                            vec4 p1 = m_vertexBuffer[i-2];
-                            vec4 p2 = m_vertexBuffer[i-1];
-                            vec4 p3 = m_vertexBuffer[i];
-                            m_fillFunc({p1, p2, p3});
+                            fillClipped(&vertices[i-2], 3);
                         }
                         break;
                     }
                 }
-                
+                break;
+
             default:
                 assert(false); // Not implemented
                 break;
         }
     }
 
+    void Context::drawClippedPoint(const vec4& vertex)
+    {
+        vec3 point;
+        if (m_clipper.clipPoint(vertex, point))
+        {
+            drawPoint(point);
+        }
+    }
+
+    void Context::drawClippedLine(const vec4& from, const vec4& to)
+    {
+        vec3 p1;
+        vec3 p2;
+        if (m_clipper.clipLine(from, to, p1, p2))
+        {
+            drawLine(p1, p2);
+        }
+    }
+
+    void Context::fillClipped(const vec4* vertices, size_t count)
+    {
+        const std::vector<vec4>& clipped = m_clipper.clipPolygon(vertices, count);
+        if (!clipped.empty())
+        {
+            (this->*m_fillFunc)(clipped);
+        }
+    }
+
     void Context::beginScene()
     {
         m_isSpecifyingScene = true;
         m_scenePrimitives.clear();
         m_sceneLights.clear();
+        m_sceneBvh.clear();
+        m_sceneGeometry.clear();
+        m_areaLightTree.clear();
+        m_instances.clear();
+        m_instanceBvh.clear();
     }
 
     void Context::endScene()
     {
         m_isSpecifyingScene = false;
-    }
 
-    bool Context::isSpecifyingScene() const
-    {
-        return m_isSpecifyingScene;
+        std::vector<AABB> primitiveBounds(m_scenePrimitives.size());
+        std::transform(m_scenePrimitives.begin(), m_scenePrimitives.end(), primitiveBounds.begin(), [](const auto& primitive) { return primitive->getBounds(); });
+        m_sceneBvh.build(primitiveBounds, m_bvhBuilder, &getThreadPool());
+        m_sceneGeometry.build(m_scenePrimitives, m_sceneBvh);
+
+        std::vector<AABB> instanceBounds(m_instances.size());
+        std::transform(m_instances.begin(), m_instances.end(), instanceBounds.begin(), [](const Instance& instance) { return instance.getBounds(); });
+        m_instanceBvh.build(instanceBounds, m_bvhBuilder, &getThreadPool());
+        m_isSceneDirty = false;
+
+        buildAreaLightTree();
+        resetAccumulation();
     }
 
-    void Context::renderScene()
+    void Context::updateScene()
     {
-        std::shared_ptr<Light> directional = std::make_shared<DirectionalLight>(vec3(-1, -2, 3), vec3(1));
-        // addLight(directional);
+        if (!m_isSceneDirty)
+        {
+            return;
+        }
+        m_isSceneDirty = false;
+
+        std::vector<AABB> instanceBounds(m_instances.size());
+        std::transform(m_instances.begin(), m_instances.end(), instanceBounds.begin(), [](const Instance& instance) { return instance.getBounds(); });
+        if (!m_instanceBvh.refit(instanceBounds))
+        {
+            m_instanceBvh.build(instanceBounds, m_bvhBuilder, &getThreadPool());
+        }
+        buildAreaLightTree();
+    }
+
+    void Context::buildAreaLightTree()
+    {
+        std::vector<const AreaLight*> areaLights;
+        std::vector<uint32_t> areaLightIndices;
+        for (size_t j = 0; j < m_sceneLights.size(); ++j)
+        {
+            if (const AreaLight* areaLight = dynamic_cast<const AreaLight*>(m_sceneLights[j].get()))
+            {
+                areaLights.push_back(areaLight);
+                areaLightIndices.push_back(static_cast<uint32_t>(j));
+            }
+        }
+        m_areaLightTree.build(areaLights, areaLightIndices);
+    }
+
+    bool Context::isSpecifyingScene() const
+    {
+        return m_isSpecifyingScene;
+    }
+
+    int Context::beginMesh()
+    {
+        m_isSpecifyingMesh = true;
+        m_currentMesh = static_cast<uint32_t>(m_meshes.size());
+        m_meshes.push_back(std::make_shared<Mesh>());
+        return static_cast<int>(m_currentMesh);
+    }
+
+    void Context::updateMesh(int mesh)
+    {
+        m_isSpecifyingMesh = true;
+        m_currentMesh = static_cast<uint32_t>(mesh);
+        m_meshes[mesh]->clearPrimitives();
+    }
+
+    void Context::endMesh()
+    {
+        m_isSpecifyingMesh = false;
+        const std::shared_ptr<Mesh>& mesh = m_meshes[m_currentMesh];
+        mesh->build(m_bvhBuilder, &getThreadPool());
+
+        for (uint32_t i = 0; i < m_instances.size(); ++i)
+        {
+            if (m_instances[i].mesh == mesh)
+            {
+                updateInstanceLights(i);
+                m_isSceneDirty = true;
+            }
+        }
+        if (m_isSceneDirty)
+        {
+            resetAccumulation();
+        }
+    }
+
+    bool Context::isSpecifyingMesh() const
+    {
+        return m_isSpecifyingMesh;
+    }
+
+    bool Context::hasMesh(int mesh) const
+    {
+        // The mesh being specified cannot be used before its hierarchy is built
+        return mesh >= 0 && mesh < static_cast<int>(m_meshes.size()) && !(m_isSpecifyingMesh && static_cast<uint32_t>(mesh) == m_currentMesh);
+    }
+
+    int Context::addInstance(int mesh)
+    {
+        const uint32_t instanceIdx = static_cast<uint32_t>(m_instances.size());
+        m_instances.emplace_back(m_meshes[mesh], getModelView());
+        m_instances.back().firstLight = static_cast<uint32_t>(m_sceneLights.size());
+        updateInstanceLights(instanceIdx);
+        return static_cast<int>(instanceIdx);
+    }
+
+    bool Context::hasInstance(int instance) const
+    {
+        return instance >= 0 && instance < static_cast<int>(m_instances.size());
+    }
+
+    void Context::setInstanceTransform(int instance)
+    {
+        m_instances[instance].setTransform(getModelView());
+        updateInstanceLights(static_cast<uint32_t>(instance));
+        m_isSceneDirty = true;
+        resetAccumulation();
+    }
+
+    void Context::updateInstanceLights(uint32_t instanceIdx)
+    {
+        Instance& instance = m_instances[instanceIdx];
+
+        // Emissive triangles light the scene from every place their mesh is put at
+        std::vector<std::shared_ptr<Light>> lights;
+        for (const auto& primitive : instance.mesh->getPrimitives())
+        {
+            const Triangle* triangle = dynamic_cast<const Triangle*>(primitive.get());
+            if (!triangle || !primitive->getMaterial().isEmissive())
+            {
+                continue;
+            }
+
+            const EmissiveMaterial& emissiveMaterial = static_cast<const EmissiveMaterial&>(primitive->getMaterial());
+            const vec3 v1 = instance.toWorld * vec4(triangle->getVertex(0), 1);
+            const vec3 v2 = instance.toWorld * vec4(triangle->getVertex(1), 1);
+            const vec3 v3 = instance.toWorld * vec4(triangle->getVertex(2), 1);
+            lights.push_back(std::make_shared<AreaLight>(v1, v2, v3, emissiveMaterial.getColor(), emissiveMaterial.c0, emissiveMaterial.c1, emissiveMaterial.c2));
+        }
+
+        // Lights keep their place among the scene lights, those after them move when their count changed
+        const auto first = m_sceneLights.begin() + instance.firstLight;
+        m_sceneLights.erase(first, first + instance.lightCount);
+        m_sceneLights.insert(m_sceneLights.begin() + instance.firstLight, lights.begin(), lights.end());
+        const int32_t shift = static_cast<int32_t>(lights.size()) - static_cast<int32_t>(instance.lightCount);
+        instance.lightCount = static_cast<uint32_t>(lights.size());
+        for (uint32_t i = instanceIdx + 1; i < m_instances.size(); ++i)
+        {
+            m_instances[i].firstLight += shift;
+        }
+    }
+
+    void Context::renderScene()
+    {
+        flushRaster();
+        updateScene();
+        std::shared_ptr<Light> directional = std::make_shared<DirectionalLight>(vec3(-1, -2, 3), vec3(1));
+        // addLight(directional);
 
         // PointLight* pl = dynamic_cast<PointLight*>(m_sceneLights[0].get());
         // pl->m_pos.y -= 300;
@@ -622,96 +1301,573 @@ namespace sgl
         mat4 invPVM = m_PVM.inverse();
 
         vec4 originWorld = invModelView * vec4(0, 0, 0, 1);
+        m_pixelSpread = pixelSpread(originWorld, invPVM);
+        if (m_hybridTracing)
+        {
+            rasterizeVisibility();
+        }
+
+        forEachTile([&](int x0, int y0, int x1, int y1) {
+            renderTile(x0, y0, x1, y1, originWorld, invPVM, 0, m_hybridTracing, [&](int xp, int yp, const vec3& color) {
+                putPixel(vec3(xp, yp, 0), color);
+            });
+        });
+#ifdef SGL_ANTIALIASING_ENABLED        
+        applyAdaptiveSampling(originWorld, invPVM);
+#endif
+    }
 
-        for (int yp = 0; yp < m_height; ++yp)
+    void Context::renderSceneProgressive(uint32_t samples)
+    {
+        flushRaster();
+        updateScene();
+        const float* pvm = m_PVM.data_ptr();
+        const bool cameraMoved = !std::equal(pvm, pvm + 16, m_accumulationPVM.data_ptr());
+        if (cameraMoved || m_accumulation.size() != m_colorBuffer.size())
         {
-            for (int xp = 0; xp < m_width; ++xp)
-            {
-                vec4 pixelWorld = invPVM * vec4(xp, yp, -1, 1);
-                pixelWorld = pixelWorld / pixelWorld.w;
+            resetAccumulation();
+            m_accumulationPVM = m_PVM;
+        }
 
-                vec3 rayDir = math::normalize(vec3(pixelWorld) - vec3(originWorld));
-                Ray primary(originWorld, rayDir);
+        mat4 invPVM = m_PVM.inverse();
+        vec4 originWorld = getModelView().inverse() * vec4(0, 0, 0, 1);
+        m_pixelSpread = pixelSpread(originWorld, invPVM);
 
-                vec3 color = castRay(primary);
+        const uint32_t firstSample = m_sampleCount;
+        const float scale = 1.f / (firstSample + samples);
+        forEachTile([&](int x0, int y0, int x1, int y1) {
+            for (uint32_t sample = firstSample; sample < firstSample + samples; ++sample)
+            {
+                renderTile(x0, y0, x1, y1, originWorld, invPVM, sample, false, [&](int xp, int yp, const vec3& color) {
+                    const int idx = point2idx(xp, yp);
+                    const float l = math::luminance(color);
+                    m_accumulation[idx] += color;
+                    m_luminanceSquares[idx] += l * l;
+                });
+            }
 
-                putPixel(vec3(xp, yp, 0), color);
+            for (int yp = y0; yp < y1; ++yp)
+            {
+                for (int xp = x0; xp < x1; ++xp)
+                {
+                    const int idx = point2idx(xp, yp);
+                    m_colorBuffer[idx] = m_accumulation[idx] * scale;
+                }
             }
+        });
+        m_sampleCount += samples;
+
+        m_noiseEstimate = 1.f;
+        if (m_sampleCount > 1)
+        {
+            double error = 0;
+            for (size_t idx = 0; idx < m_accumulation.size(); ++idx)
+            {
+                error += relativeError(math::luminance(m_accumulation[idx]), m_luminanceSquares[idx], m_sampleCount);
+            }
+            m_noiseEstimate = static_cast<float>(error / m_accumulation.size());
         }
-#ifdef SGL_ANTIALIASING_ENABLED        
-        applyAdaptiveAntialiasing();
-#endif
     }
 
-    void Context::applyAdaptiveAntialiasing()
-{
-    std::vector<int> importantPixels;
-
-    
-    float edgeThreshold = 0.2f; 
+    void Context::rasterizeScene()
+    {
+        flushRaster();
+        updateScene();
+        const mat4 invPVM = m_PVM.inverse();
+        const vec4 originWorld = getModelView().inverse() * vec4(0, 0, 0, 1);
+        m_pixelSpread = pixelSpread(originWorld, invPVM);
+        rasterizeVisibility();
+
+        // Pixels are shaded once each, where their primary ray meets the surface rasterized at them
+        forEachTile([&](int x0, int y0, int x1, int y1) {
+            for (int yp = y0; yp < y1; ++yp)
+            {
+                for (int xp = x0; xp < x1; ++xp)
+                {
+                    const int idx = point2idx(xp, yp);
+                    const Ray primary(originWorld, primaryDir(xp, yp, 0, originWorld, invPVM));
+                    TraceRayResult hit;
+                    if (!intersectVisible(xp, yp, primary, hit))
+                    {
+                        // Shaded at the rasterized point instead
+                        const vec4 point = invPVM * vec4(xp, yp, m_depthBuffer[idx], 1);
+                        hit.hitPoint = vec3(point / point.w);
+                    }
+                    m_colorBuffer[idx] = hit.anyHit ? shadePreview(primary, hit) : background(primary.dir);
+                }
+            }
+        });
+    }
 
-    for (int y = 1; y < m_height - 1; ++y)
+    void Context::rasterizeVisibility()
     {
-        for (int x = 1; x < m_width - 1; ++x)
+        std::fill(m_depthBuffer.begin(), m_depthBuffer.end(), std::numeric_limits<float>::max());
+        m_hierarchicalZ.clear(std::numeric_limits<float>::max());
+        m_visibleIds.assign(m_width * m_height, NO_SURFACE);
+        m_visibleSurfaces.clear();
+        // The rasterizer covers pixel x with the span [x, x + 1) while the primary ray of the pixel
+        // passes through x, moving the window by half a pixel centers the two on each other
+        const mat4 toWindow = translate(0.5f, 0.5f, 0) * m_PVM;
+        for (uint32_t i = 0; i < m_scenePrimitives.size(); ++i)
         {
-            int idx = point2idx(x, y);
-            vec3 currentColor = m_colorBuffer[idx];
+            rasterizePrimitive(*m_scenePrimitives[i], toWindow, { true, vec3(), i, NO_INSTANCE });
+        }
+        for (uint32_t k = 0; k < m_instances.size(); ++k)
+        {
+            const mat4 instanceToWindow = toWindow * m_instances[k].toWorld;
+            const std::vector<std::shared_ptr<Primitive>>& primitives = m_instances[k].mesh->getPrimitives();
+            for (uint32_t i = 0; i < primitives.size(); ++i)
+            {
+                rasterizePrimitive(*primitives[i], instanceToWindow, { true, vec3(), i, k });
+            }
+        }
+    }
 
-            //neighbors
-            vec3 left = m_colorBuffer[point2idx(x - 1, y)];
-            vec3 right = m_colorBuffer[point2idx(x + 1, y)];
-            vec3 up = m_colorBuffer[point2idx(x, y - 1)];
-            vec3 down = m_colorBuffer[point2idx(x, y + 1)];
+    void Context::rasterizePrimitive(const Primitive& primitive, const mat4& toWindow, const TraceRayResult& surface)
+    {
+        const uint32_t id = static_cast<uint32_t>(m_visibleSurfaces.size());
+        m_visibleSurfaces.push_back(surface);
 
-            float maxDifference = std::max({
-                math::distance(currentColor, left),
-                math::distance(currentColor, right),
-                math::distance(currentColor, up),
-                math::distance(currentColor, down)
-            });
+        if (const Triangle* triangle = dynamic_cast<const Triangle*>(&primitive))
+        {
+            rasterizeVisibilityTriangle(toWindow * vec4(triangle->getVertex(0), 1), toWindow * vec4(triangle->getVertex(1), 1),
+                                     toWindow * vec4(triangle->getVertex(2), 1), id);
+        }
+        else if (const Sphere* sphere = dynamic_cast<const Sphere*>(&primitive))
+        {
+            // Ring r runs around the axis at the angle pi * r / SPHERE_RINGS from the pole, the first and
+            // the last ring are the poles themselves. The corners of a cell lie within the angle d of its
+            // center, cos d >= cos(dTheta / 2) + cos(dPhi / 2) - 1, and so does the circle through them.
+            // Scaled by 1 / cos d, the facets enclose the sphere and cover all of its silhouette.
+            const float halfRing = static_cast<float>(M_PI) / (2 * SPHERE_RINGS);
+            const float halfSegment = static_cast<float>(M_PI) / SPHERE_SEGMENTS;
+            const vec3& center = sphere->getCenter();
+            const float radius = sphere->getRadius() / (std::cos(halfRing) + std::cos(halfSegment) - 1);
+            std::vector<vec4> grid((SPHERE_RINGS + 1) * SPHERE_SEGMENTS);
+            for (int r = 0; r <= SPHERE_RINGS; ++r)
+            {
+                const float theta = static_cast<float>(M_PI) * r / SPHERE_RINGS;
+                for (int s = 0; s < SPHERE_SEGMENTS; ++s)
+                {
+                    const float phi = 2 * static_cast<float>(M_PI) * s / SPHERE_SEGMENTS;
+                    const vec3 offset(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+                    grid[r * SPHERE_SEGMENTS + s] = toWindow * vec4(center + radius * offset, 1);
+                }
+            }
+            // Quads between two rings are split in two triangles, the ones at the poles have one only
+            for (int r = 0; r < SPHERE_RINGS; ++r)
+            {
+                for (int s = 0; s < SPHERE_SEGMENTS; ++s)
+                {
+                    const int next = (s + 1) % SPHERE_SEGMENTS;
+                    const vec4& a = grid[r * SPHERE_SEGMENTS + s];
+                    const vec4& b = grid[r * SPHERE_SEGMENTS + next];
+                    const vec4& c = grid[(r + 1) * SPHERE_SEGMENTS + next];
+                    const vec4& d = grid[(r + 1) * SPHERE_SEGMENTS + s];
+                    if (r > 0)
+                    {
+                        rasterizeVisibilityTriangle(a, b, c, id);
+                    }
+                    if (r < SPHERE_RINGS - 1)
+                    {
+                        rasterizeVisibilityTriangle(a, c, d, id);
+                    }
+                }
+            }
+        }
+    }
 
-            if (maxDifference > edgeThreshold)
+    void Context::rasterizeVisibilityTriangle(const vec4& a, const vec4& b, const vec4& c, uint32_t id)
+    {
+        const vec4 vertices[3] = { a, b, c };
+        const std::vector<vec4>& window = m_clipper.clipPolygon(vertices, 3);
+        if (!window.empty())
+        {
+            m_rasterizer.fill(window.data(), window.size(), id, m_visibleIds.data(), m_depthBuffer.data(), &m_hierarchicalZ, m_width, m_height, 0, m_height);
+        }
+    }
+
+    bool Context::isVisibleInterior(int xp, int yp) const
+    {
+        if (xp < 1 || yp < 1 || xp + 1 >= static_cast<int>(m_width) || yp + 1 >= static_cast<int>(m_height))
+        {
+            return false;
+        }
+        const uint32_t id = m_visibleIds[point2idx(xp, yp)];
+        for (int y = yp - 1; y <= yp + 1; ++y)
+        {
+            for (int x = xp - 1; x <= xp + 1; ++x)
             {
-                importantPixels.push_back(idx);
+                if (m_visibleIds[point2idx(x, y)] != id)
+                {
+                    return false;
+                }
             }
         }
+        return true;
     }
 
-   
-    for (int idx : importantPixels)
+    bool Context::intersectVisible(int xp, int yp, const Ray& primary, TraceRayResult& hit) const
     {
-        
-        int x = idx % m_width;
-        int y = idx / m_width;
+        const uint32_t id = m_visibleIds[point2idx(xp, yp)];
+        if (id == NO_SURFACE)
+        {
+            hit = { false, vec3(), 0 };
+            return true;
+        }
 
-        vec4 originWorld = getModelView().inverse() * vec4(0, 0, 0, 1);
+        // Tested the way traceRay tests the primitive, so that the two agree on its edges and silhouette
+        hit = m_visibleSurfaces[id];
+        Ray worldRay = primary;
+        worldRay.dir = math::normalize(worldRay.dir);
+        const Instance* instance = hit.instanceIdx != NO_INSTANCE ? &m_instances[hit.instanceIdx] : nullptr;
+        float scale;
+        const Ray ray = instance ? instance->rayToObject(worldRay, scale) : worldRay;
+        const SceneGeometry& geometry = instance ? instance->mesh->getGeometry() : m_sceneGeometry;
+        vec3x4 points;
+        float4 distances;
+        const int isHit = geometry.intersect(geometry.getPosition(hit.primitiveIdx), 1, vec3x4::broadcast(ray.origin), vec3x4::broadcast(ray.dir),
+                                             ray.type != Ray::Type::INSIDE, false, points, distances);
+        const vec3 point(points.x[0], points.y[0], points.z[0]);
+        hit.hitPoint = instance ? vec3(instance->toWorld * vec4(point, 1)) : point;
+        return isHit != 0;
+    }
 
-        vec3 color(0.0f);
+    vec3 Context::shadePreview(const Ray& ray, const TraceRayResult& hit) const
+    {
+        const Material& material = getHitPrimitive(hit).getMaterial();
+        if (material.isEmissive())
+        {
+            return material.getColor();
+        }
 
-        
-        for (int i = 0; i < 4; ++i)
+        // Area lights shine from the centroid of their triangle with the power of all their samples
+        const vec2 centroid(4.f / 9.f, 0.5f);
+        const vec3 normal = getHitNormal(hit);
+        const vec3 camera = math::normalize(vec3(ray.origin) - hit.hitPoint);
+        const vec3 color = surfaceColor(ray, hit, normal);
+        vec3 result(0.0f);
+        for (const std::shared_ptr<Light>& light : m_sceneLights)
         {
-            float offsetX = (i % 2 == 0 ? 0.25f : -0.25f);
-            float offsetY = (i < 2 ? 0.25f : -0.25f);
+            const bool isArea = light->isAreaLight();
+            const vec3 lightDir = light->getDirection(hit.hitPoint, isArea ? centroid : vec2());
+            const vec3 lightColor = isArea ? light->getColor(lightDir) * static_cast<float>(AreaLight::SAMPLE_NUMBER) : light->getColor(lightDir);
+            result += phong(material, color, normal, camera, lightColor, math::normalize(lightDir));
+        }
+        return result;
+    }
 
-            vec4 pixelWorld = m_PVM.inverse() * vec4(x + offsetX, y + offsetY, -1, 1);
-            pixelWorld = pixelWorld / pixelWorld.w;
+    void Context::resetAccumulation()
+    {
+        m_accumulation.assign(m_colorBuffer.size(), vec3(0.0f));
+        m_luminanceSquares.assign(m_colorBuffer.size(), 0.0f);
+        m_sampleCount = 0;
+        m_noiseEstimate = 1.f;
+    }
 
-            vec3 rayDir = math::normalize(vec3(pixelWorld) - vec3(originWorld));
-            Ray ray(originWorld, rayDir);
+    uint32_t Context::getSampleCount() const
+    {
+        return m_sampleCount;
+    }
+
+    float Context::getNoiseEstimate() const
+    {
+        return m_noiseEstimate;
+    }
+
+    const Bvh::Statistics& Context::getBvhStatistics() const
+    {
+        return m_sceneBvh.getStatistics();
+    }
 
-            color += castRay(ray); //4 rays
+    double Context::relativeError(double luminanceSum, double luminanceSquareSum, uint32_t sampleCount)
+    {
+        const double n = sampleCount;
+        const double mean = luminanceSum / n;
+        const double variance = std::max(0.0, luminanceSquareSum / n - mean * mean) * n / (n - 1);
+        return std::sqrt(variance / n) / std::max(mean, NOISE_LUMINANCE_FLOOR);
+    }
+
+    vec3 Context::primaryDir(int xp, int yp, uint32_t sample, const vec4& originWorld, const mat4& invPVM) const
+    {
+        // The first sample of a pixel goes through its center, later ones are stratified over its area
+        float x = static_cast<float>(xp);
+        float y = static_cast<float>(yp);
+        if (sample > 0)
+        {
+            const vec2 offset = Sampler(point2idx(xp, yp), sample - 1, Sampler::PIXEL_DIMENSION).next2D();
+            x += offset.x - 0.5f;
+            y += offset.y - 0.5f;
         }
+        vec4 pixelWorld = invPVM * vec4(x, y, -1, 1);
+        pixelWorld = pixelWorld / pixelWorld.w;
+        return math::normalize(vec3(pixelWorld) - vec3(originWorld));
+    }
 
-        color /= 4.0f; //Average
+    float Context::pixelSpread(const vec4& originWorld, const mat4& invPVM) const
+    {
+        const int xp = m_width / 2;
+        const int yp = m_height / 2;
+        return math::length(primaryDir(xp + 1, yp, 0, originWorld, invPVM) - primaryDir(xp, yp, 0, originWorld, invPVM));
+    }
 
-        
-        m_colorBuffer[idx] = color;
+    void Context::renderTile(int x0, int y0, int x1, int y1, const vec4& originWorld, const mat4& invPVM, uint32_t sample, bool isRasterized, const std::function<void(int, int, const vec3&)>& sink) const
+    {
+        const size_t lightCount = m_sceneLights.size();
+        OccluderCache occluders(lightCount, NO_OCCLUDER);
+
+        if (!m_packetTracing)
+        {
+            for (int yp = y0; yp < y1; ++yp)
+            {
+                for (int xp = x0; xp < x1; ++xp)
+                {
+                    Ray primary(originWorld, primaryDir(xp, yp, sample, originWorld, invPVM));
+
+                    Sampler sampler(point2idx(xp, yp), sample);
+                    TraceRayResult hit;
+                    if (!isRasterized || !isVisibleInterior(xp, yp) || !intersectVisible(xp, yp, primary, hit))
+                    {
+                        hit = traceRay(primary);
+                    }
+                    sink(xp, yp, shadeRay(primary, hit, sampler, occluders, 0));
+                }
+            }
+            return;
+        }
+
+        std::vector<uint8_t> lightVisibility(RayPacket::SIZE * lightCount);
+
+        // Primary rays of 2x2 pixel blocks are traced as one packet
+        for (int yq = y0; yq < y1; yq += 2)
+        {
+            for (int xq = x0; xq < x1; xq += 2)
+            {
+                int pixelX[RayPacket::SIZE];
+                int pixelY[RayPacket::SIZE];
+                vec3 origins[RayPacket::SIZE];
+                vec3 dirs[RayPacket::SIZE];
+                int count = 0;
+                for (int i = 0; i < RayPacket::SIZE; ++i)
+                {
+                    int xp = xq + i % 2;
+                    int yp = yq + i / 2;
+                    if (xp < x1 && yp < y1)
+                    {
+                        pixelX[count] = xp;
+                        pixelY[count] = yp;
+                        origins[count] = originWorld;
+                        dirs[count] = primaryDir(xp, yp, sample, originWorld, invPVM);
+                        ++count;
+                    }
+                }
+
+                TraceRayResult hits[RayPacket::SIZE];
+                if (isRasterized)
+                {
+                    for (int lane = 0; lane < count; ++lane)
+                    {
+                        const Ray primary(origins[lane], dirs[lane]);
+                        if (!isVisibleInterior(pixelX[lane], pixelY[lane]) || !intersectVisible(pixelX[lane], pixelY[lane], primary, hits[lane]))
+                        {
+                            hits[lane] = traceRay(primary);
+                        }
+                    }
+                    traceShadowPackets(hits, count, occluders, lightVisibility.data());
+                }
+                else
+                {
+                    tracePrimaryPacket(origins, dirs, count, hits, occluders, lightVisibility.data());
+                }
+
+                for (int lane = 0; lane < count; ++lane)
+                {
+                    Sampler sampler(point2idx(pixelX[lane], pixelY[lane]), sample);
+                    sink(pixelX[lane], pixelY[lane], shadeRay(Ray(origins[lane], dirs[lane]), hits[lane], sampler, occluders, 0, &lightVisibility[lane * lightCount]));
+                }
+            }
         }
     }
 
+    void Context::tracePixelSamples(int xp, int yp, uint32_t firstSample, int count, const vec4& originWorld, const mat4& invPVM, OccluderCache& occluders, uint8_t* lightVisibility, vec3* colors) const
+    {
+        vec3 origins[RayPacket::SIZE];
+        vec3 dirs[RayPacket::SIZE];
+        for (int i = 0; i < count; ++i)
+        {
+            origins[i] = originWorld;
+            dirs[i] = primaryDir(xp, yp, firstSample + i, originWorld, invPVM);
+        }
 
-        
+        TraceRayResult hits[RayPacket::SIZE];
+        if (m_hybridTracing)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                const Ray primary(origins[i], dirs[i]);
+                if (!isVisibleInterior(xp, yp) || !intersectVisible(xp, yp, primary, hits[i]))
+                {
+                    hits[i] = traceRay(primary);
+                }
+            }
+            if (m_packetTracing)
+            {
+                traceShadowPackets(hits, count, occluders, lightVisibility);
+            }
+        }
+        else if (m_packetTracing)
+        {
+            tracePrimaryPacket(origins, dirs, count, hits, occluders, lightVisibility);
+        }
+
+        const size_t lightCount = m_sceneLights.size();
+        for (int i = 0; i < count; ++i)
+        {
+            const Ray primary(origins[i], dirs[i]);
+            Sampler sampler(point2idx(xp, yp), firstSample + i);
+            if (m_packetTracing)
+            {
+                colors[i] = shadeRay(primary, hits[i], sampler, occluders, 0, &lightVisibility[i * lightCount]);
+            }
+            else
+            {
+                colors[i] = m_hybridTracing ? shadeRay(primary, hits[i], sampler, occluders, 0) : castRay(primary, sampler, occluders);
+            }
+        }
+    }
+
+    void Context::applyAdaptiveSampling(const vec4& originWorld, const mat4& invPVM)
+    {
+        // Luminance of the first pass, pixels with a single sample take the variance of their neighbourhood
+        std::vector<float> firstPass(m_colorBuffer.size());
+        std::transform(m_colorBuffer.begin(), m_colorBuffer.end(), firstPass.begin(), [](const vec3& color) { return math::luminance(color); });
+
+        const int width = static_cast<int>(m_width);
+        const int height = static_cast<int>(m_height);
+        const uint32_t maxSamples = std::max(m_minSamples, m_maxSamples);
+
+        forEachTile([&](int x0, int y0, int x1, int y1) {
+            const size_t lightCount = m_sceneLights.size();
+            std::vector<uint8_t> lightVisibility(RayPacket::SIZE * lightCount);
+            OccluderCache occluders(lightCount, NO_OCCLUDER);
+
+            for (int yp = y0; yp < y1; ++yp)
+            {
+                for (int xp = x0; xp < x1; ++xp)
+                {
+                    const int idx = point2idx(xp, yp);
+
+                    vec3 colorSum = m_colorBuffer[idx];
+                    double luminanceSum = firstPass[idx];
+                    double luminanceSquareSum = luminanceSum * luminanceSum;
+                    uint32_t sampleCount = 1;
+
+                    auto converged = [&]() {
+                        if (sampleCount > 1)
+                        {
+                            return relativeError(luminanceSum, luminanceSquareSum, sampleCount) <= m_noiseTarget;
+                        }
+
+                        double sum = 0;
+                        double squareSum = 0;
+                        uint32_t count = 0;
+                        for (auto [dx, dy] : { std::pair(0, 0), std::pair(-1, 0), std::pair(1, 0), std::pair(0, -1), std::pair(0, 1) })
+                        {
+                            if (xp + dx >= 0 && xp + dx < width && yp + dy >= 0 && yp + dy < height)
+                            {
+                                const double l = firstPass[point2idx(xp + dx, yp + dy)];
+                                sum += l;
+                                squareSum += l * l;
+                                ++count;
+                            }
+                        }
+                        const double mean = sum / count;
+                        const double variance = std::max(0.0, squareSum / count - mean * mean) * count / std::max(count - 1, 1u);
+                        return std::sqrt(variance) / std::max(luminanceSum, NOISE_LUMINANCE_FLOOR) <= m_noiseTarget;
+                    };
+
+                    while (sampleCount < maxSamples && (sampleCount < m_minSamples || !converged()))
+                    {
+                        const int count = static_cast<int>(std::min<uint32_t>(maxSamples - sampleCount, RayPacket::SIZE));
+                        vec3 colors[RayPacket::SIZE];
+                        tracePixelSamples(xp, yp, sampleCount, count, originWorld, invPVM, occluders, lightVisibility.data(), colors);
+                        for (int i = 0; i < count; ++i)
+                        {
+                            const double l = math::luminance(colors[i]);
+                            colorSum += colors[i];
+                            luminanceSum += l;
+                            luminanceSquareSum += l * l;
+                        }
+                        sampleCount += count;
+                    }
+
+                    // Tiles only write their own pixels and read the first pass from its copy
+                    m_colorBuffer[idx] = colorSum / static_cast<float>(sampleCount);
+                }
+            }
+        });
+    }
+
+    ThreadPool& Context::getThreadPool()
+    {
+        uint32_t threadCount = m_threadCount > 0 ? m_threadCount : ThreadPool::defaultThreadCount();
+        if (!m_threadPool || m_threadPool->getThreadCount() != threadCount)
+        {
+            m_threadPool = std::make_unique<ThreadPool>(threadCount);
+        }
+        return *m_threadPool;
+    }
+
+    void Context::forEachTile(const std::function<void(int, int, int, int)>& tileFunc)
+    {
+        int tileSize = static_cast<int>(m_tileSize);
+        int tilesX = (m_width + tileSize - 1) / tileSize;
+        int tilesY = (m_height + tileSize - 1) / tileSize;
+
+        getThreadPool().parallelFor(tilesX * tilesY, [&](uint32_t tileIdx, uint32_t /* threadIdx */) {
+            int x0 = (tileIdx % tilesX) * tileSize;
+            int y0 = (tileIdx / tilesX) * tileSize;
+            tileFunc(x0, y0, std::min(x0 + tileSize, static_cast<int>(m_width)), std::min(y0 + tileSize, static_cast<int>(m_height)));
+        });
+    }
+
+    void Context::setRenderParameter(uint32_t parameter, int value)
+    {
+        switch (parameter)
+        {
+            case SGL_RENDER_THREADS:
+                m_threadCount = value;
+                break;
+            case SGL_RENDER_TILE_SIZE:
+                m_tileSize = value;
+                break;
+            case SGL_RENDER_PACKETS:
+                m_packetTracing = value != 0;
+                break;
+            case SGL_RENDER_HYBRID:
+                m_hybridTracing = value != 0;
+                break;
+            case SGL_RENDER_MIN_SAMPLES:
+                m_minSamples = value;
+                break;
+            case SGL_RENDER_MAX_SAMPLES:
+                m_maxSamples = value;
+                break;
+            case SGL_RENDER_BVH_BUILDER:
+                m_bvhBuilder = value == SGL_BVH_LBVH ? Bvh::Builder::LBVH : Bvh::Builder::SAH;
+                break;
+        }
+    }
+
+    void Context::setRenderParameter(uint32_t parameter, float value)
+    {
+        switch (parameter)
+        {
+            case SGL_RENDER_NOISE_TARGET:
+                m_noiseTarget = value;
+                break;
+        }
+    }
 
     void Context::setCurrentMaterial(std::shared_ptr<Material> material)
     {
@@ -729,72 +1885,250 @@ namespace sgl
         m_sceneLights.push_back(light);
     }
 
-    vec3 Context::calculatePhong(const Material& material, const vec3& intersectionPoint, const vec3& surfaceNormal, const vec3& camera, const Light& light, std::shared_ptr<Primitive> primitive) const
+    vec3 Context::calculatePhong(const Material& material, const vec3& surfaceColor, const vec3& intersectionPoint, const vec3& surfaceNormal, const vec3& camera, const Light& light, uint32_t& lastOccluder, const uint8_t* visibility) const
     {
-        if (material.isEmissive())
+        const vec3 lightDir = light.getDirection(intersectionPoint, vec2());
+        const vec3 shadowDir = math::normalize(lightDir);
+
+        const bool occluded = visibility
+            ? !*visibility
+            : isOccluded(Ray(intersectionPoint, shadowDir), light.getShadowDistance(lightDir), lastOccluder);
+        if (occluded)
         {
-            return material.getColor();
+            return vec3(0.0f);
         }
 
-        const int samples = light.isAreaLight() ? AreaLight::SAMPLE_NUMBER : 1;
+        return phong(material, surfaceColor, surfaceNormal, camera, light.getColor(lightDir), shadowDir);
+    }
+
+    vec3 Context::calculateAreaLights(const Material& material, const vec3& surfaceColor, const vec3& intersectionPoint, const vec3& surfaceNormal, const vec3& camera, Sampler& sampler, OccluderCache& occluders) const
+    {
+        vec3 result(0.0f);
 
-        vec3 result(0.0f, 0.0f, 0.0f);    
+        // Samples are stratified among themselves and drawn up front, which lets the shadow
+        // rays towards them be traced together as packets
+        vec2 positions[AreaLight::SAMPLE_NUMBER];
+        float selections[AreaLight::SAMPLE_NUMBER];
+        sampler.next2D(positions, AreaLight::SAMPLE_NUMBER);
+        sampler.next1D(selections, AreaLight::SAMPLE_NUMBER);
 
-        for (int i = 0; i < samples; ++i)
+        for (int first = 0; first < AreaLight::SAMPLE_NUMBER; first += RayPacket::SIZE)
         {
-            //scene light iteration
-            vec3 diffuse(0.0f, 0.0f, 0.0f);  
-            vec3 specular(0.0f, 0.0f, 0.0f); 
-            //casting
+            const Light* lights[RayPacket::SIZE];
+            uint32_t lightIndices[RayPacket::SIZE];
+            float pdfs[RayPacket::SIZE];
+            vec3 lightDirs[RayPacket::SIZE];
+            vec3 shadowDirs[RayPacket::SIZE];
+            float shadowTMax[RayPacket::SIZE];
+            bool occluded[RayPacket::SIZE];
+
+            // Samples whose every light is culled contribute nothing and trace no ray
+            int count = 0;
+            for (int i = first; i < first + RayPacket::SIZE; ++i)
+            {
+                if (!m_areaLightTree.sample(intersectionPoint, selections[i], lightIndices[count], pdfs[count]))
+                {
+                    continue;
+                }
+                lights[count] = m_sceneLights[lightIndices[count]].get();
+                lightDirs[count] = lights[count]->getDirection(intersectionPoint, positions[i]);
+                shadowDirs[count] = math::normalize(lightDirs[count]);
+                shadowTMax[count] = lights[count]->getShadowDistance(lightDirs[count]);
+                ++count;
+            }
+
+            // Rays towards the same light are traced together, testing and updating the occluder
+            // cached for that light
+            bool traced[RayPacket::SIZE] = {};
+            for (int i = 0; i < count; ++i)
+            {
+                if (traced[i])
+                {
+                    continue;
+                }
 
-            vec3 lightDir = light.getDirection(intersectionPoint);
+                int lanes[RayPacket::SIZE];
+                vec3 dirs[RayPacket::SIZE];
+                float tMax[RayPacket::SIZE];
+                int laneCount = 0;
+                for (int j = i; j < count && (m_packetTracing || j == i); ++j)
+                {
+                    if (!traced[j] && lightIndices[j] == lightIndices[i])
+                    {
+                        traced[j] = true;
+                        lanes[laneCount] = j;
+                        dirs[laneCount] = shadowDirs[j];
+                        tMax[laneCount] = shadowTMax[j];
+                        ++laneCount;
+                    }
+                }
 
-            Ray lightRay(intersectionPoint, lightDir);
-            auto [anyHit, a, b] =  traceRay(lightRay, true);
+                uint32_t& lastOccluder = occluders[lightIndices[i]];
+                if (laneCount == 1)
+                {
+                    occluded[i] = isOccluded(Ray(intersectionPoint, dirs[0]), tMax[0], lastOccluder);
+                    continue;
+                }
+                vec3 origins[RayPacket::SIZE];
+                std::fill(origins, origins + laneCount, intersectionPoint);
+                const int blocked = isOccluded(origins, dirs, tMax, laneCount, lastOccluder);
+                for (int k = 0; k < laneCount; ++k)
+                {
+                    occluded[lanes[k]] = (blocked & (1 << k)) != 0;
+                }
+            }
 
-            if (anyHit)
+            for (int i = 0; i < count; ++i)
             {
-                continue;
+                if (!occluded[i])
+                {
+                    const vec3 lightColor = lights[i]->getColor(lightDirs[i]) / pdfs[i];
+                    result += phong(material, surfaceColor, surfaceNormal, camera, lightColor, shadowDirs[i]);
+                }
             }
+        }
 
-            vec3 lightColor = light.getColor(lightDir);
-            lightDir = math::normalize(lightDir);
+        return result;
+    }
 
-            vec3 reflectedDir = math::normalize(math::reflect(-lightDir, surfaceNormal));
+    vec3 Context::phong(const Material& material, const vec3& surfaceColor, const vec3& surfaceNormal, const vec3& camera, const vec3& lightColor, const vec3& lightDir) const
+    {
+        vec3 reflectedDir = math::normalize(math::reflect(-lightDir, surfaceNormal));
+
+        float diff = std::fmax(0.0f, math::dotProduct(surfaceNormal, lightDir));
+
+        vec3 diffuse = (lightColor * surfaceColor * material.kd * diff);
 
-            float diff = std::fmax(0.0f, math::dotProduct(surfaceNormal, lightDir));
+        float spec = std::pow(std::fmax(0.0f, math::dotProduct(camera, reflectedDir)), material.shine);
+
+        vec3 specular = (lightColor * material.ks * spec);
+
+        return diffuse + specular;
+    }
 
+    vec3 Context::surfaceColor(const Ray& ray, const TraceRayResult& hit, const vec3& surfaceNormal) const
+    {
+        const Primitive& primitive = getHitPrimitive(hit);
 #ifdef SGL_TEXTURES_ENABLED
-            vec2 texCoords = primitive->getTextureCoords(intersectionPoint);
-            vec3 color = material.getColor(texCoords);
-#else            
-            vec3 color = material.getColor();
-#endif            
+        // The ray is a cone widening by the pixel spread per unit of distance, its footprint grows
+        // as the surface turns away (limited at grazing angles, where it would blur everything).
+        // Secondary rays restart the cone at their origin, keeping their textures a little sharper
+        const float distance = math::length(hit.hitPoint - vec3(ray.origin));
+        const float cosine = std::fmax(std::fabs(math::dotProduct(ray.dir, surfaceNormal)), 0.25f);
+        float footprint = m_pixelSpread * distance / cosine * primitive.getTextureScale();
+        vec3 point = hit.hitPoint;
+        if (hit.instanceIdx != NO_INSTANCE)
+        {
+            // Texture coordinates and scale are known in object space
+            const Instance& instance = m_instances[hit.instanceIdx];
+            point = instance.toObject * vec4(hit.hitPoint, 1);
+            footprint *= instance.scale;
+        }
+        return primitive.getMaterial().getColor(primitive.getTextureCoords(point), footprint);
+#else
+        return primitive.getMaterial().getColor();
+#endif
+    }
+
+    const Primitive& Context::getHitPrimitive(const TraceRayResult& hit) const
+    {
+        if (hit.instanceIdx == NO_INSTANCE)
+        {
+            return *m_scenePrimitives[hit.primitiveIdx];
+        }
+        return *m_instances[hit.instanceIdx].mesh->getPrimitives()[hit.primitiveIdx];
+    }
 
-            diffuse = (lightColor * color * material.kd * diff);
+    vec3 Context::getHitNormal(const TraceRayResult& hit) const
+    {
+        const Primitive& primitive = getHitPrimitive(hit);
+        if (hit.instanceIdx == NO_INSTANCE)
+        {
+            return primitive.getNormal(hit.hitPoint);
+        }
+        const Instance& instance = m_instances[hit.instanceIdx];
+        return instance.normalToWorld(primitive.getNormal(vec3(instance.toObject * vec4(hit.hitPoint, 1))));
+    }
 
-            float spec = std::pow(std::fmax(0.0f, math::dotProduct(camera, reflectedDir)), material.shine);
+    void Context::addTriangles(const float* vertices, uint32_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
 
-            specular = (lightColor * material.ks * spec);
+        // Primitives alias slots of one block, which lives until the last of them is released
+        Triangle* storage = static_cast<Triangle*>(::operator new(count * sizeof(Triangle), std::align_val_t(alignof(Triangle))));
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const float* v = vertices + 9 * i;
+#ifndef SGL_TEXTURES_ENABLED
+            new (storage + i) Triangle(m_currentMaterial, vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), vec3(v[6], v[7], v[8]));
+#else
+            new (storage + i) Triangle(m_currentMaterial, vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), vec3(v[6], v[7], v[8]), vec2(1, 1), vec2(1,0), vec2(0, 0));
+#endif
+        }
+        std::shared_ptr<Triangle> block(storage, [count](Triangle* triangles)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                triangles[i].~Triangle();
+            }
+            ::operator delete(triangles, std::align_val_t(alignof(Triangle)));
+        });
 
-            result += (diffuse + specular);
+        if (m_isSpecifyingMesh)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                m_meshes[m_currentMesh]->addPrimitive(std::shared_ptr<Primitive>(block, storage + i));
+            }
+            return;
         }
 
-        return result;
+        m_scenePrimitives.reserve(m_scenePrimitives.size() + count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            m_scenePrimitives.emplace_back(std::shared_ptr<Primitive>(block, storage + i));
+            if (m_currentMaterial->isEmissive())
+            {
+                const EmissiveMaterial& emissiveMaterial = static_cast<EmissiveMaterial&>(*m_currentMaterial);
+                addLight(std::make_shared<AreaLight>(storage[i].getVertex(0), storage[i].getVertex(1), storage[i].getVertex(2), emissiveMaterial.getColor(), emissiveMaterial.c0, emissiveMaterial.c1, emissiveMaterial.c2));
+            }
+        }
     }
 
     void Context::addSphere(const vec3 &center, float radius)
     {
-        m_scenePrimitives.emplace_back(std::make_shared<Sphere>(m_currentMaterial, center, radius));
+        std::shared_ptr<Primitive> sphere = std::make_shared<Sphere>(m_currentMaterial, center, radius);
+        if (m_isSpecifyingMesh)
+        {
+            m_meshes[m_currentMesh]->addPrimitive(std::move(sphere));
+            return;
+        }
+        m_scenePrimitives.emplace_back(std::move(sphere));
     }
 
     void Context::setAreaMode(uint32_t areaMode)
     {
         m_areaMode = areaMode;
+        if (m_isRecordingList)
+        {
+            recordCommand(DisplayList::CommandType::AREA_MODE, areaMode, vec3(), 0);
+        }
     }
 
     void Context::drawCircle(vec3 center, float radius, bool fill) 
     {
+        if (m_isRecordingList)
+        {
+            // Scaled the way the circle is scaled to the window below, by the modelview recorded
+            const mat4& mv = getModelView();
+            const float scale = std::sqrt(std::abs(mv[0][0] * mv[1][1] - mv[0][1] * mv[1][0]));
+            recordCommand(DisplayList::CommandType::CIRCLE, 0, vec3(mv * vec4(center, 1)), radius * scale);
+            return;
+        }
+        flushRaster();
         vec3 tCenter(m_PVM * vec4(center, 1));
 
         if (m_areaMode == SGL_POINT)
@@ -815,6 +2149,11 @@ namespace sgl
         float scale = std::sqrt(std::abs(mv00 * mv11 - mv01 * mv10));
 
         radius *= scale;
+        // Circles wholly outside the buffer leave every pixel they would put to the bounds checks
+        if (c.x + radius + 1 < 0 || c.x - radius - 1 >= m_width || c.y + radius + 1 < 0 || c.y - radius - 1 >= m_height)
+        {
+            return;
+        }
         
         int x, y, p, fourX, fourY;
         x = 0;
@@ -825,7 +2164,7 @@ namespace sgl
 
         std::function putLineFunc = [&](const vec3& p1, const vec3& p2, const vec3& color) { putPixelRow(p1, p2, color); };
         std::function putPixelFunc = [&](const vec3& p, const vec3& color) { putPixel(p, color); };
-        if (m_features.test(SGL_DEPTH_TEST))
+        if (isFeatureEnabled(SGL_DEPTH_TEST))
         {
             putLineFunc = [&](const vec3& p1, const vec3& p2, const vec3& color) { putPixelRowDepth(p1, p2, color); };
             putPixelFunc = [&](const vec3& p, const vec3& color) { putPixelDepth(p, color); };
@@ -928,12 +2267,18 @@ namespace sgl
 
     void Context::drawPoint(float x, float y, float z) 
     {
-        bool isDepthTest = m_features.test(SGL_DEPTH_TEST);
+        // Points whose center falls outside the buffer are dropped whole, as clipping drops the ones
+        // outside the frustum
+        if (!(x >= 0 && x < m_width && y >= 0 && y < m_height))
+        {
+            return;
+        }
+        flushRaster();
+        bool isDepthTest = isFeatureEnabled(SGL_DEPTH_TEST);
         float halfSize = m_pointSize * 0.5;
 
         if (isDepthTest)
         {
-            assert(x >= 0 && x < m_width && y >= 0 && y < m_height);
             int ix = static_cast<int>(x);
             int iy = static_cast<int>(y);
             int idx = point2idx(ix, iy);
@@ -944,6 +2289,7 @@ namespace sgl
             else
             {
                 m_depthBuffer[idx] = z;
+                m_hierarchicalZ.write(ix, iy, z);
             }
         }
 
@@ -963,6 +2309,16 @@ namespace sgl
 
     void Context::fill(const std::vector<vec4>& vertices)
     {
+        if (isFeatureEnabled(SGL_DEFERRED_RASTER) && m_rasterBins.add(vertices, m_drawColor, false, m_width, m_height))
+        {
+            return;
+        }
+        flushRaster();
+        if (m_rasterizer.fill(vertices.data(), vertices.size(), m_drawColor, m_colorBuffer.data(), nullptr, nullptr, m_width, m_height, 0, m_height))
+        {
+            return;
+        }
+
         struct Edge
         {
             int yMax;
@@ -973,8 +2329,13 @@ namespace sgl
         auto yComparator = [](const auto& v1, const auto& v2) { return v1.y < v2.y; };
         auto [min, max] = std::minmax_element(vertices.begin(), vertices.end(), yComparator);
         assert(min != vertices.end() && max != vertices.end());
-        int minY = (*min).y;
-        int maxY = (*max).y;
+        // Only the rows of the buffer are filled, edges starting below it are stepped up to its first row
+        int minY = std::max(static_cast<int>((*min).y), 0);
+        int maxY = std::min(static_cast<int>((*max).y), static_cast<int>(m_height));
+        if (minY >= maxY)
+        {
+            return;
+        }
 
         std::vector<std::vector<Edge>> edgeTable(maxY - minY + 1);
 
@@ -997,7 +2358,15 @@ namespace sgl
             e.yMax = static_cast<int>(p2.y);
             e.x = p1.x;
             e.inverseSlope = (p2.x-p1.x) / (p2.y-p1.y);
-            edgeTable[static_cast<int>(p1.y) - minY].emplace_back(e);
+            int y = static_cast<int>(p1.y);
+            for (; y < minY && y < e.yMax; ++y)
+            {
+                e.x += e.inverseSlope;
+            }
+            if (y < e.yMax && y < maxY)
+            {
+                edgeTable[y - minY].emplace_back(e);
+            }
         }
 
         std::vector<Edge> activeTable;
@@ -1030,6 +2399,17 @@ namespace sgl
 
     void Context::fillDepth(const std::vector<vec4>& vertices)
     {
+        if (isFeatureEnabled(SGL_DEFERRED_RASTER) && m_rasterBins.add(vertices, m_drawColor, true, m_width, m_height))
+        {
+            return;
+        }
+        flushRaster();
+        if (m_rasterizer.fill(vertices.data(), vertices.size(), m_drawColor, m_colorBuffer.data(), m_depthBuffer.data(), &m_hierarchicalZ,
+                              m_width, m_height, 0, m_height))
+        {
+            return;
+        }
+
         struct Edge
         {
             int yMax;
@@ -1042,8 +2422,13 @@ namespace sgl
         auto yComparator = [](const auto& v1, const auto& v2) { return v1.y < v2.y; };
         auto [min, max] = std::minmax_element(vertices.begin(), vertices.end(), yComparator);
         assert(min != vertices.end() && max != vertices.end());
-        int minY = (*min).y;
-        int maxY = (*max).y;
+        // Only the rows of the buffer are filled, edges starting below it are stepped up to its first row
+        int minY = std::max(static_cast<int>((*min).y), 0);
+        int maxY = std::min(static_cast<int>((*max).y), static_cast<int>(m_height));
+        if (minY >= maxY)
+        {
+            return;
+        }
 
         std::vector<std::vector<Edge>> edgeTable(maxY - minY + 1);
 
@@ -1068,7 +2453,16 @@ namespace sgl
             e.inverseSlope = (p2.x-p1.x) / (p2.y-p1.y);
             e.z = p1.z;
             e.zSlope = (p2.z-p1.z) / (p2.y-p1.y);
-            edgeTable[p1.y - minY].emplace_back(e);
+            int y = static_cast<int>(p1.y);
+            for (; y < minY && y < e.yMax; ++y)
+            {
+                e.x += e.inverseSlope;
+                e.z += e.zSlope;
+            }
+            if (y < e.yMax && y < maxY)
+            {
+                edgeTable[y - minY].emplace_back(e);
+            }
         }
 
         std::vector<Edge> activeTable;
@@ -1104,6 +2498,14 @@ namespace sgl
         }
     }
 
+    void Context::flushRaster()
+    {
+        if (!m_rasterBins.isEmpty())
+        {
+            m_rasterBins.flush(getThreadPool(), m_colorBuffer.data(), m_depthBuffer.data(), &m_hierarchicalZ, m_width, m_height);
+        }
+    }
+
     int Context::getId() const
     {
         return m_id;
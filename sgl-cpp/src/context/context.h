@@ -1,13 +1,25 @@
 #pragma once
+#include "bvh.h"
+#include "clipper.h"
+#include "display_list.h"
 #include "light.h"
+#include "light_tree.h"
 #include "material.h"
 #include "environment_map.h"
+#include "hierarchical_z.h"
 #include "math/vector.h"
 #include "math/matrix.h"
 #include "primitive.h"
+#include "raster_bins.h"
+#include "rasterizer.h"
+#include "scene_geometry.h"
+#include "thread_pool.h"
+#include "math/sampler.h"
+#include "mesh.h"
 
 #include <bitset>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <vector>
 #include <cstdint>
@@ -44,6 +56,8 @@ public:
     void setDrawColor(const vec3& color); 
     void setPointSize(float newSize);
     void setAreaMode(uint32_t areaMode);
+    void setRenderParameter(uint32_t parameter, int value);
+    void setRenderParameter(uint32_t parameter, float value);
 //
 
 // Context state getters
@@ -60,6 +74,32 @@ public:
     void addVertex(const vec4& vertex);
     void addVertex(const vec4& vertex, const mat4& matrix);
     void endPrimitive();
+    // Vertex array of drawArrays and drawElements, size coordinates of a vertex stride bytes apart
+    // (0 for tightly packed). A null pointer unsets it
+    void setVertexPointer(int size, int stride, const float* pointer);
+    bool hasVertexPointer() const;
+    // Specifies a primitive of count vertices of the array, the same as if they were added one by
+    // one between beginPrimitive and endPrimitive. In a scene or a mesh, SGL_TRIANGLES are
+    // independent triangles added by addTriangles
+    void drawArrays(uint32_t elementType, int first, int count);
+    void drawElements(uint32_t elementType, int count, const uint32_t* indices);
+    // Rasterizes the polygons deferred since SGL_DEFERRED_RASTER was enabled. Anything else drawing
+    // into or reading the buffers flushes them first
+    void flushRaster();
+//
+
+// Display lists
+    // Records the state changes and primitives specified until endList into a new list instead of
+    // drawing them, returns its id. Modelview transformations start from the identity, the modelview
+    // the list is called with, and are applied to the vertices as they are recorded. The state set
+    // while recording is restored by endList
+    int newList();
+    void endList();
+    bool isRecordingList() const;
+    // Whether list is the id of a completely recorded list
+    bool hasList(int list) const;
+    // Draws the list with the current modelview, which is then multiplied by the one the list ended with
+    void callList(int list);
 //
 
 // Scene handling
@@ -67,10 +107,40 @@ public:
     void endScene();
     bool isSpecifyingScene() const;
     void renderScene();
+    // Adds samples jittered primary rays per pixel to the accumulation buffer and resolves the
+    // color buffer from it. Accumulation starts over whenever the scene or the camera changes
+    void renderSceneProgressive(uint32_t samples);
+    // Draws the scene with the z-buffered rasterizer, a preview of what renderScene traces. Spheres
+    // are tessellated, pixels are lit by every light with the phong model, without shadows, reflections
+    // or refractions. The depth buffer holds the depths of the scene afterwards
+    void rasterizeScene();
+    uint32_t getSampleCount() const;
+    // Mean relative error (see relativeError) of the accumulated pixels, 1 until two samples are known
+    float getNoiseEstimate() const;
+    // Statistics of the hierarchy built by the last endScene
+    const Bvh::Statistics& getBvhStatistics() const;
     void setCurrentMaterial(std::shared_ptr<Material> material);
     void setCurrentEnvironMap(const EnvironmentMap& envMap);
     void addLight(std::shared_ptr<Light> light);
     void addSphere(const vec3& center, float radius);
+    // Adds count triangles given by nine consecutive coordinates each, the same way as polygons
+    // specified vertex by vertex. Triangles of a call share one allocation
+    void addTriangles(const float* vertices, uint32_t count);
+    // Primitives specified between beginMesh and endMesh form a mesh instead of being added
+    // to the scene, beginMesh returns its id
+    int beginMesh();
+    // Specifies primitives of an existing mesh again, its instances follow once endMesh is called
+    void updateMesh(int mesh);
+    void endMesh();
+    bool isSpecifyingMesh() const;
+    bool hasMesh(int mesh) const;
+    // Places the mesh into the scene transformed by the current modelview matrix, returns a
+    // handle of the instance valid until the next beginScene
+    int addInstance(int mesh);
+    bool hasInstance(int instance) const;
+    // Moves the instance to the current modelview matrix. The top level hierarchy is refitted
+    // before the next rendering instead of rebuilding the scene
+    void setInstanceTransform(int instance);
 //
     
 // Shapes rendering functions
@@ -82,6 +152,9 @@ public:
 
 private:
 
+    // Whether any of the features given by their SGL_* flags is enabled
+    bool isFeatureEnabled(uint32_t feature) const;
+
 // Pixel handling
     inline void putPixel(int x, int y, const vec3& color);
     inline void putPixelDepth(int x, int y, float z, const vec3& color);
@@ -98,23 +171,131 @@ private:
 //
 
 // Ray tracing
+    static constexpr uint32_t NO_INSTANCE = std::numeric_limits<uint32_t>::max();
     struct TraceRayResult
     {
         bool anyHit;
         vec3 hitPoint;
-        std::shared_ptr<Primitive> hitPrimitive;
+        // Index into m_scenePrimitives, or into the primitives of the instanced mesh, valid when anyHit is set
+        uint32_t primitiveIdx;
+        // Index into m_instances, NO_INSTANCE for primitives of the scene itself
+        uint32_t instanceIdx = NO_INSTANCE;
     };
-    vec3 castRay(const Ray& ray, int depth = 0) const;
-    Context::TraceRayResult traceRay(const Ray& ray, bool anyHit = false, float eps = 0.1) const;
-    // Returns color of a pixel according to phong model
-    vec3 calculatePhong(const Material& material, const vec3& intersectionPoint, const vec3& surfaceNormal, const vec3& camera, const Light& light, std::shared_ptr<Primitive> primitive = nullptr) const;
+    // Leaf position of the primitive that last blocked a shadow ray towards each light, tested
+    // first by the next shadow ray towards the same light. Every tile owns one, so no state
+    // is shared between threads
+    using OccluderCache = std::vector<uint32_t>;
+    static constexpr uint32_t NO_OCCLUDER = std::numeric_limits<uint32_t>::max();
+
+    vec3 castRay(const Ray& ray, Sampler& sampler, OccluderCache& occluders, int depth = 0) const;
+    // Color seen along the ray given its traced hit, lightVisibility optionally holds
+    // the already known visibility of each single sample light from the hit point
+    vec3 shadeRay(const Ray& ray, const TraceRayResult& hit, Sampler& sampler, OccluderCache& occluders, int depth, const uint8_t* lightVisibility = nullptr) const;
+    Context::TraceRayResult traceRay(const Ray& ray) const;
+    // Closest hit of a ray (with a normalized direction) with primitives of a hierarchy closer than
+    // closestDistance, which is updated together with primitiveIdx and point on success
+    bool traceGeometry(const Bvh& bvh, const SceneGeometry& geometry, const Ray& ray, float& closestDistance, uint32_t& primitiveIdx, vec3& point) const;
+    // Replaces the result by hits with instances closer than closestDistance, rays are transformed
+    // into object space of every instance whose world bounds they reach
+    void traceInstances(const Ray& ray, float& closestDistance, TraceRayResult& result) const;
+    // Traces up to RayPacket::SIZE coherent rays at once, results match traceRay for each of them
+    void traceRayPacket(const vec3* origins, const vec3* dirs, int count, TraceRayResult* results, Ray::Type type = Ray::Type::NORMAL) const;
+    // Whether a non-emissive primitive blocks the ray (with a normalized direction) closer than tMax.
+    // Stops at the first blocker found, starting with lastOccluder which is updated on success
+    bool isOccluded(const Ray& ray, float tMax, uint32_t& lastOccluder) const;
+    // Leaf position of a primitive of the hierarchy blocking the ray closer than tMax, NO_OCCLUDER if there is none
+    uint32_t occludeGeometry(const Bvh& bvh, const SceneGeometry& geometry, const Ray& ray, float tMax) const;
+    bool isOccludedByInstances(const Ray& ray, float tMax) const;
+    // Packet version of isOccluded, returns a bit per blocked ray
+    int isOccluded(const vec3* origins, const vec3* dirs, const float* tMax, int count, uint32_t& lastOccluder) const;
+    // Traces a packet of primary rays followed by packets of shadow rays from their hits towards
+    // each single sample light, lightVisibility receives lightCount entries per ray
+    void tracePrimaryPacket(const vec3* origins, const vec3* dirs, int count, TraceRayResult* hits, OccluderCache& occluders, uint8_t* lightVisibility) const;
+    // Traces packets of shadow rays from the hits towards each single sample light, lightVisibility
+    // receives lightCount entries per hit
+    void traceShadowPackets(const TraceRayResult* hits, int count, OccluderCache& occluders, uint8_t* lightVisibility) const;
+    // Returns color of a pixel lit by a point or directional light according to phong model
+    vec3 calculatePhong(const Material& material, const vec3& surfaceColor, const vec3& intersectionPoint, const vec3& surfaceNormal, const vec3& camera, const Light& light, uint32_t& lastOccluder, const uint8_t* visibility = nullptr) const;
+    // Returns color of a pixel lit by all area lights, AreaLight::SAMPLE_NUMBER samples are spread
+    // over them by m_areaLightTree and weighted by the probability of picking their light
+    vec3 calculateAreaLights(const Material& material, const vec3& surfaceColor, const vec3& intersectionPoint, const vec3& surfaceNormal, const vec3& camera, Sampler& sampler, OccluderCache& occluders) const;
+    // Phong terms of a single light sample, lightDir is normalized
+    vec3 phong(const Material& material, const vec3& surfaceColor, const vec3& surfaceNormal, const vec3& camera, const vec3& lightColor, const vec3& lightDir) const;
+    // Diffuse color of the material at a hit, textures are filtered over the footprint of the ray
+    vec3 surfaceColor(const Ray& ray, const TraceRayResult& hit, const vec3& surfaceNormal) const;
+    const Primitive& getHitPrimitive(const TraceRayResult& hit) const;
+    // World space normal of the hit primitive at the hit point
+    vec3 getHitNormal(const TraceRayResult& hit) const;
+    // Color of rays that hit nothing, from the environment map or the clear color
+    vec3 background(const vec3& dir) const;
+//
+
+// Rasterized visibility
+    static constexpr uint32_t NO_SURFACE = std::numeric_limits<uint32_t>::max();
+    // Spheres are tessellated into a grid of rings from pole to pole and segments around the axis
+    static constexpr int SPHERE_RINGS = 16;
+    static constexpr int SPHERE_SEGMENTS = 32;
+    // Rasterizes the primitives of the scene and of its instances, leaving the surface covering each
+    // pixel in m_visibleIds and its depth in the depth buffer
+    void rasterizeVisibility();
+    // Rasterizes the primitive, transformed to window coordinates by toWindow, as the surface of its pixels
+    void rasterizePrimitive(const Primitive& primitive, const mat4& toWindow, const TraceRayResult& surface);
+    // Rasterizes a triangle of window coordinates not yet divided by w as surface id, clipped to the frustum
+    void rasterizeVisibilityTriangle(const vec4& a, const vec4& b, const vec4& c, uint32_t id);
+    // Hit of a primary ray of a pixel with the surface rasterized at it, tested as traceRay tests it, no
+    // hit when none is. Returns false, leaving the surface with no hit point, when the ray misses it
+    bool intersectVisible(int xp, int yp, const Ray& primary, TraceRayResult& hit) const;
+    // Whether the pixel and its eight neighbours hold the same surface. Rasterized coverage is off by up
+    // to a pixel from what rays see, so only such pixels are known to see that surface with every sample;
+    // the facets of spheres enclose them for their silhouettes to count too
+    bool isVisibleInterior(int xp, int yp) const;
+    // Color seen along the ray given the surface rasterized at its pixel, lit without shadows
+    vec3 shadePreview(const Ray& ray, const TraceRayResult& hit) const;
+//
+
+// Sampling
+    // Standard error of the mean pixel luminance relative to the luminance itself, given sums over
+    // at least two samples. Luminances below NOISE_LUMINANCE_FLOOR count as the floor so that
+    // noise in nearly black pixels does not dominate
+    static double relativeError(double luminanceSum, double luminanceSquareSum, uint32_t sampleCount);
+    static constexpr double NOISE_LUMINANCE_FLOOR = 0.05;
+    // Angle between the primary rays of neighbouring pixels, the width of a ray cone per unit of distance
+    float pixelSpread(const vec4& originWorld, const mat4& invPVM) const;
+    // Direction of the primary ray of the given pixel sample
+    vec3 primaryDir(int xp, int yp, uint32_t sample, const vec4& originWorld, const mat4& invPVM) const;
+    // Traces samples [firstSample, firstSample + count) of a pixel, at most RayPacket::SIZE of them.
+    // lightVisibility has room for RayPacket::SIZE entries per light
+    void tracePixelSamples(int xp, int yp, uint32_t firstSample, int count, const vec4& originWorld, const mat4& invPVM, OccluderCache& occluders, uint8_t* lightVisibility, vec3* colors) const;
+    // Adds samples to pixels of the rendered image until the relative error of each drops to the
+    // noise target or it reaches the maximum sample count
+    void applyAdaptiveSampling(const vec4& originWorld, const mat4& invPVM);
+//
+
+// Parallel rendering
+    // Traces one sample of every pixel of the tile and passes its color to sink(x, y, color).
+    // Sample 0 goes through pixel centers, the others are jittered. With isRasterized, the first
+    // hits of sample 0 come from rasterizeVisibility instead of primary rays
+    void renderTile(int x0, int y0, int x1, int y1, const vec4& originWorld, const mat4& invPVM, uint32_t sample, bool isRasterized, const std::function<void(int, int, const vec3&)>& sink) const;
+    ThreadPool& getThreadPool();
+    // Splits the image into tiles and runs tileFunc(x0, y0, x1, y1) for each of them in parallel
+    void forEachTile(const std::function<void(int, int, int, int)>& tileFunc);
 //
 
 // Primitive rendering
     void drawLine(vec3 p1, vec3 p2);
     void drawPoint(float x, float y, float z);
     void drawPoint(vec3 pt);
+    // Draws the primitive of the vertex buffer, its vertices in homogeneous window coordinates
     void drawBuffer();
+    void drawPrimitive(uint32_t elementType, const vec4* vertices, int vertexCount);
+    // Draw what the clipper leaves of a point, a line or a polygon given in homogeneous window coordinates
+    void drawClippedPoint(const vec4& vertex);
+    void drawClippedLine(const vec4& from, const vec4& to);
+    void fillClipped(const vec4* vertices, size_t count);
+    // Assembles count vertices of the array at indices(i), transformed in one pass
+    template <typename Indices>
+    void drawVertexArray(uint32_t elementType, int count, Indices indices);
+    vec4 getArrayVertex(uint32_t index) const;
 
     void fill(const std::vector<vec4>& vertices);
     void fillDepth(const std::vector<vec4>& vertices);
@@ -150,24 +331,96 @@ private:
 
     // Depth buffer
     std::vector<float> m_depthBuffer;
+    // Depth bounds of its tiles, kept up to date with every write to it
+    HierarchicalZ m_hierarchicalZ;
     uint32_t m_areaMode;
-    std::function<void(const std::vector<vec4>&)> m_fillFunc;
+    void (Context::*m_fillFunc)(const std::vector<vec4>&);
+    // Clips primitives before they are divided by w and drawn
+    Clipper m_clipper;
+    // Fills convex polygons, the others fall back to the scanline fill
+    Rasterizer m_rasterizer;
+    RasterBins m_rasterBins;
 
     // Vertex data
     std::vector<vec4> m_vertexBuffer;
     uint32_t m_elementType;
     mat4 m_PVM;
+    const float* m_vertexPointer = nullptr;
+    int m_vertexSize = 3;
+    int m_vertexStride = 0;
+    // Coordinates of scene triangles assembled from the vertex array
+    std::vector<float> m_arrayTriangles;
 
     // Scene data
     bool m_isSpecifyingScene;
     std::vector<std::shared_ptr<Primitive>> m_scenePrimitives;
     std::vector<std::shared_ptr<Light>> m_sceneLights;
+    LightTree m_areaLightTree;
+    Bvh m_sceneBvh;
+    SceneGeometry m_sceneGeometry;
+    // Meshes outlive scenes, the top level hierarchy over instances is rebuilt by endScene
+    bool m_isSpecifyingMesh = false;
+    uint32_t m_currentMesh = 0;
+    std::vector<std::shared_ptr<Mesh>> m_meshes;
+    std::vector<Instance> m_instances;
+    Bvh m_instanceBvh;
+    // Instances changed since the top level hierarchy was built or refitted
+    bool m_isSceneDirty = false;
+    // Replaces area lights of the instance by ones following its transform and mesh
+    void updateInstanceLights(uint32_t instanceIdx);
+    void buildAreaLightTree();
+    // Refits the top level hierarchy to changed instances, called before rendering
+    void updateScene();
     std::shared_ptr<Material> m_currentMaterial;
     EnvironmentMap m_currentEnvMap;
     bool m_hasEnvironmentMap = false;
 
-    // Adaptive antialising
-     void applyAdaptiveAntialiasing();
+    // Parallel rendering
+    uint32_t m_threadCount;
+    uint32_t m_tileSize;
+    bool m_packetTracing;
+    // First hits of sample 0 come from the rasterized scene rather than from primary rays
+    bool m_hybridTracing;
+    uint32_t m_minSamples;
+    uint32_t m_maxSamples;
+    float m_noiseTarget;
+    Bvh::Builder m_bvhBuilder;
+    // Set by pixelSpread before rendering starts
+    float m_pixelSpread = 0.f;
+    std::unique_ptr<ThreadPool> m_threadPool;
+
+    // Progressive rendering
+    void resetAccumulation();
+    std::vector<vec3> m_accumulation;
+    std::vector<float> m_luminanceSquares;
+    uint32_t m_sampleCount = 0;
+    float m_noiseEstimate = 1.f;
+    // Camera the accumulated samples were traced with
+    mat4 m_accumulationPVM = mat4::identity;
+
+    // Display lists
+    void recordCommand(DisplayList::CommandType type, uint32_t value, const vec3& vector, float scalar);
+    std::vector<DisplayList> m_lists;
+    // The last list is being recorded
+    bool m_isRecordingList = false;
+    // State recording a list changes, restored by endList
+    struct ListState
+    {
+        std::vector<mat4> modelStack;
+        bool isModelActive;
+        vec3 drawColor;
+        uint32_t areaMode;
+        float pointSize;
+        std::bitset<sizeof(uint32_t)*8> features;
+        void (Context::*fillFunc)(const std::vector<vec4>&);
+    };
+    ListState m_listState;
+    // Vertices of the list being called in homogeneous window coordinates
+    std::vector<vec4> m_listVertices;
+
+    // Rasterized visibility, the surface covering each pixel as an index into m_visibleSurfaces
+    std::vector<uint32_t> m_visibleIds;
+    std::vector<TraceRayResult> m_visibleSurfaces;
 
 };
 
@@ -73,6 +73,17 @@ namespace sgl
         return isContextValid(m_activeContextId);
     }
 
+    void SglController::flushContexts()
+    {
+        for (Context& context : m_contexts)
+        {
+            if (context.isInitialized())
+            {
+                context.flushRaster();
+            }
+        }
+    }
+
     int SglController::getActiveId() const 
     {
         return m_activeContextId;
@@ -92,7 +103,11 @@ namespace sgl
 
     void SglController::setError(uint8_t errorCode)
     {
-        
+        // Later errors are dropped until the first one is read
+        if (m_currentError == SGL_NO_ERROR)
+        {
+            m_currentError = errorCode;
+        }
     }
 
     const char* SglController::getErrorString(uint8_t errorCode) const
@@ -19,6 +19,8 @@ namespace sgl
         int getActiveId() const;
         bool isContextValid(int id) const;
         bool isActiveValid() const;
+        // Rasterizes what every context deferred
+        void flushContexts();
 
         uint8_t getError();
         void setError(uint8_t errorCode);
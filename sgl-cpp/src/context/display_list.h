@@ -0,0 +1,49 @@
+#pragma once
+
+#include "math/matrix.h"
+#include "math/vector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace sgl
+{
+
+// Drawing commands recorded once and replayed any number of times. The vertices of the primitives
+// are stored already transformed by the modelview specified while recording, relative to the one the
+// list is called with, all in one array. A call transforms the whole array by a single matrix and
+// the commands then draw ranges of it, without a matrix product or a call per vertex.
+struct DisplayList
+{
+    enum class CommandType : uint8_t
+    {
+        COLOR,
+        AREA_MODE,
+        POINT_SIZE,
+        ENABLE,
+        DISABLE,
+        PRIMITIVE,
+        CIRCLE
+    };
+
+    struct Command
+    {
+        CommandType type;
+        // Element type of a primitive, area mode or features
+        uint32_t value;
+        // Vertices [first, first + count) of a primitive
+        uint32_t first;
+        uint32_t count;
+        // Color, or center of a circle
+        vec3 vector;
+        // Point size, or radius of a circle
+        float scalar;
+    };
+
+    std::vector<Command> commands;
+    std::vector<vec4> vertices;
+    // Modelview the list leaves relative to the one it is called with
+    mat4 transform = mat4::identity;
+};
+
+}
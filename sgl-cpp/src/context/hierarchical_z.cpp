@@ -0,0 +1,118 @@
+#include "hierarchical_z.h"
+
+#include "math/simd.h"
+
+namespace sgl
+{
+
+HierarchicalZ::HierarchicalZ(int width, int height, float depth)
+    : m_tiles(((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE)),
+      m_width(width),
+      m_height(height),
+      m_tilesX((width + TILE_SIZE - 1) / TILE_SIZE)
+{
+    clear(depth);
+}
+
+void HierarchicalZ::clear(float depth)
+{
+    std::fill(m_tiles.begin(), m_tiles.end(), Tile{ depth, depth, 0 });
+}
+
+void HierarchicalZ::writeTiles(int startX, int startY, int endX, int endY, float z)
+{
+    Tile* row = m_tiles.data() + (startY / TILE_SIZE) * m_tilesX;
+    for (int tileX = startX / TILE_SIZE; tileX <= (endX - 1) / TILE_SIZE; ++tileX)
+    {
+        const int columns = std::min(endX, (tileX + 1) * TILE_SIZE) - std::max(startX, tileX * TILE_SIZE);
+        row[tileX].min = std::min(row[tileX].min, z);
+        row[tileX].written += columns * (endY - startY);
+    }
+}
+
+bool HierarchicalZ::isOccluded(int startX, int startY, int endX, int endY, float z, const float* depthBuffer)
+{
+    for (int tileY = startY / TILE_SIZE; tileY <= (endY - 1) / TILE_SIZE; ++tileY)
+    {
+        Tile* row = m_tiles.data() + tileY * m_tilesX;
+        for (int tileX = startX / TILE_SIZE; tileX <= (endX - 1) / TILE_SIZE; ++tileX)
+        {
+            Tile& tile = row[tileX];
+            if (z >= tile.max)
+            {
+                continue;
+            }
+            // Some depth is greater than z for sure when the least one is, otherwise the greatest
+            // one may have come down to z since it was computed
+            if (z < tile.min || tile.written < TILE_SIZE * TILE_SIZE)
+            {
+                return false;
+            }
+            refresh(tile, tileX, tileY, depthBuffer);
+            if (z < tile.max)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool HierarchicalZ::isVisible(int startX, int startY, int endX, int endY, float z) const
+{
+    for (int tileY = startY / TILE_SIZE; tileY <= (endY - 1) / TILE_SIZE; ++tileY)
+    {
+        const Tile* row = m_tiles.data() + tileY * m_tilesX;
+        for (int tileX = startX / TILE_SIZE; tileX <= (endX - 1) / TILE_SIZE; ++tileX)
+        {
+            if (!(z < row[tileX].min))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void HierarchicalZ::refresh(Tile& tile, int tileX, int tileY, const float* depthBuffer) const
+{
+    const int startX = tileX * TILE_SIZE;
+    const int endX = std::min(startX + TILE_SIZE, m_width);
+    const int startY = tileY * TILE_SIZE;
+    const int endY = std::min(startY + TILE_SIZE, m_height);
+    if (endX - startX == TILE_SIZE)
+    {
+        // Rows of a whole tile are two lanes of four
+        float4 low = float4::load(depthBuffer + startY * m_width + startX);
+        float4 high = low;
+        for (int y = startY; y < endY; ++y)
+        {
+            const float* row = depthBuffer + y * m_width + startX;
+            for (int i = 0; i < TILE_SIZE; i += 4)
+            {
+                const float4 depths = float4::load(row + i);
+                low = select(depths < low, depths, low);
+                high = select(depths > high, depths, high);
+            }
+        }
+        tile.min = std::min(std::min(low[0], low[1]), std::min(low[2], low[3]));
+        tile.max = std::max(std::max(high[0], high[1]), std::max(high[2], high[3]));
+    }
+    else
+    {
+        tile.min = depthBuffer[startY * m_width + startX];
+        tile.max = tile.min;
+        for (int y = startY; y < endY; ++y)
+        {
+            const float* row = depthBuffer + y * m_width;
+            for (int x = startX; x < endX; ++x)
+            {
+                tile.min = std::min(tile.min, row[x]);
+                tile.max = std::max(tile.max, row[x]);
+            }
+        }
+    }
+    tile.written = 0;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace sgl
+{
+
+// Coarse level above the depth buffer, the bounds of the depths held by each tile of pixels. A tile
+// whose depths are all at most the nearest depth of a primitive hides it, the primitive fails the
+// test on every pixel of the tile and is rejected before any of them is visited. A tile whose depths
+// are all greater than the farthest depth of a primitive lets every fragment of it pass, which is
+// written without being tested.
+//
+// Depths only decrease between clears. The least depth of a tile is lowered as depths are written,
+// the greatest one only stays an upper bound, and is recomputed from the depth buffer when it matters
+// once as many pixels as the tile holds were written since it was last computed. Recomputing it after
+// every write costs more than the primitives it then rejects.
+class HierarchicalZ
+{
+public:
+    // Pixels along each side of a tile
+    static constexpr int TILE_SIZE = 8;
+
+    HierarchicalZ() = default;
+    HierarchicalZ(int width, int height, float depth);
+
+    // Sets every pixel back to depth, as clearing the depth buffer does
+    void clear(float depth);
+    // Pixel (x, y) was written with depth z
+    void write(int x, int y, float z)
+    {
+        Tile& tile = m_tiles[(y / TILE_SIZE) * m_tilesX + x / TILE_SIZE];
+        tile.min = std::min(tile.min, z);
+        ++tile.written;
+    }
+    // Columns [startX, endX) of rows [startY, endY), all in one tile row, were written with depths of at least z
+    void writeTiles(int startX, int startY, int endX, int endY, float z);
+    // Whether the pixels of the tiles overlapping columns [startX, endX) of rows [startY, endY) all hold
+    // a depth of at most z, fragments at z or behind failing the test on each of them
+    bool isOccluded(int startX, int startY, int endX, int endY, float z, const float* depthBuffer);
+    // Whether the pixels of the tiles overlapping the columns and rows all hold a depth greater than z,
+    // fragments at z or before passing the test on each of them
+    bool isVisible(int startX, int startY, int endX, int endY, float z) const;
+
+private:
+    struct Tile
+    {
+        float min;
+        float max;
+        // Pixels written since max was computed
+        int written;
+    };
+
+    // Recomputes both bounds of a tile
+    void refresh(Tile& tile, int tileX, int tileY, const float* depthBuffer) const;
+
+    std::vector<Tile> m_tiles;
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesX = 0;
+};
+
+}
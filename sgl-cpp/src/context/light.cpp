@@ -1,7 +1,7 @@
 #include "light.h"
 #include "math/utils.h"
 #include <cmath>
-#include <cstdlib>
+#include <limits>
 
 namespace sgl
 {
@@ -12,6 +12,11 @@ Light::Light(const vec3& color)
     
 }
 
+float Light::getShadowDistance(const vec3& direction) const
+{
+    return math::length(direction) * (1 - SHADOW_RAY_END);
+}
+
 bool Light::isAreaLight() const 
 {
     return false;    
@@ -29,7 +34,7 @@ vec3 Light::getColor(const vec3& direction) const
     return m_color;
 }
 
-vec3 PointLight::getDirection(const vec3& from) const 
+vec3 PointLight::getDirection(const vec3& from, const vec2& sample) const 
 {
     return m_pos - from;    
 }
@@ -41,11 +46,16 @@ DirectionalLight::DirectionalLight(const vec3& dir, const vec3& color)
     
 }
 
-vec3 DirectionalLight::getDirection(const vec3& from) const 
+vec3 DirectionalLight::getDirection(const vec3& from, const vec2& sample) const 
 {
     return -m_dir;
 }
 
+float DirectionalLight::getShadowDistance(const vec3& direction) const
+{
+    return std::numeric_limits<float>::infinity();
+}
+
 AreaLight::AreaLight(const vec3& v1, const vec3& v2, const vec3& v3, const vec3& color, const float c0, const float c1, const float c2)
     : Light(color),
       m_v1(v1),
@@ -59,9 +69,9 @@ AreaLight::AreaLight(const vec3& v1, const vec3& v2, const vec3& v3, const vec3&
 {
 }
 
-vec3 AreaLight::getDirection(const vec3& from) const 
+vec3 AreaLight::getDirection(const vec3& from, const vec2& sample) const 
 {
-    return getRandomPoint() - from;
+    return samplePoint(sample) - from;
 }
 
 vec3 AreaLight::getColor(const vec3& direction) const 
@@ -76,10 +86,29 @@ bool AreaLight::isAreaLight() const
     return true;    
 }
 
-vec3 AreaLight::getRandomPoint() const 
+AABB AreaLight::getBounds() const
+{
+    AABB bounds;
+    bounds.extend(m_v1);
+    bounds.extend(m_v1 + m_e1);
+    bounds.extend(m_v1 + m_e2);
+    return bounds;
+}
+
+float AreaLight::getPower() const
+{
+    return math::luminance(m_color) * m_areaOverSamples * SAMPLE_NUMBER;
+}
+
+vec3 AreaLight::getAttenuation() const
+{
+    return vec3(m_c0, m_c1, m_c2);
+}
+
+vec3 AreaLight::samplePoint(const vec2& sample) const 
 {
-    float r1 = static_cast<float>(std::rand()) / RAND_MAX;
-    float r2 = static_cast<float>(std::rand()) / RAND_MAX;
+    float r1 = sample.x;
+    float r2 = sample.y;
     float sqrtr1 = std::sqrt(r1);
     float u = 1 - sqrtr1;
     float v = (1 - r2) * sqrtr1;
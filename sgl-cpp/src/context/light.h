@@ -1,5 +1,6 @@
 #pragma once
 
+#include "math/aabb.h"
 #include "math/vector.h"
 
 namespace sgl
@@ -14,12 +15,18 @@ public:
 
     Light(const vec3& color);
 
-    // Return direction towards light
-    virtual vec3 getDirection(const vec3& from) const = 0;
+    // Return direction towards light, sample is a uniform point in [0, 1)^2 used by lights with an extent
+    virtual vec3 getDirection(const vec3& from, const vec2& sample) const = 0;
+    // Length a shadow ray along the direction getDirection returned travels before it reaches the light
+    virtual float getShadowDistance(const vec3& direction) const;
     virtual bool isAreaLight() const;
     virtual vec3 getColor(const vec3& direction) const;
 
 protected:
+    // Shadow rays end this fraction of the distance short of the light, so that they never reach
+    // what emits it
+    static constexpr float SHADOW_RAY_END = 1e-3f;
+
     vec3 m_color;
 };
 
@@ -30,7 +37,7 @@ public:
 
     PointLight(const vec3& pos, const vec3& color);
 
-    virtual vec3 getDirection(const vec3& from) const;
+    virtual vec3 getDirection(const vec3& from, const vec2& sample) const;
 
     vec3 m_pos;
 };
@@ -42,7 +49,8 @@ public:
 
     DirectionalLight(const vec3& dir, const vec3& color);
 
-    virtual vec3 getDirection(const vec3& from) const;
+    virtual vec3 getDirection(const vec3& from, const vec2& sample) const;
+    virtual float getShadowDistance(const vec3& direction) const;
 
 private:
     vec3 m_dir;
@@ -51,18 +59,25 @@ private:
 class AreaLight : public Light
 {
 public:
+    // Shadow samples per shading point, shared by all area lights of the scene
     static const int SAMPLE_NUMBER = 16;
 
     AreaLight(AreaLight&&) = default;
 
     AreaLight(const vec3& v1, const vec3& v2, const vec3& v3, const vec3& color, const float c0, const float c1, const float c2);
 
-    virtual vec3 getDirection(const vec3& from) const;
+    virtual vec3 getDirection(const vec3& from, const vec2& sample) const;
     virtual vec3 getColor(const vec3& direction) const;
     virtual bool isAreaLight() const;
 
+    AABB getBounds() const;
+    // Emitted luminance integrated over the area, before attenuation
+    float getPower() const;
+    // Attenuation coefficients c0, c1 and c2 of the 1 / (c0 + c1 * d + c2 * d^2) falloff
+    vec3 getAttenuation() const;
+
 private:
-    vec3 getRandomPoint() const;
+    vec3 samplePoint(const vec2& sample) const;
 
     const vec3 m_v1;
     const vec3 m_e1;
@@ -0,0 +1,131 @@
+#include "light_tree.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace sgl
+{
+
+void LightTree::build(const std::vector<const AreaLight*>& lights, const std::vector<uint32_t>& indices)
+{
+    clear();
+    if (lights.empty())
+    {
+        return;
+    }
+
+    std::vector<BuildLight> buildLights(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        AABB bounds = lights[i]->getBounds();
+        buildLights[i] = { bounds, bounds.centroid(), lights[i]->getPower(), lights[i]->getAttenuation(), indices[i] };
+    }
+
+    m_nodes.reserve(2 * lights.size() - 1);
+    buildRecursive(buildLights, 0, static_cast<uint32_t>(buildLights.size()));
+}
+
+void LightTree::clear()
+{
+    m_nodes.clear();
+}
+
+bool LightTree::isEmpty() const
+{
+    return m_nodes.empty();
+}
+
+uint32_t LightTree::buildRecursive(std::vector<BuildLight>& lights, uint32_t begin, uint32_t end)
+{
+    uint32_t nodeIdx = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    Node node = { AABB(), 0.f, lights[begin].attenuation, 0, false };
+    AABB centroidBounds;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        node.bounds.extend(lights[i].bounds);
+        node.power += lights[i].power;
+        for (int c = 0; c < 3; ++c)
+        {
+            node.attenuation[c] = std::min(node.attenuation[c], lights[i].attenuation[c]);
+        }
+        centroidBounds.extend(lights[i].centroid);
+    }
+
+    if (end - begin == 1)
+    {
+        node.offset = lights[begin].index;
+        node.isLeaf = true;
+        m_nodes[nodeIdx] = node;
+        return nodeIdx;
+    }
+
+    // Median split along the longest axis keeps neighbouring emitters together
+    int axis = centroidBounds.maxExtent();
+    uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end,
+        [axis](const BuildLight& a, const BuildLight& b) { return a.centroid[axis] < b.centroid[axis]; });
+
+    buildRecursive(lights, begin, mid);
+    node.offset = buildRecursive(lights, mid, end);
+    m_nodes[nodeIdx] = node;
+
+    return nodeIdx;
+}
+
+float LightTree::importance(const Node& node, const vec3& point) const
+{
+    float d = node.bounds.distance(point);
+    float falloff = node.attenuation.x + node.attenuation.y * d + node.attenuation.z * d * d;
+    float bound = node.power / std::max(falloff, std::numeric_limits<float>::min());
+    return bound >= CULL_THRESHOLD ? bound : 0.f;
+}
+
+bool LightTree::sample(const vec3& point, float u, uint32_t& index, float& pdf) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    pdf = 1.f;
+    uint32_t nodeIdx = 0;
+    while (!m_nodes[nodeIdx].isLeaf)
+    {
+        uint32_t left = nodeIdx + 1;
+        uint32_t right = m_nodes[nodeIdx].offset;
+        float leftImportance = importance(m_nodes[left], point);
+        float rightImportance = importance(m_nodes[right], point);
+        float total = leftImportance + rightImportance;
+        if (total <= 0)
+        {
+            return false;
+        }
+
+        // u is rescaled to stay uniform within the chosen child
+        float pLeft = leftImportance / total;
+        if (u < pLeft)
+        {
+            u = std::min(u / pLeft, 1.f - std::numeric_limits<float>::epsilon());
+            pdf *= pLeft;
+            nodeIdx = left;
+        }
+        else
+        {
+            u = std::min((u - pLeft) / (1.f - pLeft), 1.f - std::numeric_limits<float>::epsilon());
+            pdf *= 1.f - pLeft;
+            nodeIdx = right;
+        }
+    }
+
+    if (importance(m_nodes[nodeIdx], point) <= 0)
+    {
+        return false;
+    }
+
+    index = m_nodes[nodeIdx].offset;
+    return true;
+}
+
+}
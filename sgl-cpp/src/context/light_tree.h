@@ -0,0 +1,63 @@
+#pragma once
+
+#include "math/aabb.h"
+#include "math/vector.h"
+#include "context/light.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace sgl
+{
+
+// Binary hierarchy over the area lights of a scene. A light is picked by descending from the root,
+// choosing each child with probability proportional to its importance at the shading point: the
+// power of the subtree attenuated by the smallest distance and coefficients found in it. Subtrees
+// whose importance falls below CULL_THRESHOLD are never picked, so the cost of a sample grows with
+// the depth of the tree rather than with the number of lights.
+class LightTree
+{
+public:
+    // Bound on the attenuated power below which a subtree contributes nothing visible
+    static constexpr float CULL_THRESHOLD = 1e-4f;
+
+    LightTree() = default;
+
+    // Builds the tree over lights, indices are reported back by sample
+    void build(const std::vector<const AreaLight*>& lights, const std::vector<uint32_t>& indices);
+    void clear();
+    bool isEmpty() const;
+
+    // Picks a light for the point with u uniform in [0, 1). Returns false when every light is culled,
+    // otherwise sets the index of the light and the probability it was picked with.
+    bool sample(const vec3& point, float u, uint32_t& index, float& pdf) const;
+
+private:
+    struct Node
+    {
+        AABB bounds;
+        float power;
+        // Smallest attenuation coefficients in the subtree
+        vec3 attenuation;
+        // Light index for leaves, index of the second child for inner nodes
+        // (the first child always directly follows its parent)
+        uint32_t offset;
+        bool isLeaf;
+    };
+
+    struct BuildLight
+    {
+        AABB bounds;
+        vec3 centroid;
+        float power;
+        vec3 attenuation;
+        uint32_t index;
+    };
+
+    uint32_t buildRecursive(std::vector<BuildLight>& lights, uint32_t begin, uint32_t end);
+    float importance(const Node& node, const vec3& point) const;
+
+    std::vector<Node> m_nodes;
+};
+
+}
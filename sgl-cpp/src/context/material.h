@@ -1,7 +1,9 @@
 #pragma once
 
 #include "math/vector.h"
+#include "texture.h"
 #include <cstdint>
+#include <memory>
 #include <string>
 
 namespace sgl 
@@ -13,7 +15,8 @@ struct Material
 
     Material(const vec3& color, float kd, float ks, float shine, float T, float ior);
 
-    virtual vec3 getColor(const vec2& texCoord = vec2()) const;
+    // footprint is the width of the surface area seen by the lookup in texture coordinates
+    virtual vec3 getColor(const vec2& texCoord = vec2(), float footprint = 0) const;
     virtual bool isEmissive() const;
     virtual ~Material() = default;
 
@@ -41,17 +44,12 @@ struct TexturedMaterial : public Material
 {
     TexturedMaterial(const std::string& texturePath, const float kd, const float ks, const float shine, const float T, const float ior);
 
-    ~TexturedMaterial();
-
-    virtual vec3 getColor(const vec2& texCoord = vec2()) const override;
+    virtual vec3 getColor(const vec2& texCoord = vec2(), float footprint = 0) const override;
 
 private:
     std::string m_texturePath;
-    unsigned char* m_textureData;
-
-    int m_textureWidth;
-    int m_textureHeight;
-    int m_textureChannels;
+    // Shared with every material using the same image through the TextureCache
+    std::shared_ptr<const Texture> m_texture;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "mesh.h"
+
+#include "math/utils.h"
+
+#include <cmath>
+
+namespace sgl
+{
+
+void Mesh::addPrimitive(std::shared_ptr<Primitive> primitive)
+{
+    m_primitives.push_back(std::move(primitive));
+}
+
+void Mesh::clearPrimitives()
+{
+    m_primitives.clear();
+}
+
+void Mesh::build(Bvh::Builder builder, ThreadPool* threadPool)
+{
+    std::vector<AABB> primitiveBounds(m_primitives.size());
+    m_bounds = AABB();
+    for (size_t i = 0; i < m_primitives.size(); ++i)
+    {
+        primitiveBounds[i] = m_primitives[i]->getBounds();
+        m_bounds.extend(primitiveBounds[i]);
+    }
+
+    const bool refitted = !m_bvh.isEmpty() && m_bvh.getPrimitiveCount() == m_primitives.size() && m_bvh.refit(primitiveBounds);
+    if (!refitted)
+    {
+        m_bvh.build(primitiveBounds, builder, threadPool);
+    }
+    // A refitted hierarchy keeps its leaf order, the primitive data laid out in it is refreshed
+    m_geometry.build(m_primitives, m_bvh);
+}
+
+const std::vector<std::shared_ptr<Primitive>>& Mesh::getPrimitives() const
+{
+    return m_primitives;
+}
+
+const Bvh& Mesh::getBvh() const
+{
+    return m_bvh;
+}
+
+const SceneGeometry& Mesh::getGeometry() const
+{
+    return m_geometry;
+}
+
+const AABB& Mesh::getBounds() const
+{
+    return m_bounds;
+}
+
+Instance::Instance(std::shared_ptr<const Mesh> mesh, const mat4& toWorld)
+    : mesh(std::move(mesh))
+{
+    setTransform(toWorld);
+}
+
+void Instance::setTransform(const mat4& toWorld)
+{
+    this->toWorld = toWorld;
+    toObject = toWorld.inverse();
+    const vec3 x = toObject * vec4(1, 0, 0, 0);
+    const vec3 y = toObject * vec4(0, 1, 0, 0);
+    const vec3 z = toObject * vec4(0, 0, 1, 0);
+    scale = std::cbrt(std::fabs(math::dotProduct(x, math::crossProduct(y, z))));
+}
+
+AABB Instance::getBounds() const
+{
+    const AABB& bounds = mesh->getBounds();
+    AABB worldBounds;
+    if (bounds.isEmpty())
+    {
+        return worldBounds;
+    }
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const vec3 point((corner & 1 ? bounds.max : bounds.min).x, (corner & 2 ? bounds.max : bounds.min).y, (corner & 4 ? bounds.max : bounds.min).z);
+        worldBounds.extend(vec3(toWorld * vec4(point, 1)));
+    }
+    return worldBounds;
+}
+
+Ray Instance::rayToObject(const Ray& ray, float& distanceScale) const
+{
+    const vec3 dir = toObject * vec4(ray.dir, 0);
+    distanceScale = math::length(dir);
+    return Ray(vec3(toObject * vec4(ray.origin, 1)), dir / distanceScale, ray.type);
+}
+
+vec3 Instance::normalToWorld(const vec3& normal) const
+{
+    // Normals transform by the inverse transpose, which keeps them perpendicular under non-uniform scaling
+    return math::normalize(vec3(toObject.transpose() * vec4(normal, 0)));
+}
+
+}
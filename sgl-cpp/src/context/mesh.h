@@ -0,0 +1,72 @@
+#pragma once
+
+#include "bvh.h"
+#include "primitive.h"
+#include "ray.h"
+#include "scene_geometry.h"
+#include "math/aabb.h"
+#include "math/matrix.h"
+#include "math/vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sgl
+{
+
+class ThreadPool;
+
+// Geometry submitted once and placed into scenes any number of times through instances. Its
+// primitives stay in object space together with their own hierarchy, the bottom level of the
+// two-level acceleration structure.
+class Mesh
+{
+public:
+    Mesh() = default;
+
+    void addPrimitive(std::shared_ptr<Primitive> primitive);
+    // Removes all primitives so that the mesh can be specified again, its hierarchy is kept
+    void clearPrimitives();
+    // Builds the hierarchy once all primitives were added. When the mesh was specified again with
+    // as many primitives the hierarchy is only refitted, unless that made it too expensive
+    void build(Bvh::Builder builder, ThreadPool* threadPool);
+
+    const std::vector<std::shared_ptr<Primitive>>& getPrimitives() const;
+    const Bvh& getBvh() const;
+    const SceneGeometry& getGeometry() const;
+    const AABB& getBounds() const;
+
+private:
+    std::vector<std::shared_ptr<Primitive>> m_primitives;
+    Bvh m_bvh;
+    SceneGeometry m_geometry;
+    AABB m_bounds;
+};
+
+// Mesh placed into a scene by an object to world transform, the top level of the acceleration
+// structure is built over the world bounds of instances
+struct Instance
+{
+    Instance(std::shared_ptr<const Mesh> mesh, const mat4& toWorld);
+
+    void setTransform(const mat4& toWorld);
+
+    AABB getBounds() const;
+    // Ray with a normalized direction transformed to object space, distances along it are
+    // distanceScale times the world space ones
+    Ray rayToObject(const Ray& ray, float& distanceScale) const;
+    // Surface normal given in object space transformed to world space
+    vec3 normalToWorld(const vec3& normal) const;
+
+    std::shared_ptr<const Mesh> mesh;
+    mat4 toWorld;
+    mat4 toObject;
+    // Object space length of a unit of world space length, averaged over directions
+    float scale;
+    // Area lights of the emissive triangles of the mesh are the scene lights [firstLight, firstLight + lightCount)
+    uint32_t firstLight = 0;
+    uint32_t lightCount = 0;
+};
+
+}
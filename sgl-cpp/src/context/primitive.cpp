@@ -46,11 +46,9 @@ Triangle::Triangle(std::shared_ptr<Material> material, const vec3& v0, const vec
 
 std::tuple<bool, vec3, float> Triangle::intersect(const Ray& ray) const
 {
-	const vec3 p1 = m_vertices[0];
-	const vec3 p2 = m_vertices[1];
-	const vec3 p3 = m_vertices[2];
-	vec3 e1 = p2 - p1;
-	vec3 e2 = p3 - p1;
+	const vec3& p1 = m_vertices[0];
+	const vec3& e1 = m_v0v1;
+	const vec3& e2 = m_v0v2;
 	vec3 s1 = sgl::math::crossProduct(ray.dir, e2);
 	float divisor = sgl::math::dotProduct(s1, e1);
 	if (divisor == 0.)
@@ -92,6 +90,11 @@ void Triangle::applyTransform(const mat4& matrix)
     {
         vertex = matrix * vec4(vertex, 1);
     }
+	m_normal = math::normalize(math::crossProduct(m_vertices[1] - m_vertices[0], m_vertices[2] - m_vertices[0]));
+	m_v0v1 = m_vertices[1] - m_vertices[0];
+	m_v0v2 = m_vertices[2] - m_vertices[0];
+	m_v1v2 = m_vertices[2] - m_vertices[1];
+	m_v2v0 = m_vertices[0] - m_vertices[2];
 }
 
 vec2 Triangle::getTextureCoords(const vec3& point) const 
@@ -119,6 +122,37 @@ vec2 Triangle::getTextureCoords(const vec3& point) const
 	return texCoord;
 }
 
+float Triangle::getTextureScale() const
+{
+	float textureArea = 0.5f * math::length(math::crossProduct(m_textureCoords[1] - m_textureCoords[0], m_textureCoords[2] - m_textureCoords[0]));
+	return m_area > 0 ? std::sqrt(textureArea / m_area) : 0.f;
+}
+
+const vec3& Triangle::getVertex(int i) const
+{
+	return m_vertices[i];
+}
+
+const vec3& Triangle::getEdge1() const
+{
+	return m_v0v1;
+}
+
+const vec3& Triangle::getEdge2() const
+{
+	return m_v0v2;
+}
+
+AABB Triangle::getBounds() const
+{
+	AABB bounds;
+	for (const vec3& vertex : m_vertices)
+	{
+		bounds.extend(vertex);
+	}
+	return bounds;
+}
+
 
 // Sphere
 Sphere::Sphere(std::shared_ptr<Material> material, const vec3& center, float radius)
@@ -170,6 +204,27 @@ vec2 Sphere::getTextureCoords(const vec3& point) const
     return vec2(u, v);
 }
 
+float Sphere::getTextureScale() const
+{
+	// The whole texture is wrapped over the surface of the sphere
+	return 1 / std::sqrt(4 * M_PI * m_radius * m_radius);
+}
+
+const vec3& Sphere::getCenter() const
+{
+	return m_center;
+}
+
+float Sphere::getRadius() const
+{
+	return m_radius;
+}
+
+AABB Sphere::getBounds() const
+{
+	return AABB(m_center - m_radius, m_center + m_radius);
+}
+
 const Material& Primitive::getMaterial() const 
 {
     return *m_material;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "material.h"
+#include "math/aabb.h"
 #include "math/vector.h"
 #include "context/ray.h"
 #include "math/matrix.h"
@@ -32,6 +33,9 @@ public:
     virtual vec3 getNormal(const vec3& point) const = 0;
     virtual void applyTransform(const mat4& matrix) = 0;
     virtual vec2 getTextureCoords(const vec3& point) const = 0;
+    // Texture coordinates spanned per unit of length on the surface
+    virtual float getTextureScale() const = 0;
+    virtual AABB getBounds() const = 0;
 
     const Material& getMaterial() const;
 
@@ -72,6 +76,13 @@ public:
     virtual vec3 getNormal(const vec3& point) const override;
     virtual void applyTransform(const mat4& matrix) override;
     virtual vec2 getTextureCoords(const vec3& point) const override;
+    virtual float getTextureScale() const override;
+    virtual AABB getBounds() const override;
+
+    const vec3& getVertex(int i) const;
+    // Edges from the first vertex to the second and to the third one
+    const vec3& getEdge1() const;
+    const vec3& getEdge2() const;
 
 private:
     std::array<vec3, 3> m_vertices;
@@ -98,6 +109,11 @@ public:
     virtual vec3 getNormal(const vec3& point) const override;
     virtual void applyTransform(const mat4& matrix) override;
     virtual vec2 getTextureCoords(const vec3& point) const override;
+    virtual float getTextureScale() const override;
+    virtual AABB getBounds() const override;
+
+    const vec3& getCenter() const;
+    float getRadius() const;
 
 private:
     vec3 m_center;
@@ -0,0 +1,74 @@
+#include "raster_bins.h"
+
+#include <algorithm>
+
+namespace sgl
+{
+
+bool RasterBins::add(const std::vector<vec4>& vertices, const vec3& color, bool depthTest, int width, int height)
+{
+    if (!m_checker.canFill(vertices.data(), vertices.size(), width, height))
+    {
+        return false;
+    }
+
+    // Rows a polygon covers are the ones from its lowest to its highest vertex
+    float minY = vertices.front().y;
+    float maxY = vertices.front().y;
+    for (const vec4& v : vertices)
+    {
+        minY = std::min(minY, v.y);
+        maxY = std::max(maxY, v.y);
+    }
+    const int firstRow = std::max(static_cast<int>(minY), 0);
+    const int lastRow = std::min(static_cast<int>(maxY), height);
+    if (firstRow >= lastRow)
+    {
+        return true;
+    }
+
+    const uint32_t polygonIdx = static_cast<uint32_t>(m_polygons.size());
+    m_polygons.push_back({ static_cast<uint32_t>(m_vertices.size()), static_cast<uint32_t>(vertices.size()), color, depthTest });
+    m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+
+    m_bins.resize((height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+    for (int tile = firstRow / TILE_HEIGHT; tile <= (lastRow - 1) / TILE_HEIGHT; ++tile)
+    {
+        m_bins[tile].push_back(polygonIdx);
+    }
+    return true;
+}
+
+bool RasterBins::isEmpty() const
+{
+    return m_polygons.empty();
+}
+
+void RasterBins::flush(ThreadPool& threadPool, vec3* colorBuffer, float* depthBuffer, HierarchicalZ* hierarchicalZ, int width, int height)
+{
+    if (isEmpty())
+    {
+        return;
+    }
+
+    m_rasterizers.resize(threadPool.getThreadCount());
+    threadPool.parallelFor(static_cast<uint32_t>(m_bins.size()), [&](uint32_t tile, uint32_t threadIdx) {
+        Rasterizer& rasterizer = m_rasterizers[threadIdx];
+        const int firstRow = tile * TILE_HEIGHT;
+        for (uint32_t polygonIdx : m_bins[tile])
+        {
+            const Polygon& polygon = m_polygons[polygonIdx];
+            rasterizer.fill(m_vertices.data() + polygon.firstVertex, polygon.vertexCount, polygon.color, colorBuffer,
+                            polygon.depthTest ? depthBuffer : nullptr, hierarchicalZ, width, height, firstRow, firstRow + TILE_HEIGHT);
+        }
+    });
+
+    m_vertices.clear();
+    m_polygons.clear();
+    for (std::vector<uint32_t>& bin : m_bins)
+    {
+        bin.clear();
+    }
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "math/vector.h"
+#include "rasterizer.h"
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace sgl
+{
+
+// Filled polygons deferred to be rasterized by tiles in parallel. A tile is a band of rows spanning
+// the whole width of the buffer, so spans are never cut and depth steps along them as it does when
+// a polygon is drawn at once. Polygons are binned into the tiles their rows overlap and every tile
+// rasterizes its own in the order they were added, which leaves the buffers as drawing each of them
+// right away would.
+class RasterBins
+{
+public:
+    // Rows of a tile, a multiple of the rows the rasterizer solves together
+    static constexpr int TILE_HEIGHT = 4 * Rasterizer::BLOCK_SIZE;
+
+    RasterBins() = default;
+
+    // Defers the polygon, in the color and with the depth test it is drawn with. Returns false for
+    // polygons the rasterizer leaves to the scanline fill, which have to be drawn right away
+    bool add(const std::vector<vec4>& vertices, const vec3& color, bool depthTest, int width, int height);
+    bool isEmpty() const;
+    // Rasterizes the deferred polygons into the buffers, a tile per task of the pool, and forgets them.
+    // A tile only reads and writes the hierarchical Z of its own rows.
+    void flush(ThreadPool& threadPool, vec3* colorBuffer, float* depthBuffer, HierarchicalZ* hierarchicalZ, int width, int height);
+
+private:
+    struct Polygon
+    {
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+        vec3 color;
+        bool depthTest;
+    };
+
+    std::vector<vec4> m_vertices;
+    std::vector<Polygon> m_polygons;
+    // Indices into m_polygons of every tile, in the order they were added
+    std::vector<std::vector<uint32_t>> m_bins;
+    // Checks polygons as they are added, the others rasterize the tiles of one thread each
+    Rasterizer m_checker;
+    std::vector<Rasterizer> m_rasterizers;
+};
+
+}
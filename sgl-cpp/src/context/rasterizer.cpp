@@ -0,0 +1,482 @@
+#include "rasterizer.h"
+
+#include "math/simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sgl
+{
+
+namespace
+{
+
+// Larger fixed point steps only come with pieces of a single row, which never step
+constexpr double MAX_STEP = double(int64_t(1) << 40);
+
+int sign(double value)
+{
+    return (value > 0) - (value < 0);
+}
+
+int64_t floorDivide(int64_t value, int64_t divisor)
+{
+    const int64_t quotient = value / divisor;
+    return quotient - (value % divisor != 0 && value < 0);
+}
+
+}
+
+bool Rasterizer::canFill(const vec4* vertices, size_t count, int width, int height)
+{
+    return preparePoints(vertices, count, width, height) != 0;
+}
+
+template <typename T>
+bool Rasterizer::fill(const vec4* vertices, size_t count, const T& value, T* buffer, float* depthBuffer, HierarchicalZ* hierarchicalZ,
+                      int width, int height, int firstRow, int lastRow)
+{
+    const int turn = preparePoints(vertices, count, width, height);
+    if (turn == 0)
+    {
+        return false;
+    }
+    setupRows(height, firstRow, lastRow);
+    if (!depthBuffer)
+    {
+        hierarchicalZ = nullptr;
+    }
+    const float error = hierarchicalZ ? depthError(width) : 0.f;
+    // Polygons within less than a tile test depth on their pixels for less than the tiles cost to test,
+    // they only keep the tiles up to date
+    const bool isTested = hierarchicalZ && (m_max.x - m_min.x) * (m_max.y - m_min.y) >= BLOCK_SIZE * BLOCK_SIZE;
+    if (isTested && isOccluded(*hierarchicalZ, depthBuffer, width, error))
+    {
+        return true;
+    }
+    setupEdges(turn, depthBuffer != nullptr);
+
+    // Rows are solved a block row at a time, the pixels a row covers are next to each other
+    RowCoverage coverage;
+    for (int blockY = m_rowStart & ~(BLOCK_SIZE - 1); blockY < m_rowEnd; blockY += BLOCK_SIZE)
+    {
+        const int y = std::max(blockY, m_rowStart);
+        const int rows = std::min(blockY + BLOCK_SIZE, m_rowEnd) - y;
+        coverRows(y, rows, width, coverage);
+        if (!depthBuffer)
+        {
+            for (int r = 0; r < rows; ++r)
+            {
+                if (coverage.start[r] < coverage.end[r])
+                {
+                    T* row = buffer + (y + r) * width;
+                    std::fill(row + coverage.start[r], row + coverage.end[r], value);
+                }
+            }
+            continue;
+        }
+
+        // Columns and depths of the rows with a span, which are the ones writing depth
+        int start = width;
+        int end = 0;
+        float minZ = std::numeric_limits<float>::infinity();
+        float maxZ = -std::numeric_limits<float>::infinity();
+        for (int r = 0; r < rows; ++r)
+        {
+            const Span& span = m_spans[y + r - m_rowStart];
+            if (coverage.start[r] < coverage.end[r] && span.crossings == 2)
+            {
+                start = std::min(start, coverage.start[r]);
+                end = std::max(end, coverage.end[r]);
+                minZ = std::min(minZ, std::min(span.z[0], span.z[1]));
+                maxZ = std::max(maxZ, std::max(span.z[0], span.z[1]));
+            }
+        }
+        if (start >= end)
+        {
+            continue;
+        }
+
+        // Blocks no row covers are rejected, the others are rejected or written without testing depth
+        // by the tile they lie in
+        const int firstBlock = start / BLOCK_SIZE;
+        m_blockDepths.assign((end - 1) / BLOCK_SIZE + 1 - firstBlock, BlockDepth::HIDDEN);
+        bool isWritten = false;
+        for (size_t b = 0; b < m_blockDepths.size(); ++b)
+        {
+            const int blockStart = std::max(start, (firstBlock + static_cast<int>(b)) * BLOCK_SIZE);
+            const int blockEnd = std::min(end, (firstBlock + static_cast<int>(b) + 1) * BLOCK_SIZE);
+            bool isCovered = false;
+            for (int r = 0; r < rows && !isCovered; ++r)
+            {
+                isCovered = std::max(coverage.start[r], blockStart) < std::min(coverage.end[r], blockEnd);
+            }
+            if (!isCovered || (isTested && hierarchicalZ->isOccluded(blockStart, y, blockEnd, y + rows, minZ - error, depthBuffer)))
+            {
+                continue;
+            }
+            const bool isVisible = isTested && hierarchicalZ->isVisible(blockStart, y, blockEnd, y + rows, maxZ + error);
+            m_blockDepths[b] = isVisible ? BlockDepth::VISIBLE : BlockDepth::TESTED;
+            if (hierarchicalZ)
+            {
+                hierarchicalZ->writeTiles(blockStart, y, blockEnd, y + rows, minZ - error);
+            }
+            isWritten = true;
+        }
+        if (!isWritten)
+        {
+            continue;
+        }
+        for (int r = 0; r < rows; ++r)
+        {
+            if (coverage.start[r] < coverage.end[r])
+            {
+                writeRowDepth(coverage.start[r], coverage.end[r], y + r, firstBlock, value, buffer, depthBuffer, width);
+            }
+        }
+    }
+    return true;
+}
+
+int Rasterizer::preparePoints(const vec4* vertices, size_t count, int width, int height)
+{
+    if (width > MAX_COORDINATE || height > MAX_COORDINATE)
+    {
+        return 0;
+    }
+
+    m_points.clear();
+    m_min = vec3(MAX_COORDINATE, MAX_COORDINATE, std::numeric_limits<float>::infinity());
+    m_max = vec3(-MAX_COORDINATE, -MAX_COORDINATE, -std::numeric_limits<float>::infinity());
+    for (const vec4* v = vertices; v != vertices + count; ++v)
+    {
+        if (!(std::abs(v->x) <= MAX_COORDINATE && std::abs(v->y) <= MAX_COORDINATE))
+        {
+            return 0;
+        }
+        m_min.x = std::min(m_min.x, v->x);
+        m_min.y = std::min(m_min.y, v->y);
+        m_min.z = std::min(m_min.z, v->z);
+        m_max.x = std::max(m_max.x, v->x);
+        m_max.y = std::max(m_max.y, v->y);
+        m_max.z = std::max(m_max.z, v->z);
+
+        const vec3 point(*v);
+        if (m_points.empty() || point.x != m_points.back().x || point.y != m_points.back().y)
+        {
+            m_points.push_back(point);
+        }
+    }
+    while (m_points.size() > 1 && m_points.back().x == m_points.front().x && m_points.back().y == m_points.front().y)
+    {
+        m_points.pop_back();
+    }
+    return convexTurn();
+}
+
+void Rasterizer::setupRows(int height, int firstRow, int lastRow)
+{
+    m_rowStart = std::max(static_cast<int>(m_min.y), std::max(firstRow, 0));
+    m_rowEnd = std::min(static_cast<int>(m_max.y), std::min(lastRow, height));
+    // Polygons past the last row cover none
+    m_rowEnd = std::max(m_rowEnd, m_rowStart);
+}
+
+float Rasterizer::depthError(int width) const
+{
+    // Each step rounds by at most half an ulp of the largest depth reached, and the slopes stepped by
+    // are rounded relative to the depth difference, accumulated over the steps of an edge and a span
+    const float steps = (m_max.y - m_min.y) + std::min(m_max.x - m_min.x, static_cast<float>(width)) + 2;
+    const float magnitude = std::max(std::abs(m_min.z), std::abs(m_max.z)) + (m_max.z - m_min.z);
+    return std::ldexp(steps * magnitude, -22);
+}
+
+bool Rasterizer::isOccluded(HierarchicalZ& hierarchicalZ, const float* depthBuffer, int width, float error) const
+{
+    // Columns covered stay within a pixel of the vertices
+    const int start = std::max(static_cast<int>(std::floor(m_min.x)) - 1, 0);
+    const int end = std::min(static_cast<int>(std::ceil(m_max.x)) + 1, width);
+    if (m_rowStart >= m_rowEnd || start >= end)
+    {
+        return false;
+    }
+    return hierarchicalZ.isOccluded(start, m_rowStart, end, m_rowEnd, m_min.z - error, depthBuffer);
+}
+
+void Rasterizer::setupEdges(int turn, bool hasDepth)
+{
+    if (hasDepth)
+    {
+        m_spans.assign(m_rowEnd - m_rowStart, Span{});
+    }
+
+    // Edges crossing rows, the interior lies to the right of an edge going up a polygon turning left
+    m_edges.clear();
+    for (size_t i = 0; i < m_points.size(); ++i)
+    {
+        const vec3& from = m_points[i];
+        const vec3& to = m_points[(i + 1) % m_points.size()];
+        if (static_cast<int>(from.y) == static_cast<int>(to.y))
+        {
+            continue;
+        }
+        const bool isUp = from.y < to.y;
+        const bool isLeft = isUp != (turn > 0);
+        if (isUp)
+        {
+            addEdge(from, to, isLeft, hasDepth);
+        }
+        else
+        {
+            addEdge(to, from, isLeft, hasDepth);
+        }
+    }
+
+    // The edge function is positive from the first pixel past the crossing, for a left edge it is
+    // a * (x + 1) minus the scaled x of the edge and for a right edge the scaled x minus a * x.
+    // Crossings are stepped row by row from the first row in the buffer as a quotient and a remainder.
+    for (Edge& edge : m_edges)
+    {
+        const int64_t one = std::abs(edge.a);
+        const int64_t value = edge.c + edge.b * (std::max(edge.rowStart, m_rowStart) - edge.rowStart);
+        const int64_t scaledX = edge.a > 0 ? edge.a - value : -value;
+        edge.crossing = floorDivide(scaledX, one);
+        edge.remainder = scaledX - edge.crossing * one;
+        edge.crossingStep = floorDivide(-edge.b, one);
+        edge.remainderStep = -edge.b - edge.crossingStep * one;
+    }
+}
+
+int Rasterizer::convexTurn() const
+{
+    // Convex when every corner turns the same way and the outline goes up and down only once
+    const size_t count = m_points.size();
+    if (count < 3)
+    {
+        return 0;
+    }
+
+    int turn = 0;
+    int firstDirection = 0;
+    int direction = 0;
+    int directionChanges = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const vec3& a = m_points[i];
+        const vec3& b = m_points[(i + 1) % count];
+        const vec3& c = m_points[(i + 2) % count];
+        const double cross = (double(b.x) - a.x) * (double(c.y) - b.y) - (double(b.y) - a.y) * (double(c.x) - b.x);
+        if (cross == 0)
+        {
+            if ((double(b.x) - a.x) * (double(c.x) - b.x) + (double(b.y) - a.y) * (double(c.y) - b.y) < 0)
+            {
+                return 0;
+            }
+        }
+        else if (turn == 0)
+        {
+            turn = sign(cross);
+        }
+        else if (turn != sign(cross))
+        {
+            return 0;
+        }
+
+        const int edgeDirection = sign(b.y - a.y);
+        if (edgeDirection != 0)
+        {
+            if (direction != 0 && edgeDirection != direction)
+            {
+                ++directionChanges;
+            }
+            if (firstDirection == 0)
+            {
+                firstDirection = edgeDirection;
+            }
+            direction = edgeDirection;
+        }
+    }
+    directionChanges += direction != firstDirection;
+    return directionChanges == 2 ? turn : 0;
+}
+
+void Rasterizer::addEdge(const vec3& lower, const vec3& upper, bool isLeft, bool hasDepth)
+{
+    // Stepped row by row as the scanline fill does. While x keeps its exponent, each step adds the
+    // slope rounded to the precision of x, which is exact in fixed point with that many fractional bits.
+    const float inverseSlope = (upper.x - lower.x) / (upper.y - lower.y);
+    const float zSlope = (upper.z - lower.z) / (upper.y - lower.y);
+    const int rowEnd = std::min(static_cast<int>(upper.y), m_rowEnd);
+    const int rowStart = static_cast<int>(lower.y);
+    float x = lower.x;
+    float z = lower.z;
+    // Magnitudes [low, high) of the exponent, which frexp gives to 0 as well when it is 0
+    int exponent = 0;
+    float low = 0;
+    float high = 0;
+    bool isStepping = false;
+    for (int y = rowStart; y < rowEnd; ++y, x += inverseSlope, z += zSlope)
+    {
+        const float magnitude = std::abs(x);
+        const bool hasExponent = (magnitude >= low && magnitude < high) || (magnitude == 0 && exponent == 0);
+        if (!isStepping || !hasExponent)
+        {
+            std::frexp(x, &exponent);
+            low = std::ldexp(0.5f, exponent);
+            high = std::ldexp(1.f, exponent);
+            const double one = std::ldexp(1.0, std::min(24 - exponent, 32));
+            const int64_t fixedOne = static_cast<int64_t>(one);
+            const int64_t start = std::llround(x * one);
+            const double slope = std::clamp(inverseSlope * one, -MAX_STEP, MAX_STEP);
+            int64_t step = std::llround(slope);
+            isStepping = true;
+            if (slope - std::floor(slope) == 0.5)
+            {
+                // Halfway steps round to the even x, which the second step starts from at the latest
+                step = static_cast<int64_t>(std::floor(slope));
+                step += step & 1;
+                isStepping = (start & 1) == 0;
+            }
+            if (isLeft)
+            {
+                // x of the edge < x + 1
+                m_edges.push_back({ fixedOne, -step, fixedOne - start, y, y, 0, 0, 0, 0 });
+            }
+            else
+            {
+                // x < x of the edge
+                m_edges.push_back({ -fixedOne, step, start, y, y, 0, 0, 0, 0 });
+            }
+        }
+        ++m_edges.back().rowEnd;
+
+        if (hasDepth && y >= m_rowStart)
+        {
+            Span& span = m_spans[y - m_rowStart];
+            if (span.crossings < 2)
+            {
+                span.x[span.crossings] = x;
+                span.z[span.crossings] = z;
+            }
+            ++span.crossings;
+        }
+    }
+}
+
+void Rasterizer::coverRows(int y, int rows, int width, RowCoverage& coverage)
+{
+    std::fill(coverage.start, coverage.start + rows, 0);
+    std::fill(coverage.end, coverage.end + rows, width);
+    for (Edge& edge : m_edges)
+    {
+        const int first = std::max(y, edge.rowStart);
+        const int last = std::min(y + rows, edge.rowEnd);
+        const int64_t one = std::abs(edge.a);
+        for (int r = first - y; r < last - y; ++r)
+        {
+            if (edge.a > 0)
+            {
+                coverage.start[r] = static_cast<int>(std::max<int64_t>(coverage.start[r], std::min<int64_t>(edge.crossing, width)));
+            }
+            else
+            {
+                coverage.end[r] = static_cast<int>(std::min<int64_t>(coverage.end[r], std::max<int64_t>(-edge.crossing, 0)));
+            }
+            edge.crossing += edge.crossingStep;
+            edge.remainder += edge.remainderStep;
+            if (edge.remainder >= one)
+            {
+                edge.remainder -= one;
+                ++edge.crossing;
+            }
+        }
+    }
+}
+
+template <typename T>
+void Rasterizer::writeRowDepth(int start, int end, int row, int firstBlock, const T& value, T* buffer, float* depthBuffer, int bufferWidth) const
+{
+    // The covered pixels of a row are the ones of its span, which starts from its left crossing
+    const Span& span = m_spans[row - m_rowStart];
+    if (span.crossings != 2)
+    {
+        return;
+    }
+    const int left = span.x[1] < span.x[0];
+    const float zStep = (span.z[1 - left] - span.z[left]) / (end - start);
+    float z = span.z[left];
+    float* depth = depthBuffer + row * bufferWidth;
+    T* values = buffer + row * bufferWidth;
+    for (int x = start; x < end;)
+    {
+        const int blockEnd = std::min(end, (x / BLOCK_SIZE + 1) * BLOCK_SIZE);
+        z = writeBlockDepth(x, blockEnd, z, zStep, m_blockDepths[x / BLOCK_SIZE - firstBlock], value, values, depth);
+        x = blockEnd;
+    }
+}
+
+template <typename T>
+float Rasterizer::writeBlockDepth(int start, int end, float z, float zStep, BlockDepth blockDepth, const T& value, T* values, float* depth)
+{
+    // Hidden blocks step over their depths, so that the ones after them are stepped to the same values
+    int x = start;
+    if (blockDepth == BlockDepth::HIDDEN)
+    {
+        for (; x < end; ++x)
+        {
+            z += zStep;
+        }
+        return z;
+    }
+    if (blockDepth == BlockDepth::VISIBLE)
+    {
+        // Same depths as the test below steps through
+        std::fill(values + start, values + end, value);
+        for (; x < end; ++x, z += zStep)
+        {
+            depth[x] = z;
+        }
+        return z;
+    }
+    for (; x + 4 <= end; x += 4)
+    {
+        const float z0 = z;
+        const float z1 = z0 + zStep;
+        const float z2 = z1 + zStep;
+        const float z3 = z2 + zStep;
+        z = z3 + zStep;
+        const float4 fragment(z0, z1, z2, z3);
+        const float4 stored = float4::load(depth + x);
+        const mask4 pass = fragment < stored;
+        const int passed = pass.bits();
+        if (!passed)
+        {
+            continue;
+        }
+        select(pass, fragment, stored).store(depth + x);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (passed & (1 << i))
+            {
+                values[x + i] = value;
+            }
+        }
+    }
+
+    // Pixels past the end of the block are not loaded
+    for (; x < end; ++x, z += zStep)
+    {
+        if (z < depth[x])
+        {
+            depth[x] = z;
+            values[x] = value;
+        }
+    }
+    return z;
+}
+
+template bool Rasterizer::fill(const vec4*, size_t, const vec3&, vec3*, float*, HierarchicalZ*, int, int, int, int);
+template bool Rasterizer::fill(const vec4*, size_t, const uint32_t&, uint32_t*, float*, HierarchicalZ*, int, int, int, int);
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "hierarchical_z.h"
+#include "math/vector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace sgl
+{
+
+// Fills convex polygons with the coverage of the scanline fill, solving the edge functions in fixed
+// point for the columns each row covers, a block row of 8 at a time. Each 8x8 block of a block row is
+// rejected or written without testing depth on its own by the hierarchical Z. Edges are stepped with
+// the precision floats have at their x, so that they cross each row where the scanline fill does.
+class Rasterizer
+{
+public:
+    // Rows solved together, one block row
+    static constexpr int BLOCK_SIZE = 8;
+    static_assert(BLOCK_SIZE == HierarchicalZ::TILE_SIZE, "Block rows are tile rows of the hierarchical Z");
+    // Largest coordinate, and buffer size, whose edge functions fit in 64 bits
+    static constexpr float MAX_COORDINATE = 1048576.f;
+
+    Rasterizer() = default;
+
+    // Fills the rows [firstRow, lastRow) of the polygon in the buffers with value, a color or an id of
+    // what covers the pixels, testing and writing depth when depthBuffer is given, and keeping
+    // hierarchicalZ up to date with it when that is given too. Returns false and draws nothing when the
+    // polygon is not convex, has no area or lies beyond MAX_COORDINATE, such polygons are left to the
+    // scanline fill. Instantiated for vec3 and uint32_t values.
+    template <typename T>
+    bool fill(const vec4* vertices, size_t count, const T& value, T* buffer, float* depthBuffer, HierarchicalZ* hierarchicalZ,
+              int width, int height, int firstRow, int lastRow);
+    // Whether fill draws the polygon rather than returning false
+    bool canFill(const vec4* vertices, size_t count, int width, int height);
+
+private:
+    // Pixel (x, y) is inside the edge when a * x + b * (y - rowStart) + c > 0, on the rows [rowStart, rowEnd).
+    // The column the edge crosses on the next row to cover is crossing plus remainder / |a|.
+    struct Edge
+    {
+        int64_t a;
+        int64_t b;
+        int64_t c;
+        int rowStart;
+        int rowEnd;
+        int64_t crossing;
+        int64_t remainder;
+        int64_t crossingStep;
+        int64_t remainderStep;
+    };
+
+    // Edges crossing a row, depth is stepped pixel by pixel from the left one
+    struct Span
+    {
+        float x[2];
+        float z[2];
+        int crossings;
+    };
+
+    // What a block of a block row writes: nothing, its pixels untested, or the ones passing the depth test
+    enum class BlockDepth : uint8_t
+    {
+        HIDDEN,
+        VISIBLE,
+        TESTED
+    };
+
+    // Columns [start, end) covered by each row of a block row
+    struct RowCoverage
+    {
+        int start[BLOCK_SIZE];
+        int end[BLOCK_SIZE];
+    };
+
+    // Keeps the distinct points of the polygon and its bounds, returns the direction its corners turn
+    // to or 0 when it is not filled
+    int preparePoints(const vec4* vertices, size_t count, int width, int height);
+    // Rows [m_rowStart, m_rowEnd) of the polygon within [firstRow, lastRow)
+    void setupRows(int height, int firstRow, int lastRow);
+    void setupEdges(int turn, bool hasDepth);
+    // Bound of the difference between the depths stepped along edges and spans and the depths of the
+    // vertices, as rounding accumulates over the steps
+    float depthError(int width) const;
+    // Whether the hierarchical Z rejects the whole polygon
+    bool isOccluded(HierarchicalZ& hierarchicalZ, const float* depthBuffer, int width, float error) const;
+    // Direction the corners of the polygon turn to, 0 when it is not convex or has no area
+    int convexTurn() const;
+    // Adds the pieces of the edge going up from lower to upper, and its crossings of the depth spans
+    void addEdge(const vec3& lower, const vec3& upper, bool isLeft, bool hasDepth);
+    // Solves the edge functions for the columns they cross on the rows [y, y + rows), which come from bottom to top
+    void coverRows(int y, int rows, int width, RowCoverage& coverage);
+    // Tests and writes the depth of the columns [start, end) of a row, stepping it along the span of the
+    // row, as m_blockDepths gives for the blocks from firstBlock on
+    template <typename T>
+    void writeRowDepth(int start, int end, int row, int firstBlock, const T& value, T* buffer, float* depthBuffer, int bufferWidth) const;
+    // Writes the columns [start, end) within a block from depth z on, returns the depth past them
+    template <typename T>
+    static float writeBlockDepth(int start, int end, float z, float zStep, BlockDepth blockDepth, const T& value, T* values, float* depth);
+
+    std::vector<vec3> m_points;
+    std::vector<Edge> m_edges;
+    std::vector<Span> m_spans;
+    std::vector<BlockDepth> m_blockDepths;
+    int m_rowStart = 0;
+    int m_rowEnd = 0;
+    // Bounds of the vertices
+    vec3 m_min;
+    vec3 m_max;
+};
+
+}
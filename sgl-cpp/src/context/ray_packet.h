@@ -0,0 +1,56 @@
+#pragma once
+
+#include "context/ray.h"
+#include "math/simd.h"
+
+#include <cassert>
+
+namespace sgl
+{
+
+    // Coherent rays traced together, one ray per SIMD lane
+    struct RayPacket
+    {
+        static constexpr int SIZE = 4;
+
+        // Packs count rays (at most SIZE) of the given type, directions are expected
+        // to be normalized and tMax holds the maximal hit distance of each ray
+        RayPacket(const vec3* origins, const vec3* dirs, const float* tMax, int count, Ray::Type type = Ray::Type::NORMAL)
+            : active((1 << count) - 1),
+              type(type)
+        {
+            assert(count > 0 && count <= SIZE);
+
+            float lanes[9][SIZE];
+            float distances[SIZE];
+            for (int lane = 0; lane < SIZE; ++lane)
+            {
+                // Unused lanes repeat the first ray so that they never produce NaNs
+                const int src = lane < count ? lane : 0;
+                for (int i = 0; i < 3; ++i)
+                {
+                    lanes[i][lane] = origins[src][i];
+                    lanes[3 + i][lane] = dirs[src][i];
+                    lanes[6 + i][lane] = 1.f / dirs[src][i];
+                }
+                distances[lane] = tMax[src];
+            }
+
+            origin = { float4::load(lanes[0]), float4::load(lanes[1]), float4::load(lanes[2]) };
+            dir = { float4::load(lanes[3]), float4::load(lanes[4]), float4::load(lanes[5]) };
+            invDir = { float4::load(lanes[6]), float4::load(lanes[7]), float4::load(lanes[8]) };
+            this->tMax = float4::load(distances);
+        }
+
+        mask4 activeMask() const { return mask4::fromBits(active); }
+
+        vec3x4 origin;
+        vec3x4 dir;
+        vec3x4 invDir;
+        float4 tMax;
+        // Bit i is set while lane i still needs to be traced
+        int active;
+        Ray::Type type;
+    };
+
+}
@@ -0,0 +1,262 @@
+#include "scene_geometry.h"
+
+#include "math/utils.h"
+
+namespace sgl
+{
+
+void SceneGeometry::build(const std::vector<std::shared_ptr<Primitive>>& primitives, const Bvh& bvh)
+{
+    clear();
+
+    m_primitiveIndices = bvh.getPrimitiveIndices();
+    m_positions.assign(primitives.size(), 0);
+    // Padding lets the last positions be loaded four at a time
+    const size_t size = m_primitiveIndices.size() + BvhNode::WIDTH - 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        m_vertex[i].assign(size, 0.f);
+        m_edge1[i].assign(size, 0.f);
+        m_edge2[i].assign(size, 0.f);
+        m_normal[i].assign(size, 0.f);
+        m_center[i].assign(size, 0.f);
+    }
+    m_radius.assign(size, 0.f);
+    m_flags.assign(size, 0);
+
+    for (size_t position = 0; position < m_primitiveIndices.size(); ++position)
+    {
+        m_positions[m_primitiveIndices[position]] = static_cast<uint32_t>(position);
+        const Primitive& primitive = *primitives[m_primitiveIndices[position]];
+        uint8_t flags = primitive.getMaterial().isEmissive() ? EMISSIVE : 0;
+
+        if (const Triangle* triangle = dynamic_cast<const Triangle*>(&primitive))
+        {
+            vec3 normal = triangle->getNormal(vec3());
+            for (int i = 0; i < 3; ++i)
+            {
+                m_vertex[i][position] = triangle->getVertex(0)[i];
+                m_edge1[i][position] = triangle->getEdge1()[i];
+                m_edge2[i][position] = triangle->getEdge2()[i];
+                m_normal[i][position] = normal[i];
+            }
+            flags |= TRIANGLE;
+        }
+        else if (const Sphere* sphere = dynamic_cast<const Sphere*>(&primitive))
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                m_center[i][position] = sphere->getCenter()[i];
+            }
+            m_radius[position] = sphere->getRadius();
+            flags |= SPHERE;
+        }
+        m_flags[position] = flags;
+    }
+}
+
+void SceneGeometry::clear()
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        m_vertex[i].clear();
+        m_edge1[i].clear();
+        m_edge2[i].clear();
+        m_normal[i].clear();
+        m_center[i].clear();
+    }
+    m_radius.clear();
+    m_flags.clear();
+    m_primitiveIndices.clear();
+    m_positions.clear();
+}
+
+uint32_t SceneGeometry::getPrimitiveIndex(uint32_t position) const
+{
+    return m_primitiveIndices[position];
+}
+
+uint32_t SceneGeometry::getPosition(uint32_t primitiveIdx) const
+{
+    return m_positions[primitiveIdx];
+}
+
+vec3x4 SceneGeometry::load(const std::vector<float> (&components)[3], uint32_t first)
+{
+    return { float4::load(&components[0][first]), float4::load(&components[1][first]), float4::load(&components[2][first]) };
+}
+
+vec3x4 SceneGeometry::broadcast(const std::vector<float> (&components)[3], uint32_t position)
+{
+    return { float4(components[0][position]), float4(components[1][position]), float4(components[2][position]) };
+}
+
+mask4 SceneGeometry::intersectTriangles(const vec3x4& p1, const vec3x4& e1, const vec3x4& e2, const vec3x4& normal, const vec3x4& origin, const vec3x4& dir, bool cullBackFaces, float4& t)
+{
+    const float4 zero(0.f);
+    const float4 one(1.f);
+
+    vec3x4 s1 = math::crossProduct(dir, e2);
+    float4 divisor = math::dotProduct(s1, e1);
+    float4 invDivisor = one / divisor;
+    vec3x4 d = origin - p1;
+    float4 b1 = math::dotProduct(d, s1) * invDivisor;
+
+    vec3x4 s2 = math::crossProduct(d, e1);
+    float4 b2 = math::dotProduct(dir, s2) * invDivisor;
+    t = math::dotProduct(e2, s2) * invDivisor;
+
+    mask4 hit = andNot(divisor != zero, (b1 < zero) | (b1 > one));
+    hit = andNot(hit, (b2 < zero) | (b1 + b2 > one));
+    hit = hit & (t > zero);
+    if (cullBackFaces)
+    {
+        hit = andNot(hit, math::dotProduct(dir, normal) > zero);
+    }
+    return hit;
+}
+
+mask4 SceneGeometry::intersectSpheres(const vec3x4& center, const float4& radius, const vec3x4& origin, const vec3x4& dir, bool cullBackFaces, float4& t)
+{
+    const float4 zero(0.f);
+
+    const vec3x4 dst = origin - center;
+    const float4 b = math::dotProduct(dst, dir);
+    const float4 c = math::dotProduct(dst, dst) - radius * radius;
+    const float4 d = b * b - c;
+
+    const float4 root = sqrt(d);
+    t = -b - root;
+    t = select(t < zero, -b + root, t);
+
+    mask4 hit = andNot(d > zero, t < zero);
+    if (cullBackFaces)
+    {
+        const vec3x4 v = (origin + dir * t) - center;
+        const vec3x4 normal = v / sqrt(math::dotProduct(v, v));
+        hit = andNot(hit, math::dotProduct(dir, normal) > zero);
+    }
+    return hit;
+}
+
+void SceneGeometry::classify(uint32_t first, uint32_t count, bool skipEmissive, int& triangles, int& spheres) const
+{
+    triangles = 0;
+    spheres = 0;
+    for (uint32_t lane = 0; lane < count; ++lane)
+    {
+        uint8_t flags = m_flags[first + lane];
+        if (skipEmissive && (flags & EMISSIVE))
+        {
+            continue;
+        }
+        triangles |= (flags & TRIANGLE) ? 1 << lane : 0;
+        spheres |= (flags & SPHERE) ? 1 << lane : 0;
+    }
+}
+
+int SceneGeometry::intersect(uint32_t first, uint32_t count, const vec3x4& origin, const vec3x4& dir, bool cullBackFaces, bool skipEmissive, vec3x4& point, float4& distance) const
+{
+    int triangles;
+    int spheres;
+    classify(first, count, skipEmissive, triangles, spheres);
+
+    int lanes = 0;
+    float4 t;
+    if (triangles)
+    {
+        lanes |= triangles & intersectTriangles(load(m_vertex, first), load(m_edge1, first), load(m_edge2, first), load(m_normal, first), origin, dir, cullBackFaces, t).bits();
+    }
+    if (spheres)
+    {
+        float4 sphereT;
+        lanes |= spheres & intersectSpheres(load(m_center, first), float4::load(&m_radius[first]), origin, dir, cullBackFaces, sphereT).bits();
+        t = triangles ? select(mask4::fromBits(spheres), sphereT, t) : sphereT;
+    }
+    if (lanes == 0)
+    {
+        return 0;
+    }
+
+    point = origin + dir * t;
+    const vec3x4 toPoint = point - origin;
+    distance = sqrt(math::dotProduct(toPoint, toPoint));
+    return lanes;
+}
+
+int SceneGeometry::intersect(uint32_t position, const RayPacket& packet, bool skipEmissive, vec3x4& point, float4& distance) const
+{
+    const uint8_t flags = m_flags[position];
+    if (skipEmissive && (flags & EMISSIVE))
+    {
+        return 0;
+    }
+
+    const bool cullBackFaces = packet.type != Ray::Type::INSIDE;
+    int lanes = 0;
+    float4 t;
+    if (flags & TRIANGLE)
+    {
+        lanes = intersectTriangles(broadcast(m_vertex, position), broadcast(m_edge1, position), broadcast(m_edge2, position), broadcast(m_normal, position), packet.origin, packet.dir, cullBackFaces, t).bits();
+    }
+    else if (flags & SPHERE)
+    {
+        lanes = intersectSpheres(broadcast(m_center, position), float4(m_radius[position]), packet.origin, packet.dir, cullBackFaces, t).bits();
+    }
+
+    lanes &= packet.active;
+    if (lanes == 0)
+    {
+        return 0;
+    }
+
+    point = packet.origin + packet.dir * t;
+    const vec3x4 toPoint = point - packet.origin;
+    distance = sqrt(math::dotProduct(toPoint, toPoint));
+    return lanes;
+}
+
+int SceneGeometry::occlude(uint32_t first, uint32_t count, const vec3x4& origin, const vec3x4& dir, const float4& tMax, bool cullBackFaces) const
+{
+    int triangles;
+    int spheres;
+    classify(first, count, true, triangles, spheres);
+
+    int lanes = 0;
+    float4 t;
+    if (triangles)
+    {
+        mask4 hit = intersectTriangles(load(m_vertex, first), load(m_edge1, first), load(m_edge2, first), load(m_normal, first), origin, dir, cullBackFaces, t);
+        lanes |= triangles & (hit & (t < tMax)).bits();
+    }
+    if (spheres)
+    {
+        mask4 hit = intersectSpheres(load(m_center, first), float4::load(&m_radius[first]), origin, dir, cullBackFaces, t);
+        lanes |= spheres & (hit & (t < tMax)).bits();
+    }
+    return lanes;
+}
+
+int SceneGeometry::occlude(uint32_t position, const RayPacket& packet) const
+{
+    const uint8_t flags = m_flags[position];
+    if (flags & EMISSIVE)
+    {
+        return 0;
+    }
+
+    const bool cullBackFaces = packet.type != Ray::Type::INSIDE;
+    mask4 hit = mask4::fromBits(0);
+    float4 t;
+    if (flags & TRIANGLE)
+    {
+        hit = intersectTriangles(broadcast(m_vertex, position), broadcast(m_edge1, position), broadcast(m_edge2, position), broadcast(m_normal, position), packet.origin, packet.dir, cullBackFaces, t);
+    }
+    else if (flags & SPHERE)
+    {
+        hit = intersectSpheres(broadcast(m_center, position), float4(m_radius[position]), packet.origin, packet.dir, cullBackFaces, t);
+    }
+    return (hit & (t < packet.tMax)).bits() & packet.active;
+}
+
+} // namespace sgl
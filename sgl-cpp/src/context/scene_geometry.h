@@ -0,0 +1,76 @@
+#pragma once
+
+#include "bvh.h"
+#include "primitive.h"
+#include "ray_packet.h"
+#include "math/simd.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sgl
+{
+
+// Scene primitives compiled into flat per-type arrays (structure of arrays) in the order in
+// which the BVH leaves refer to them, so that tracing needs neither virtual calls nor pointer
+// chasing and a ray is tested against four primitives of a leaf at once.
+// Intersections are computed exactly as Triangle::intersect and Sphere::intersect do.
+class SceneGeometry
+{
+public:
+    SceneGeometry() = default;
+
+    void build(const std::vector<std::shared_ptr<Primitive>>& primitives, const Bvh& bvh);
+    void clear();
+
+    // Index into the primitives given to build of the primitive at the leaf position
+    uint32_t getPrimitiveIndex(uint32_t position) const;
+    // Leaf position of the primitive at the index into the primitives given to build
+    uint32_t getPosition(uint32_t primitiveIdx) const;
+
+    // Tests a ray (broadcast to all lanes) against primitives at leaf positions [first, first + count),
+    // count being at most four. Returns a bit per lane hit in front of the ray together with hit
+    // points and distances from the ray origin.
+    int intersect(uint32_t first, uint32_t count, const vec3x4& origin, const vec3x4& dir, bool cullBackFaces, bool skipEmissive, vec3x4& point, float4& distance) const;
+
+    // Tests active rays of the packet against the primitive at the leaf position
+    int intersect(uint32_t position, const RayPacket& packet, bool skipEmissive, vec3x4& point, float4& distance) const;
+
+    // Occlusion counterparts of intersect, return a bit per lane whose ray is blocked closer than its
+    // tMax (measured along the normalized direction). Emissive primitives never block rays.
+    int occlude(uint32_t first, uint32_t count, const vec3x4& origin, const vec3x4& dir, const float4& tMax, bool cullBackFaces) const;
+    int occlude(uint32_t position, const RayPacket& packet) const;
+
+private:
+    enum Flags : uint8_t
+    {
+        TRIANGLE = 1,
+        SPHERE = 2,
+        EMISSIVE = 4
+    };
+
+    // Splits lanes of the leaf positions [first, first + count) into triangles and spheres
+    void classify(uint32_t first, uint32_t count, bool skipEmissive, int& triangles, int& spheres) const;
+
+    static mask4 intersectTriangles(const vec3x4& p1, const vec3x4& e1, const vec3x4& e2, const vec3x4& normal, const vec3x4& origin, const vec3x4& dir, bool cullBackFaces, float4& t);
+    static mask4 intersectSpheres(const vec3x4& center, const float4& radius, const vec3x4& origin, const vec3x4& dir, bool cullBackFaces, float4& t);
+
+    static vec3x4 load(const std::vector<float> (&components)[3], uint32_t first);
+    static vec3x4 broadcast(const std::vector<float> (&components)[3], uint32_t position);
+
+    // Triangles
+    std::vector<float> m_vertex[3];
+    std::vector<float> m_edge1[3];
+    std::vector<float> m_edge2[3];
+    std::vector<float> m_normal[3];
+    // Spheres
+    std::vector<float> m_center[3];
+    std::vector<float> m_radius;
+
+    std::vector<uint8_t> m_flags;
+    std::vector<uint32_t> m_primitiveIndices;
+    std::vector<uint32_t> m_positions;
+};
+
+}
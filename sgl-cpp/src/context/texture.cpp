@@ -0,0 +1,184 @@
+#include "texture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace sgl
+{
+
+static uint32_t packTexel(uint32_t r, uint32_t g, uint32_t b)
+{
+    return r | (g << 8) | (b << 16) | (0xffu << 24);
+}
+
+static uint32_t channel(uint32_t texel, int c)
+{
+    return (texel >> (8 * c)) & 0xffu;
+}
+
+Texture::Texture(const uint8_t* texels, int width, int height)
+{
+    assert(width > 0 && height > 0);
+
+    addLevel(width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const uint8_t* rgb = &texels[(y * width + x) * 3];
+            m_texels[texelIndex(m_levels[0], x, y)] = packTexel(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+
+    // Every level averages 2x2 texels of the previous one, odd sizes repeat the last row or column
+    while (m_levels.back().width > 1 || m_levels.back().height > 1)
+    {
+        const int parent = static_cast<int>(m_levels.size()) - 1;
+        const int parentWidth = m_levels[parent].width;
+        const int parentHeight = m_levels[parent].height;
+        addLevel(std::max(1, parentWidth / 2), std::max(1, parentHeight / 2));
+
+        const Level& level = m_levels.back();
+        for (int y = 0; y < level.height; ++y)
+        {
+            for (int x = 0; x < level.width; ++x)
+            {
+                const int x0 = std::min(2 * x, parentWidth - 1);
+                const int x1 = std::min(2 * x + 1, parentWidth - 1);
+                const int y0 = std::min(2 * y, parentHeight - 1);
+                const int y1 = std::min(2 * y + 1, parentHeight - 1);
+                const uint32_t quad[4] = { texel(parent, x0, y0), texel(parent, x1, y0), texel(parent, x0, y1), texel(parent, x1, y1) };
+
+                uint32_t rgb[3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    rgb[c] = (channel(quad[0], c) + channel(quad[1], c) + channel(quad[2], c) + channel(quad[3], c) + 2) / 4;
+                }
+                m_texels[texelIndex(level, x, y)] = packTexel(rgb[0], rgb[1], rgb[2]);
+            }
+        }
+    }
+}
+
+int Texture::getWidth() const
+{
+    return m_levels[0].width;
+}
+
+int Texture::getHeight() const
+{
+    return m_levels[0].height;
+}
+
+int Texture::getLevelCount() const
+{
+    return static_cast<int>(m_levels.size());
+}
+
+vec3 Texture::sample(const vec2& texCoord, float footprint) const
+{
+    const float texels = footprint * std::max(m_levels[0].width, m_levels[0].height);
+    const float lod = texels > 1 ? std::min(std::log2(texels), static_cast<float>(m_levels.size() - 1)) : 0.f;
+
+    const int level = static_cast<int>(lod);
+    const float t = lod - level;
+    if (t == 0)
+    {
+        return bilinear(level, texCoord);
+    }
+    return (1 - t) * bilinear(level, texCoord) + t * bilinear(level + 1, texCoord);
+}
+
+vec3 Texture::fetch(int level, int x, int y) const
+{
+    const uint32_t value = texel(level, x, y);
+    return vec3(channel(value, 0), channel(value, 1), channel(value, 2)) / 255.f;
+}
+
+void Texture::addLevel(int width, int height)
+{
+    const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_levels.push_back({ width, height, tilesX, m_texels.size() });
+    m_texels.resize(m_texels.size() + static_cast<size_t>(tilesX) * tilesY * TILE_SIZE * TILE_SIZE);
+}
+
+size_t Texture::texelIndex(const Level& level, int x, int y) const
+{
+    const size_t tile = static_cast<size_t>(y / TILE_SIZE) * level.tilesX + x / TILE_SIZE;
+
+    // Interleaves the bits of the coordinates within the tile
+    const int tx = x % TILE_SIZE;
+    const int ty = y % TILE_SIZE;
+    const int morton = (tx & 1) | ((ty & 1) << 1) | ((tx & 2) << 1) | ((ty & 2) << 2);
+
+    return level.offset + tile * TILE_SIZE * TILE_SIZE + morton;
+}
+
+uint32_t Texture::texel(int level, int x, int y) const
+{
+    return m_texels[texelIndex(m_levels[level], x, y)];
+}
+
+vec3 Texture::bilinear(int level, const vec2& texCoord) const
+{
+    const Level& l = m_levels[level];
+
+    // Texel centers lie at half-integer coordinates, lookups clamp to the edge
+    const float x = texCoord.x * l.width - 0.5f;
+    const float y = texCoord.y * l.height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float tx = x - fx;
+    const float ty = y - fy;
+
+    const int x0 = std::clamp(static_cast<int>(fx), 0, l.width - 1);
+    const int x1 = std::clamp(static_cast<int>(fx) + 1, 0, l.width - 1);
+    const int y0 = std::clamp(static_cast<int>(fy), 0, l.height - 1);
+    const int y1 = std::clamp(static_cast<int>(fy) + 1, 0, l.height - 1);
+
+    const vec3 top = (1 - tx) * fetch(level, x0, y0) + tx * fetch(level, x1, y0);
+    const vec3 bottom = (1 - tx) * fetch(level, x0, y1) + tx * fetch(level, x1, y1);
+    return (1 - ty) * top + ty * bottom;
+}
+
+TextureCache& TextureCache::getInstance()
+{
+    static TextureCache instance;
+    return instance;
+}
+
+std::shared_ptr<const Texture> TextureCache::load(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_textures.find(path);
+    if (it != m_textures.end())
+    {
+        return it->second;
+    }
+
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 3);
+    if (!data)
+    {
+        return nullptr;
+    }
+    std::shared_ptr<const Texture> texture = std::make_shared<Texture>(data, width, height);
+    stbi_image_free(data);
+
+    m_textures.emplace(path, texture);
+    return texture;
+}
+
+void TextureCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_textures.clear();
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "math/vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sgl
+{
+
+// RGB texture with a full mip chain. Texels of every level are packed as RGBA8 into square tiles
+// of TILE_SIZE texels, one 64 byte cache line each, stored in Morton order inside the tile. The
+// four texels of a bilinear lookup then share a cache line far more often than in row-major order.
+class Texture
+{
+public:
+    static constexpr int TILE_SIZE = 4;
+
+    // Builds the texture and its mip chain from row-major RGB8 texels
+    Texture(const uint8_t* texels, int width, int height);
+
+    int getWidth() const;
+    int getHeight() const;
+    int getLevelCount() const;
+
+    // Trilinearly filtered color at texCoord, footprint is the width of the area covered by the
+    // lookup in texture coordinates and selects the mip level
+    vec3 sample(const vec2& texCoord, float footprint) const;
+
+    // Unfiltered texel of a mip level
+    vec3 fetch(int level, int x, int y) const;
+
+private:
+    struct Level
+    {
+        int width;
+        int height;
+        int tilesX;
+        size_t offset;
+    };
+
+    void addLevel(int width, int height);
+    size_t texelIndex(const Level& level, int x, int y) const;
+    uint32_t texel(int level, int x, int y) const;
+    vec3 bilinear(int level, const vec2& texCoord) const;
+
+    std::vector<Level> m_levels;
+    std::vector<uint32_t> m_texels;
+};
+
+// Process-wide cache of decoded textures keyed by their path, every image is read from disk
+// once and shared by all materials using it
+class TextureCache
+{
+public:
+    static TextureCache& getInstance();
+
+    // Texture of the image at path, nullptr when it cannot be loaded
+    std::shared_ptr<const Texture> load(const std::string& path);
+    void clear();
+
+private:
+    TextureCache() = default;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Texture>> m_textures;
+};
+
+}
@@ -0,0 +1,154 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace sgl
+{
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+    : m_task(nullptr),
+      m_generation(0),
+      m_busyWorkers(0),
+      m_stop(false)
+{
+    threadCount = std::max(threadCount, 1u);
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        m_queues.emplace_back(std::make_unique<WorkQueue>());
+    }
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getThreadCount() const
+{
+    return static_cast<uint32_t>(m_queues.size());
+}
+
+uint32_t ThreadPool::defaultThreadCount()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void ThreadPool::parallelFor(uint32_t taskCount, const Task& task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+
+    if (m_workers.empty())
+    {
+        for (uint32_t i = 0; i < taskCount; ++i)
+        {
+            task(i, 0);
+        }
+        return;
+    }
+
+    // Every thread starts with a contiguous block of tasks and steals from the others once done
+    uint32_t queueCount = getThreadCount();
+    for (uint32_t q = 0; q < queueCount; ++q)
+    {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * q / queueCount);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * (q + 1) / queueCount);
+        std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            m_queues[q]->tasks.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+        ++m_generation;
+    }
+    m_wakeCondition.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]() { return m_busyWorkers == 0; });
+    m_task = nullptr;
+}
+
+bool ThreadPool::popTask(uint32_t threadIdx, uint32_t& taskIdx)
+{
+    {
+        WorkQueue& own = *m_queues[threadIdx];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            taskIdx = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    uint32_t queueCount = getThreadCount();
+    for (uint32_t i = 1; i < queueCount; ++i)
+    {
+        WorkQueue& victim = *m_queues[(threadIdx + i) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            taskIdx = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTasks(uint32_t threadIdx)
+{
+    uint32_t taskIdx;
+    while (popTask(threadIdx, taskIdx))
+    {
+        (*m_task)(taskIdx, threadIdx);
+    }
+}
+
+void ThreadPool::workerLoop(uint32_t threadIdx)
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [&]() { return m_stop || m_generation != generation; });
+            if (m_stop)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        runTasks(threadIdx);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0)
+        {
+            m_doneCondition.notify_all();
+        }
+    }
+}
+
+} // namespace sgl
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sgl
+{
+
+// Persistent pool of worker threads with per-thread work stealing queues
+class ThreadPool
+{
+public:
+    using Task = std::function<void(uint32_t /* taskIdx */, uint32_t /* threadIdx */)>;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+
+    // The calling thread takes part in the work, so threadCount - 1 workers are spawned
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    uint32_t getThreadCount() const;
+
+    // Runs the task for every index in [0, taskCount) and returns once all of them finished
+    void parallelFor(uint32_t taskCount, const Task& task);
+
+    // Number of threads to use when zero is requested
+    static uint32_t defaultThreadCount();
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<uint32_t> tasks;
+    };
+
+    bool popTask(uint32_t threadIdx, uint32_t& taskIdx);
+    void runTasks(uint32_t threadIdx);
+    void workerLoop(uint32_t threadIdx);
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    const Task* m_task;
+    uint64_t m_generation;
+    uint32_t m_busyWorkers;
+    bool m_stop;
+};
+
+}
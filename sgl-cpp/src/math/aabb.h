@@ -0,0 +1,148 @@
+#pragma once
+
+#include "math/simd.h"
+#include "math/vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sgl
+{
+
+    // Axis aligned bounding box
+    struct AABB
+    {
+        AABB()
+            : min(std::numeric_limits<float>::max()),
+              max(-std::numeric_limits<float>::max())
+        {
+        }
+
+        AABB(const vec3& min, const vec3& max)
+            : min(min), max(max)
+        {
+        }
+
+        void extend(const vec3& point)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                min[i] = std::min(min[i], point[i]);
+                max[i] = std::max(max[i], point[i]);
+            }
+        }
+
+        void extend(const AABB& other)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                min[i] = std::min(min[i], other.min[i]);
+                max[i] = std::max(max[i], other.max[i]);
+            }
+        }
+
+        bool isEmpty() const
+        {
+            return min.x > max.x || min.y > max.y || min.z > max.z;
+        }
+
+        vec3 centroid() const
+        {
+            return (min + max) * 0.5f;
+        }
+
+        vec3 diagonal() const
+        {
+            return max - min;
+        }
+
+        // Index of the longest axis
+        int maxExtent() const
+        {
+            vec3 d = diagonal();
+            if (d.x > d.y && d.x > d.z)
+            {
+                return 0;
+            }
+            return d.y > d.z ? 1 : 2;
+        }
+
+        float surfaceArea() const
+        {
+            if (isEmpty())
+            {
+                return 0;
+            }
+            vec3 d = diagonal();
+            return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+
+        // Distance from the point to the closest point of the box, zero inside
+        float distance(const vec3& point) const
+        {
+            float squared = 0;
+            for (int i = 0; i < 3; ++i)
+            {
+                float d = std::max({ min[i] - point[i], 0.f, point[i] - max[i] });
+                squared += d * d;
+            }
+            return std::sqrt(squared);
+        }
+
+        // Far distances are scaled up slightly so that rounding never culls
+        // a primitive lying exactly on the box boundary
+        static constexpr float FAR_SCALE = 1.0001f;
+
+        // Conservative slab test, returns entry distance or infinity when the box is missed
+        float intersect(const vec3& origin, const vec3& invDir, float tMax) const
+        {
+            float tNear = 0;
+            float tFar = tMax * FAR_SCALE;
+            for (int i = 0; i < 3; ++i)
+            {
+                float t0 = (min[i] - origin[i]) * invDir[i];
+                float t1 = (max[i] - origin[i]) * invDir[i];
+                if (t0 > t1)
+                {
+                    std::swap(t0, t1);
+                }
+                tNear = t0 > tNear ? t0 : tNear;
+                t1 *= FAR_SCALE;
+                tFar = t1 < tFar ? t1 : tFar;
+                if (tNear > tFar)
+                {
+                    return std::numeric_limits<float>::infinity();
+                }
+            }
+            return tNear;
+        }
+
+        // Packet version of the slab test, returns the lanes whose ray hits the box
+        mask4 intersect(const vec3x4& origin, const vec3x4& invDir, const float4& tMax) const
+        {
+            const float4 farScale(FAR_SCALE);
+            const float4* origins[3] = { &origin.x, &origin.y, &origin.z };
+            const float4* invDirs[3] = { &invDir.x, &invDir.y, &invDir.z };
+
+            float4 tNear(0.f);
+            float4 tFar = tMax * farScale;
+            for (int i = 0; i < 3; ++i)
+            {
+                float4 t0 = (float4(min[i]) - *origins[i]) * *invDirs[i];
+                float4 t1 = (float4(max[i]) - *origins[i]) * *invDirs[i];
+                // Same comparisons as the scalar test so that NaNs are ignored the same way
+                mask4 swap = t0 > t1;
+                float4 lo = select(swap, t1, t0);
+                float4 hi = select(swap, t0, t1) * farScale;
+                tNear = select(lo > tNear, lo, tNear);
+                tFar = select(hi < tFar, hi, tFar);
+            }
+            return tNear <= tFar;
+        }
+
+        vec3 min;
+        vec3 max;
+    };
+
+}
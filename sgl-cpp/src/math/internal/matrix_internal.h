@@ -10,8 +10,6 @@
 #ifdef SGL_SIMD
 #include <immintrin.h>
 #include <pmmintrin.h>
-#pragma GCC target("sse3")
-#pragma GCC target("avx")
 #endif
 
 namespace sgl 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sgl
+{
+
+    // Minimal PCG32 generator, small enough to keep one per pixel so that
+    // images do not depend on the order in which pixels are rendered
+    struct Rng
+    {
+        Rng(uint64_t seed, uint64_t stream = 0)
+            : state(0), increment((stream << 1u) | 1u)
+        {
+            nextUint();
+            state += hash(seed);
+            nextUint();
+        }
+
+        // SplitMix64 finalizer, decorrelates consecutive seeds such as pixel indices
+        static uint64_t hash(uint64_t x)
+        {
+            x = (x ^ (x >> 30u)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27u)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31u);
+        }
+
+        uint32_t nextUint()
+        {
+            uint64_t old = state;
+            state = old * 6364136223846793005ULL + increment;
+            uint32_t xorShifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = static_cast<uint32_t>(old >> 59u);
+            return (xorShifted >> rot) | (xorShifted << ((~rot + 1u) & 31));
+        }
+
+        // Uniform float in [0, 1)
+        float nextFloat()
+        {
+            return (nextUint() >> 8) * (1.f / (1u << 24));
+        }
+
+        uint64_t state;
+        uint64_t increment;
+    };
+
+}
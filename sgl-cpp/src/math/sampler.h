@@ -0,0 +1,116 @@
+#pragma once
+
+#include "math/random.h"
+#include "math/vector.h"
+
+#include <cstdint>
+
+namespace sgl
+{
+
+    // Low discrepancy samples of a single pixel sample. Every dimension is a 2D Sobol (0,2)
+    // sequence, Owen scrambled per pixel and dimension. The sample index is shuffled per dimension
+    // as well, so one sample takes unrelated points of different dimensions, while aligned power of
+    // two runs of indices still give stratified sets. Samples depend only on the pixel, the sample
+    // index and the dimension, so images do not depend on the rendering order.
+    class Sampler
+    {
+    public:
+        // Dimension holding the position within the pixel, shading starts right after it
+        static constexpr uint32_t PIXEL_DIMENSION = 0;
+        static constexpr uint32_t SHADING_DIMENSION = 1;
+
+        Sampler(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension = SHADING_DIMENSION)
+            : m_pixel(pixel), m_sampleIndex(sampleIndex), m_dimension(dimension)
+        {
+        }
+
+        // Fills points with count samples of the next dimension. Any power of two count is
+        // stratified among itself and, over consecutive sample indices, with the other ones
+        void next2D(vec2* points, uint32_t count)
+        {
+            const uint64_t seed = Rng::hash(Rng::hash(m_pixel) ^ m_dimension);
+            const uint32_t seedIndex = static_cast<uint32_t>(seed);
+            const uint32_t seedX = static_cast<uint32_t>(seed >> 32);
+            const uint32_t seedY = static_cast<uint32_t>(Rng::hash(seed));
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint32_t index = owenScramble(m_sampleIndex * count + i, seedIndex);
+                points[i] = vec2(toFloat(owenScramble(reverseBits(index), seedX)), toFloat(owenScramble(sobol(index), seedY)));
+            }
+            ++m_dimension;
+        }
+
+        vec2 next2D()
+        {
+            vec2 point;
+            next2D(&point, 1);
+            return point;
+        }
+
+        // First coordinate of next2D alone, for dimensions that need a single value per sample
+        void next1D(float* values, uint32_t count)
+        {
+            const uint64_t seed = Rng::hash(Rng::hash(m_pixel) ^ m_dimension);
+            const uint32_t seedIndex = static_cast<uint32_t>(seed);
+            const uint32_t seedX = static_cast<uint32_t>(seed >> 32);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint32_t index = owenScramble(m_sampleIndex * count + i, seedIndex);
+                values[i] = toFloat(owenScramble(reverseBits(index), seedX));
+            }
+            ++m_dimension;
+        }
+
+        // Van der Corput sequence, the first Sobol dimension
+        static uint32_t reverseBits(uint32_t x)
+        {
+            x = (x << 16) | (x >> 16);
+            x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+            x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+            x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+            x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+            return x;
+        }
+
+        // Second Sobol dimension
+        static uint32_t sobol(uint32_t index)
+        {
+            uint32_t result = 0;
+            for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+            {
+                if (index & 1)
+                {
+                    result ^= v;
+                }
+            }
+            return result;
+        }
+
+        // Random permutation of the binary tree of the bits, from the most significant one down:
+        // every bit is flipped depending only on the bits above it, so aligned power of two ranges
+        // map to aligned ranges of the same size (Laine and Karras, as used by Burley 2020)
+        static uint32_t owenScramble(uint32_t x, uint32_t seed)
+        {
+            x = reverseBits(x);
+            x += seed;
+            x ^= x * 0x6c50b47cu;
+            x ^= x * 0xb82f1e52u;
+            x ^= x * 0xc7afe638u;
+            x ^= x * 0x8d22f6e6u;
+            return reverseBits(x);
+        }
+
+    private:
+        // Uniform float in [0, 1) from the upper 24 bits
+        static float toFloat(uint32_t bits)
+        {
+            return (bits >> 8) * (1.f / (1u << 24));
+        }
+
+        uint64_t m_pixel;
+        uint32_t m_sampleIndex;
+        uint32_t m_dimension;
+    };
+
+}
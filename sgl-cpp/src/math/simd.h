@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cmath>
+
+#ifdef SGL_SIMD
+#include <immintrin.h>
+#endif
+
+namespace sgl
+{
+
+    // Four lane boolean mask produced by float4 comparisons
+    struct mask4
+    {
+#ifdef SGL_SIMD
+        __m128 m;
+
+        // Bit i is set when lane i is true
+        int bits() const { return _mm_movemask_ps(m); }
+
+        static mask4 fromBits(int bits)
+        {
+            const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+            __m128i selected = _mm_and_si128(_mm_set1_epi32(bits), lanes);
+            return { _mm_castsi128_ps(_mm_cmpeq_epi32(selected, lanes)) };
+        }
+#else
+        bool m[4];
+
+        int bits() const { return m[0] | (m[1] << 1) | (m[2] << 2) | (m[3] << 3); }
+
+        static mask4 fromBits(int bits)
+        {
+            return { { (bits & 1) != 0, (bits & 2) != 0, (bits & 4) != 0, (bits & 8) != 0 } };
+        }
+#endif
+
+        bool any() const { return bits() != 0; }
+        bool all() const { return bits() == 0xF; }
+    };
+
+    // Four floats processed in lock step, a single SSE register when SGL_SIMD is enabled
+    struct float4
+    {
+        float4() = default;
+
+#ifdef SGL_SIMD
+        explicit float4(float scalar) : v(_mm_set1_ps(scalar)) {}
+        float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+        float4(__m128 v) : v(v) {}
+
+        static float4 load(const float* ptr) { return _mm_loadu_ps(ptr); }
+        void store(float* ptr) const { _mm_storeu_ps(ptr, v); }
+
+        __m128 v;
+#else
+        explicit float4(float scalar) : v{ scalar, scalar, scalar, scalar } {}
+        float4(float a, float b, float c, float d) : v{ a, b, c, d } {}
+
+        static float4 load(const float* ptr) { return float4(ptr[0], ptr[1], ptr[2], ptr[3]); }
+        void store(float* ptr) const { for (int i = 0; i < 4; ++i) ptr[i] = v[i]; }
+
+        float v[4];
+#endif
+
+        float operator[](int lane) const
+        {
+            float lanes[4];
+            store(lanes);
+            return lanes[lane];
+        }
+
+        void set(int lane, float value)
+        {
+            float lanes[4];
+            store(lanes);
+            lanes[lane] = value;
+            *this = load(lanes);
+        }
+
+        // Hidden friend so that it does not shadow the scalar sqrt inside namespace sgl
+        friend float4 sqrt(const float4& a)
+        {
+#ifdef SGL_SIMD
+            return _mm_sqrt_ps(a.v);
+#else
+            return float4(std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3]));
+#endif
+        }
+    };
+
+#ifdef SGL_SIMD
+    inline float4 operator+(const float4& a, const float4& b) { return _mm_add_ps(a.v, b.v); }
+    inline float4 operator-(const float4& a, const float4& b) { return _mm_sub_ps(a.v, b.v); }
+    inline float4 operator*(const float4& a, const float4& b) { return _mm_mul_ps(a.v, b.v); }
+    inline float4 operator/(const float4& a, const float4& b) { return _mm_div_ps(a.v, b.v); }
+    inline float4 operator-(const float4& a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.f)); }
+
+    inline mask4 operator<(const float4& a, const float4& b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+    inline mask4 operator<=(const float4& a, const float4& b) { return { _mm_cmple_ps(a.v, b.v) }; }
+    inline mask4 operator>(const float4& a, const float4& b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+    inline mask4 operator>=(const float4& a, const float4& b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+    inline mask4 operator==(const float4& a, const float4& b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+    inline mask4 operator!=(const float4& a, const float4& b) { return { _mm_cmpneq_ps(a.v, b.v) }; }
+
+    inline mask4 operator&(const mask4& a, const mask4& b) { return { _mm_and_ps(a.m, b.m) }; }
+    inline mask4 operator|(const mask4& a, const mask4& b) { return { _mm_or_ps(a.m, b.m) }; }
+    inline mask4 andNot(const mask4& a, const mask4& b) { return { _mm_andnot_ps(b.m, a.m) }; }
+
+    // Lanes of a where the mask is set, lanes of b elsewhere
+    inline float4 select(const mask4& mask, const float4& a, const float4& b) { return _mm_blendv_ps(b.v, a.v, mask.m); }
+#else
+    namespace internal
+    {
+        template <typename F>
+        inline float4 lanewise(F&& f)
+        {
+            float4 r;
+            for (int i = 0; i < 4; ++i) r.v[i] = f(i);
+            return r;
+        }
+
+        template <typename F>
+        inline mask4 maskwise(F&& f)
+        {
+            mask4 r;
+            for (int i = 0; i < 4; ++i) r.m[i] = f(i);
+            return r;
+        }
+    }
+
+    inline float4 operator+(const float4& a, const float4& b) { return internal::lanewise([&](int i) { return a.v[i] + b.v[i]; }); }
+    inline float4 operator-(const float4& a, const float4& b) { return internal::lanewise([&](int i) { return a.v[i] - b.v[i]; }); }
+    inline float4 operator*(const float4& a, const float4& b) { return internal::lanewise([&](int i) { return a.v[i] * b.v[i]; }); }
+    inline float4 operator/(const float4& a, const float4& b) { return internal::lanewise([&](int i) { return a.v[i] / b.v[i]; }); }
+    inline float4 operator-(const float4& a) { return internal::lanewise([&](int i) { return -a.v[i]; }); }
+
+    inline mask4 operator<(const float4& a, const float4& b) { return internal::maskwise([&](int i) { return a.v[i] < b.v[i]; }); }
+    inline mask4 operator<=(const float4& a, const float4& b) { return internal::maskwise([&](int i) { return a.v[i] <= b.v[i]; }); }
+    inline mask4 operator>(const float4& a, const float4& b) { return internal::maskwise([&](int i) { return a.v[i] > b.v[i]; }); }
+    inline mask4 operator>=(const float4& a, const float4& b) { return internal::maskwise([&](int i) { return a.v[i] >= b.v[i]; }); }
+    inline mask4 operator==(const float4& a, const float4& b) { return internal::maskwise([&](int i) { return a.v[i] == b.v[i]; }); }
+    inline mask4 operator!=(const float4& a, const float4& b) { return internal::maskwise([&](int i) { return a.v[i] != b.v[i]; }); }
+
+    inline mask4 operator&(const mask4& a, const mask4& b) { return internal::maskwise([&](int i) { return a.m[i] && b.m[i]; }); }
+    inline mask4 operator|(const mask4& a, const mask4& b) { return internal::maskwise([&](int i) { return a.m[i] || b.m[i]; }); }
+    inline mask4 andNot(const mask4& a, const mask4& b) { return internal::maskwise([&](int i) { return a.m[i] && !b.m[i]; }); }
+
+    // Lanes of a where the mask is set, lanes of b elsewhere
+    inline float4 select(const mask4& mask, const float4& a, const float4& b) { return internal::lanewise([&](int i) { return mask.m[i] ? a.v[i] : b.v[i]; }); }
+#endif
+
+    // Three component vector with four lanes per component (structure of arrays)
+    struct vec3x4
+    {
+        vec3x4() = default;
+        vec3x4(const float4& x, const float4& y, const float4& z) : x(x), y(y), z(z) {}
+
+        // Broadcasts a single vector to all lanes
+        template <typename V>
+        static vec3x4 broadcast(const V& v) { return { float4(v.x), float4(v.y), float4(v.z) }; }
+
+        float4 x;
+        float4 y;
+        float4 z;
+    };
+
+    inline vec3x4 operator+(const vec3x4& a, const vec3x4& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+    inline vec3x4 operator-(const vec3x4& a, const vec3x4& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline vec3x4 operator*(const vec3x4& a, const float4& s) { return { a.x * s, a.y * s, a.z * s }; }
+    inline vec3x4 operator/(const vec3x4& a, const float4& s) { return { a.x / s, a.y / s, a.z / s }; }
+
+    namespace math
+    {
+        // Evaluated in the same order as the scalar dotProduct so both give identical results
+        inline float4 dotProduct(const vec3x4& a, const vec3x4& b)
+        {
+            return (a.x * b.x + a.y * b.y) + a.z * b.z;
+        }
+
+        inline vec3x4 crossProduct(const vec3x4& a, const vec3x4& b)
+        {
+            return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+        }
+    }
+
+}
@@ -8,8 +8,6 @@
 #ifdef SGL_SIMD
 #include <immintrin.h>
 #include <pmmintrin.h>
-#pragma GCC target("sse3")
-#pragma GCC target("avx")
 #endif
 
 
@@ -102,6 +100,13 @@ namespace sgl
             return std::sqrt(dotProduct(sub, sub));
         }
 
+        // Relative luminance of a linear RGB color (Rec. 709 weights)
+        template <typename T, typename = std::enable_if_t<std::is_floating_point_v<T>>>
+        constexpr T luminance(const Vector<3, T>& color)
+        {
+            return T(0.2126) * color.x + T(0.7152) * color.y + T(0.0722) * color.z;
+        }
+
     }
 
     
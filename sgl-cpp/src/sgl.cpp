@@ -34,6 +34,7 @@ const char *sglGetErrorString(sglEErrorCode error)
 
 void sglFinish(void)
 {
+    sgl::SglController::getInstance().flushContexts();
 }
 
 int sglCreateContext(int width, int height)
@@ -67,7 +68,7 @@ void sglClear(unsigned what)
 {
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing())
+    if (!context || context->isDrawing() || context->isRecordingList())
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -127,6 +128,123 @@ void sglVertex2f(float x, float y)
     context->addVertex(sgl::vec4(x, y, 0, 1));
 }
 
+void sglVertexPointer(int size, int stride, const float *pointer)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    if (size < 2 || size > 4 || stride < 0)
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->setVertexPointer(size, stride, pointer);
+}
+
+// Checks shared by sglDrawArrays and sglDrawElements, returns the context to draw into
+static sgl::Context* getArrayContext(sglEElementType mode, int count)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || !context->hasVertexPointer())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return nullptr;
+    }
+    if (!(mode >= SGL_POINTS && mode <= SGL_POLYGON))
+    {
+        m.setError(SGL_INVALID_ENUM);
+        return nullptr;
+    }
+    if (count < 0)
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return nullptr;
+    }
+    // Scenes and meshes consist of triangles only
+    if ((context->isSpecifyingScene() || context->isSpecifyingMesh()) && mode != SGL_TRIANGLES && !(mode == SGL_POLYGON && count == 3))
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return nullptr;
+    }
+    return count > 0 ? context : nullptr;
+}
+
+void sglDrawArrays(sglEElementType mode, int first, int count)
+{
+    sgl::Context* context = getArrayContext(mode, count);
+    if (!context)
+    {
+        return;
+    }
+    if (first < 0)
+    {
+        sgl::SglController::getInstance().setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->drawArrays(mode, first, count);
+}
+
+void sglDrawElements(sglEElementType mode, int count, const unsigned *indices)
+{
+    sgl::Context* context = getArrayContext(mode, count);
+    if (!context)
+    {
+        return;
+    }
+    if (!indices)
+    {
+        sgl::SglController::getInstance().setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->drawElements(mode, count, indices);
+}
+
+int sglNewList(void)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isRecordingList() || context->isSpecifyingScene() || context->isSpecifyingMesh())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return -1;
+    }
+    return context->newList();
+}
+
+void sglEndList(void)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || !context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    context->endList();
+}
+
+void sglCallList(int list)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isRecordingList() || context->isSpecifyingScene() || context->isSpecifyingMesh())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    if (!context->hasList(list))
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->callList(list);
+}
+
 void sglCircle(float x, float y, float z, float radius)
 {
     sgl::SglController& m = sgl::SglController::getInstance();
@@ -175,6 +293,12 @@ void sglMatrixMode(sglEMatrixMode mode)
         m.setError(SGL_INVALID_OPERATION);
         return;
     }
+    // Lists only record modelview transformations
+    if (mode == SGL_PROJECTION && context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
     switch (mode)
     {
         case SGL_MODELVIEW:
@@ -328,7 +452,7 @@ void sglOrtho(float left, float right, float bottom, float top, float near, floa
 {   
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing())
+    if (!context || context->isDrawing() || context->isRecordingList())
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -347,7 +471,7 @@ void sglFrustum(float left, float right, float bottom, float top, float near, fl
 {
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing())
+    if (!context || context->isDrawing() || context->isRecordingList())
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -366,7 +490,7 @@ void sglViewport(int x, int y, int width, int height)
 {    
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing())
+    if (!context || context->isDrawing() || context->isRecordingList())
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -457,11 +581,23 @@ void sglDisable(sglEEnableFlags cap)
     context->disableFeatures(static_cast<uint32_t>(cap));
 }
 
+void sglFlush(void)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    context->flushRaster();
+}
+
 void sglBeginScene()
 {
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing() || context->isSpecifyingScene())
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -485,7 +621,7 @@ void sglSphere(const float x, const float y, const float z, const float radius)
 {
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing() || !context->isSpecifyingScene())
+    if (!context || context->isDrawing() || (!context->isSpecifyingScene() && !context->isSpecifyingMesh()))
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -493,6 +629,98 @@ void sglSphere(const float x, const float y, const float z, const float radius)
     context->addSphere(sgl::vec4(x, y, z, 1), radius);
 }
 
+void sglTriangles(int count, const float *vertices)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || (!context->isSpecifyingScene() && !context->isSpecifyingMesh()))
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    if (count < 0 || (count > 0 && !vertices))
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->addTriangles(vertices, count);
+}
+
+int sglBeginMesh()
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return -1;
+    }
+    return context->beginMesh();
+}
+
+void sglUpdateMesh(int mesh)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    if (!context->hasMesh(mesh))
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->updateMesh(mesh);
+}
+
+void sglEndMesh()
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || !context->isSpecifyingMesh())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    context->endMesh();
+}
+
+int sglInstance(int mesh)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || !context->isSpecifyingScene())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return -1;
+    }
+    if (!context->hasMesh(mesh))
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return -1;
+    }
+    return context->addInstance(mesh);
+}
+
+void sglInstanceTransform(int instance)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    if (!context->hasInstance(instance))
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->setInstanceTransform(instance);
+}
+
 void sglMaterial(const float r, const float g, const float b, const float kd, const float ks, const float shine, const float T, const float ior)
 {
     sgl::SglController& m = sgl::SglController::getInstance();
@@ -526,7 +754,7 @@ void sglRayTraceScene()
 {
     sgl::SglController& m = sgl::SglController::getInstance();
     sgl::Context* context = m.getActive();
-    if (!context || context->isDrawing() || context->isSpecifyingScene())
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
     {
         m.setError(SGL_INVALID_OPERATION);
         return;
@@ -534,8 +762,148 @@ void sglRayTraceScene()
     context->renderScene();
 }
 
+void sglRayTraceSceneProgressive(int samples)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    if (samples <= 0)
+    {
+        m.setError(SGL_INVALID_VALUE);
+        return;
+    }
+    context->renderSceneProgressive(samples);
+}
+
+int sglGetSampleCount(void)
+{
+    sgl::Context* context = sgl::SglController::getInstance().getActive();
+    return context ? static_cast<int>(context->getSampleCount()) : 0;
+}
+
+float sglGetNoiseEstimate(void)
+{
+    sgl::Context* context = sgl::SglController::getInstance().getActive();
+    return context ? context->getNoiseEstimate() : 1.f;
+}
+
+float sglGetBvhStatistic(sglEBvhStatistic pname)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context)
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return 0.f;
+    }
+    const sgl::Bvh::Statistics& statistics = context->getBvhStatistics();
+    switch (pname)
+    {
+        case SGL_BVH_BUILD_TIME:
+            return statistics.buildTime;
+        case SGL_BVH_NODE_COUNT:
+            return static_cast<float>(statistics.nodeCount);
+        case SGL_BVH_LEAF_COUNT:
+            return static_cast<float>(statistics.leafCount);
+        case SGL_BVH_DEPTH:
+            return static_cast<float>(statistics.depth);
+        case SGL_BVH_SAH_COST:
+            return statistics.sahCost;
+        default:
+            m.setError(SGL_INVALID_ENUM);
+            return 0.f;
+    }
+}
+
+void sglRenderParameteri(sglERenderParameter pname, int value)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    switch (pname)
+    {
+        case SGL_RENDER_THREADS:
+            if (value < 0)
+            {
+                m.setError(SGL_INVALID_VALUE);
+                return;
+            }
+            break;
+        case SGL_RENDER_TILE_SIZE:
+            if (value <= 0)
+            {
+                m.setError(SGL_INVALID_VALUE);
+                return;
+            }
+            break;
+        case SGL_RENDER_PACKETS:
+        case SGL_RENDER_HYBRID:
+            break;
+        case SGL_RENDER_BVH_BUILDER:
+            if (value != SGL_BVH_SAH && value != SGL_BVH_LBVH)
+            {
+                m.setError(SGL_INVALID_VALUE);
+                return;
+            }
+            break;
+        case SGL_RENDER_MIN_SAMPLES:
+        case SGL_RENDER_MAX_SAMPLES:
+            if (value <= 0)
+            {
+                m.setError(SGL_INVALID_VALUE);
+                return;
+            }
+            break;
+        default:
+            m.setError(SGL_INVALID_ENUM);
+            return;
+    }
+    context->setRenderParameter(pname, value);
+}
+
+void sglRenderParameterf(sglERenderParameter pname, float value)
+{
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    switch (pname)
+    {
+        case SGL_RENDER_NOISE_TARGET:
+            if (value < 0)
+            {
+                m.setError(SGL_INVALID_VALUE);
+                return;
+            }
+            break;
+        default:
+            m.setError(SGL_INVALID_ENUM);
+            return;
+    }
+    context->setRenderParameter(pname, value);
+}
+
 void sglRasterizeScene()
 {
+    sgl::SglController& m = sgl::SglController::getInstance();
+    sgl::Context* context = m.getActive();
+    if (!context || context->isDrawing() || context->isSpecifyingScene() || context->isSpecifyingMesh() || context->isRecordingList())
+    {
+        m.setError(SGL_INVALID_OPERATION);
+        return;
+    }
+    context->rasterizeScene();
 }
 
 void sglEmissiveMaterial(const float r, const float g, const float b, const float c0, const float c1, const float c2)
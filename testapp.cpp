@@ -86,6 +86,7 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <thread>
 
 #if USE_GUI
   #ifdef __APPLE__
@@ -95,7 +96,9 @@
   #endif
 #endif
 
+#include "nffcache.h"
 #include "nffread.h"
+#include "nffscene.h"
 #include "nffstore.h"
 #include "sgl.h"
 #include "timer.h"
@@ -854,29 +857,45 @@ void DrawTestScene2D(NFFStore &nffstore) {
   }
 }
 
-/// NFF drawing test
-float RayTraceScene(const char *scenename, unsigned int iter = 1) {
-  NFFStore nffstore(false);
-  Timer timer;
-
-  FILE *f = fopen(scenename, "rt");
-  if (!f) {
+/// Specify the scene of an NFF file in the current context, from its binary cache when it is up to date.
+/** A missing or stale cache is made while the NFF file is parsed and written next to it */
+bool LoadScene(const char *scenename, NFFCacheHeader &header) {
+  uint64_t hash;
+  if (!NFFCache::HashFile(scenename, hash)) {
     cerr << "Could not open " << scenename << " for reading." << std::endl;
-    return 0;
+    return false;
+  }
+
+  const std::string cachename = std::string(scenename) + ".cache";
+  NFFCache cache;
+  if (cache.Open(cachename.c_str(), hash)) {
+    cout << "NFF cache " << cachename << " successfully mapped." << endl;
+    NFFScene::Replay(cache);
+    header = cache.Header();
+    return true;
   }
 
+  // the geometry goes to the context as it is parsed, and is kept for the cache
+  NFFScene scene(true);
   char errstring[4000];
-  if (ReadNFF(f, errstring, &nffstore) < 0) {
+  if (ReadNFF(scenename, errstring, &scene, std::thread::hardware_concurrency()) < 0) {
     cerr << "Error in NFF file " << scenename << ":\n"
          << errstring << std::endl;
-    fclose(f);
-    return 0;
+    return false;
   }
-  fclose(f);
+  scene.Finish();
+  header = scene.Header();
 
   cout << "NFF file " << scenename << " successfully parsed." << endl;
 
-  timer.Restart();
+  if (!NFFCache::Write(cachename.c_str(), scene.Serialize(hash)))
+    cerr << "Could not write " << cachename << "." << std::endl;
+  return true;
+}
+
+/// NFF drawing test
+float RayTraceScene(const char *scenename, unsigned int iter = 1) {
+  Timer timer;
 
   // projection transformation
   sglMatrixMode(SGL_PROJECTION);
@@ -887,64 +906,23 @@ float RayTraceScene(const char *scenename, unsigned int iter = 1) {
 
   /// BEGIN SCENE DEFINITION
   sglBeginScene();
-  // iterate over all the geometry from the NFF file
-  NFFStore::TMatGroupList::const_iterator giter = nffstore.matgroups.begin();
-  for (; giter != nffstore.matgroups.end(); ++giter) {
-    const NFFStore::Material &m = giter->material;
-    sglMaterial(m.col.r, m.col.g, m.col.b, m.kd, m.ks, m.shine, m.T, m.ior);
-
-    /// store all polygons (converted into triangles)
-    const NFFStore::TriangleList &tlist = giter->geometry;
-    NFFStore::TriangleList::const_iterator titer = tlist.begin();
-    for (; titer != tlist.end(); ++titer) {
-      const NFFStore::Triangle &t = *titer;
-      sglBegin(SGL_POLYGON);
-      for (int i = 0; i < 3; i++)
-        sglVertex3f(t.vertices[i].x, t.vertices[i].y, t.vertices[i].z);
-      sglEnd();
-    }
-
-    /// store spheres
-    const NFFStore::SphereList &slist = giter->spheres;
-    NFFStore::SphereList::const_iterator siter = slist.begin();
-    for (; siter != slist.end(); ++siter) {
-      const NFFStore::Sphere &s = *siter;
-      sglSphere(s.center.x, s.center.y, s.center.z, s.radius);
-    }
+  NFFCacheHeader header;
+  if (!LoadScene(scenename, header)) {
+    sglEndScene();
+    return 0;
   }
 
-  // iterate over all point lights from the NFF file
-  std::list<NFFStore::PointLight>::const_iterator liter =
-      nffstore.pointLights.begin();
-  for (; liter != nffstore.pointLights.end(); ++liter) {
-    const NFFStore::PointLight &l = *liter;
-    sglPointLight(l.position.x, l.position.y, l.position.z, l.intensity.r,
-                  l.intensity.g, l.intensity.b);
+  HDRLoaderResult envMap;
+  envMap.cols = NULL;
+  if (header.hdrName[0] && !HDRLoader::load(header.hdrName, envMap)) {
+    cout << "Cound not read hdr env map !" << header.hdrName << endl;
+    envMap.cols = NULL;
   }
 
-  // iterate over all the geometry from the NFF file
-  NFFStore::TLightGroupList::const_iterator aliter =
-      nffstore.lightgroups.begin();
-  for (; aliter != nffstore.lightgroups.end(); ++aliter) {
-    sglEmissiveMaterial(aliter->intensity.r, aliter->intensity.g,
-                        aliter->intensity.b, aliter->atten.x, aliter->atten.y,
-                        aliter->atten.z);
-
-    /// store all polygons (converted into triangles)
-    const NFFStore::TriangleList &tlist = aliter->geometry;
-    NFFStore::TriangleList::const_iterator titer = tlist.begin();
-    for (; titer != tlist.end(); ++titer) {
-      const NFFStore::Triangle &t = *titer;
-      sglBegin(SGL_POLYGON);
-      for (int i = 0; i < 3; i++)
-        sglVertex3f(t.vertices[i].x, t.vertices[i].y, t.vertices[i].z);
-      sglEnd();
-    }
-  }
+  timer.Restart();
 
-  if (nffstore.envMap.cols) {
-    sglEnvironmentMap(nffstore.envMap.width, nffstore.envMap.height,
-                      nffstore.envMap.cols);
+  if (envMap.cols) {
+    sglEnvironmentMap(envMap.width, envMap.height, envMap.cols);
   }
 
   sglEndScene();
@@ -952,7 +930,7 @@ float RayTraceScene(const char *scenename, unsigned int iter = 1) {
 
   sglAreaMode(SGL_FILL);
   sglEnable(SGL_DEPTH_TEST);
-  sglClearColor(nffstore.bg_col.r, nffstore.bg_col.g, nffstore.bg_col.b, 1);
+  sglClearColor(header.background[0], header.background[1], header.background[2], 1);
   sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
 
   // set the viewport transform
@@ -962,14 +940,14 @@ float RayTraceScene(const char *scenename, unsigned int iter = 1) {
   // note that the resolution stored in the nff file is ignored
   sglMatrixMode(SGL_PROJECTION);
   sglLoadIdentity();
-  sgluPerspective(nffstore.angle, (float)Width / Height, 1.0, 1800.0);
+  sgluPerspective(header.angle, (float)Width / Height, 1.0, 1800.0);
 
   // modelview transformation
   sglMatrixMode(SGL_MODELVIEW);
   sglLoadIdentity();
-  sgluLookAt(nffstore.from.x, nffstore.from.y, nffstore.from.z, nffstore.at.x,
-             nffstore.at.y, nffstore.at.z, nffstore.up.x, nffstore.up.y,
-             nffstore.up.z);
+  sgluLookAt(header.from[0], header.from[1], header.from[2], header.at[0],
+             header.at[1], header.at[2], header.up[0], header.up[1],
+             header.up[2]);
 
   // compute a ray traced image and store it in the color buffer
   for (unsigned int i = 0; i < iter; i++)
@@ -1256,11 +1234,15 @@ int main(int argc, char **argv) {
     timer.Restart();
 
     sglSetContext(_contexts[5]);
+    sglEnable(SGL_DEFERRED_RASTER);
     sglClearColor(0, 0, 0, 1);
     sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
     for (unsigned int i = 0; i < (runMultiplier > 1 ? 15 * runMultiplier : 1);
          i++)
       DrawTestScene2C();
+    // polygons are rasterized by tiles in parallel here
+    sglFlush();
+    sglDisable(SGL_DEFERRED_RASTER);
 
     double time = timer.RealTime();
     totalTime += time;
@@ -1277,20 +1259,12 @@ int main(int argc, char **argv) {
     /// read in the NFF file
     const char *scenename = "cornell-spheres.nff";
 
-    FILE *f = fopen(scenename, "rt");
-    if (!f) {
-      cerr << "Could not open " << scenename << " for reading." << std::endl;
-      return 2;
-    }
-
     char errstring[4000];
-    if (ReadNFF(f, errstring, &nffstore) < 0) {
+    if (ReadNFF(scenename, errstring, &nffstore, std::thread::hardware_concurrency()) < 0) {
       cerr << "Error in NFF file " << scenename << ":\n"
            << errstring << std::endl;
-      fclose(f);
       return 2;
     }
-    fclose(f);
 
     cerr << "NFF file " << scenename << " successfully parsed." << endl;
 
@@ -1298,11 +1272,15 @@ int main(int argc, char **argv) {
     timer.Restart();
 
     sglSetContext(_contexts[0]);
+    sglEnable(SGL_DEFERRED_RASTER);
     sglClearColor(0, 0, 0, 1);
     sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
     for (unsigned int i = 0; i < (runMultiplier > 1 ? 15 * runMultiplier : 1);
          i++)
       DrawTestScene2D(nffstore);
+    // polygons are rasterized by tiles in parallel here
+    sglFlush();
+    sglDisable(SGL_DEFERRED_RASTER);
 
     double time = timer.RealTime();
     totalTime += time;
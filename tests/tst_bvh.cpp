@@ -0,0 +1,204 @@
+#include "math/vector.h"
+#include "math/utils.h"
+#include "context/bvh.h"
+#include "context/material.h"
+#include "context/primitive.h"
+#include "context/thread_pool.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace sgl;
+
+static float random01()
+{
+    return static_cast<float>(std::rand()) / RAND_MAX;
+}
+
+static vec3 randomPoint(float scale)
+{
+    return vec3(random01() * scale, random01() * scale, random01() * scale);
+}
+
+// Closest hit found through the hierarchy matches testing every primitive, returns the number of hits
+static int checkTraversal(const Bvh& bvh, const std::vector<std::shared_ptr<Primitive>>& primitives)
+{
+    int hits = 0;
+    for (int i = 0; i < 500; ++i)
+    {
+        Ray ray(randomPoint(100), math::normalize(randomPoint(2) - vec3(1)));
+
+        float bruteForce = std::numeric_limits<float>::max();
+        for (const auto& primitive : primitives)
+        {
+            auto [isIntersected, point, t] = primitive->intersect(ray);
+            if (isIntersected && t < bruteForce)
+            {
+                bruteForce = t;
+            }
+        }
+
+        float closest = std::numeric_limits<float>::max();
+        bvh.traverse(ray, closest, [&](uint32_t first, uint32_t count, float& tMax) {
+            assert(count > 0);
+            for (uint32_t position = first; position < first + count; ++position)
+            {
+                auto [isIntersected, point, t] = primitives[bvh.getPrimitiveIndices()[position]]->intersect(ray);
+                if (isIntersected && t < closest)
+                {
+                    closest = t;
+                    tMax = t;
+                }
+            }
+            return false;
+        });
+
+        assert(closest == bruteForce);
+        hits += closest != std::numeric_limits<float>::max();
+    }
+    return hits;
+}
+
+int main()
+{
+    std::srand(7);
+    std::shared_ptr<Material> mat = std::make_shared<Material>();
+
+    // Enough primitives for the parallel builds to split into several tasks
+    std::vector<std::shared_ptr<Primitive>> primitives;
+    for (int i = 0; i < 6000; ++i)
+    {
+        vec3 v0 = randomPoint(100);
+        primitives.push_back(std::make_shared<Triangle>(mat, v0, v0 + randomPoint(2), v0 + randomPoint(2)));
+    }
+    for (int i = 0; i < 50; ++i)
+    {
+        primitives.push_back(std::make_shared<Sphere>(mat, randomPoint(100), 1 + random01() * 3));
+    }
+
+    std::vector<AABB> bounds;
+    for (const auto& primitive : primitives)
+    {
+        bounds.push_back(primitive->getBounds());
+    }
+
+    ThreadPool threadPool(3);
+    float sahCost[2];
+    for (Bvh::Builder builder : { Bvh::Builder::SAH, Bvh::Builder::LBVH })
+    {
+        Bvh bvh;
+        bvh.build(bounds, builder);
+        assert(!bvh.isEmpty());
+        assert(bvh.getStatistics().builder == builder);
+        int hits = checkTraversal(bvh, primitives);
+
+        // Every primitive is referenced exactly once
+        std::vector<uint32_t> indices = bvh.getPrimitiveIndices();
+        std::sort(indices.begin(), indices.end());
+        for (uint32_t i = 0; i < indices.size(); ++i)
+        {
+            assert(indices[i] == i);
+        }
+
+        // Threads do not change the hierarchy
+        Bvh parallel;
+        parallel.build(bounds, builder, &threadPool);
+        assert(parallel.getPrimitiveIndices() == bvh.getPrimitiveIndices());
+        assert(parallel.getStatistics().nodeCount == bvh.getStatistics().nodeCount);
+        assert(parallel.getStatistics().leafCount == bvh.getStatistics().leafCount);
+        assert(parallel.getStatistics().depth == bvh.getStatistics().depth);
+        assert(parallel.getStatistics().sahCost == bvh.getStatistics().sahCost);
+
+        const Bvh::Statistics& statistics = bvh.getStatistics();
+        assert(statistics.buildTime >= 0);
+        assert(statistics.leafCount >= primitives.size() / Bvh::MAX_LEAF_SIZE);
+        assert(statistics.leafCount <= primitives.size());
+        assert(statistics.maxLeafSize > 0 && statistics.maxLeafSize <= Bvh::MAX_LEAF_SIZE);
+        // Every wide node holds at least two children, leaves or nodes
+        assert(statistics.nodeCount > 0 && statistics.nodeCount < statistics.leafCount);
+        assert(statistics.depth > 1 && statistics.depth <= Bvh::MAX_DEPTH);
+        assert(statistics.sahCost > 1);
+        sahCost[static_cast<int>(builder)] = statistics.sahCost;
+
+        std::cout << (builder == Bvh::Builder::SAH ? "SAH" : "LBVH") << " BVH matches brute force for 500 rays (" << hits << " hits), "
+                  << statistics.nodeCount << " nodes, depth " << statistics.depth << ", cost " << statistics.sahCost << std::endl;
+
+        bvh.clear();
+        assert(bvh.isEmpty());
+        assert(bvh.getStatistics().nodeCount == 0);
+    }
+
+    // The surface area heuristic pays off in traversal cost
+    assert(sahCost[0] < sahCost[1]);
+
+    // Refitting follows moving primitives, first a little and then scattered all over the scene
+    Bvh bvh;
+    bvh.build(bounds);
+    for (float distance : { 0.5f, 100.f })
+    {
+        std::vector<std::shared_ptr<Primitive>> moved;
+        std::vector<AABB> movedBounds;
+        for (int i = 0; i < 6000; ++i)
+        {
+            const Triangle& triangle = static_cast<const Triangle&>(*primitives[i]);
+            const vec3 offset = randomPoint(distance);
+            moved.push_back(std::make_shared<Triangle>(mat, triangle.getVertex(0) + offset, triangle.getVertex(1) + offset, triangle.getVertex(2) + offset));
+            movedBounds.push_back(moved.back()->getBounds());
+        }
+        for (int i = 6000; i < static_cast<int>(primitives.size()); ++i)
+        {
+            moved.push_back(primitives[i]);
+            movedBounds.push_back(bounds[i]);
+        }
+
+        const bool refitted = bvh.refit(movedBounds);
+        const Bvh::Statistics& statistics = bvh.getStatistics();
+        assert(refitted == (distance < 1));
+        assert(statistics.sahCost > statistics.builtSahCost);
+        checkTraversal(bvh, moved);
+        std::cout << "Refitted BVH matches brute force after moving primitives by " << distance << ", cost " << statistics.sahCost << std::endl;
+    }
+
+    // Spheres spaced ever further apart, which the surface area heuristic peels off a few at a time,
+    // still give a hierarchy the traversal stack holds
+    std::vector<std::shared_ptr<Primitive>> spread;
+    std::vector<AABB> spreadBounds;
+    float x = 1;
+    for (int i = 0; i < 1000; ++i)
+    {
+        spread.push_back(std::make_shared<Sphere>(mat, vec3(x, 50, 50), 0.5f));
+        spreadBounds.push_back(spread.back()->getBounds());
+        x *= i < 200 ? 1.4f : 1.f;
+        x += 1;
+    }
+    for (Bvh::Builder builder : { Bvh::Builder::SAH, Bvh::Builder::LBVH })
+    {
+        Bvh deep;
+        deep.build(spreadBounds, builder);
+        assert(deep.getStatistics().depth <= Bvh::MAX_DEPTH);
+        checkTraversal(deep, spread);
+    }
+
+    // Primitives sharing a centroid cannot be binned but still end up in small leaves
+    std::vector<std::shared_ptr<Primitive>> stacked;
+    std::vector<AABB> stackedBounds;
+    for (int i = 0; i < 100; ++i)
+    {
+        stacked.push_back(std::make_shared<Sphere>(mat, vec3(50), 1 + i * 0.1f));
+        stackedBounds.push_back(stacked.back()->getBounds());
+    }
+    for (Bvh::Builder builder : { Bvh::Builder::SAH, Bvh::Builder::LBVH })
+    {
+        Bvh coincident;
+        coincident.build(stackedBounds, builder);
+        assert(coincident.getStatistics().maxLeafSize <= Bvh::MAX_LEAF_SIZE);
+        assert(coincident.getStatistics().leafCount >= stacked.size() / Bvh::MAX_LEAF_SIZE);
+        checkTraversal(coincident, stacked);
+    }
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include "sgl.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 80;
+static const int HEIGHT = 60;
+static const float FAR = 1e6f;
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+static bool isDrawn(const std::vector<float>& buffer, int x, int y)
+{
+    const int idx = 3 * (y * WIDTH + x);
+    return buffer[idx] + buffer[idx + 1] + buffer[idx + 2] > 0;
+}
+
+static int drawnInRow(const std::vector<float>& buffer, int y)
+{
+    int drawn = 0;
+    for (int x = 0; x < WIDTH; ++x)
+    {
+        drawn += isDrawn(buffer, x, y);
+    }
+    return drawn;
+}
+
+static int drawnPixels(const std::vector<float>& buffer)
+{
+    int drawn = 0;
+    for (int y = 0; y < HEIGHT; ++y)
+    {
+        drawn += drawnInRow(buffer, y);
+    }
+    return drawn;
+}
+
+static void polygon(const std::vector<float>& xy, float z)
+{
+    sglBegin(SGL_POLYGON);
+    for (size_t i = 0; i < xy.size(); i += 2)
+    {
+        sglVertex3f(xy[i], xy[i + 1], z);
+    }
+    sglEnd();
+}
+
+// Object coordinates are pixel coordinates, primitives reach far past the buffer
+static void screenSpace()
+{
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglOrtho(0, WIDTH, 0, HEIGHT, -1, 1);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglColor3f(1, 1, 1);
+
+    for (int depthTest = 0; depthTest < 2; ++depthTest)
+    {
+        if (depthTest)
+        {
+            sglEnable(SGL_DEPTH_TEST);
+        }
+        else
+        {
+            sglDisable(SGL_DEPTH_TEST);
+        }
+
+        // A triangle around the buffer covers all of it
+        sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+        sglAreaMode(SGL_FILL);
+        polygon({ -FAR, -FAR, FAR, -FAR, 0, FAR }, 0);
+        const int covered = drawnPixels(colorBuffer());
+        assert(covered == WIDTH * HEIGHT);
+
+        // A concave one too, but for the notch reaching into it from above, which the scanline fill draws
+        sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+        polygon({ -FAR, -FAR, FAR, -FAR, FAR, FAR, 40, 10, -FAR, FAR }, 0);
+        const std::vector<float> concave = colorBuffer();
+        const int belowNotch = drawnInRow(concave, 2);
+        const bool besideNotch = isDrawn(concave, 5, 20) && isDrawn(concave, 75, 20);
+        const bool inNotch = isDrawn(concave, 40, 30);
+        assert(belowNotch == WIDTH);
+        assert(besideNotch);
+        assert(!inNotch);
+
+        // Polygons, lines and points wholly outside leave the buffer as it is
+        sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+        polygon({ FAR, 10, 2 * FAR, 10, 2 * FAR, 20 }, 0);
+        polygon({ -10, -FAR, 10, -FAR, 10, -5 }, 0);
+        sglBegin(SGL_LINES);
+        sglVertex3f(-FAR, -3, 0);
+        sglVertex3f(FAR, -3, 0);
+        sglEnd();
+        sglBegin(SGL_POINTS);
+        sglVertex3f(-FAR, 5, 0);
+        sglVertex3f(5, HEIGHT + 0.5f, 0);
+        sglEnd();
+        const int outside = drawnPixels(colorBuffer());
+        assert(outside == 0);
+
+        // A line across reaches both sides of the buffer
+        sglAreaMode(SGL_LINE);
+        sglBegin(SGL_LINES);
+        sglVertex3f(-FAR, 10.5f, 0);
+        sglVertex3f(FAR, 10.5f, 0);
+        sglEnd();
+        const std::vector<float> across = colorBuffer();
+        const int lineRow = drawnInRow(across, 10);
+        const int linePixels = drawnPixels(across);
+        assert(lineRow == WIDTH && linePixels == WIDTH);
+    }
+    sglDisable(SGL_DEPTH_TEST);
+}
+
+// A floor from behind the camera to far ahead of it, below the eye
+static void behindCamera()
+{
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.4f, 0.4f, -0.3f, 0.3f, 1, 100);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglColor3f(0.5f, 0.8f, 0.2f);
+    sglAreaMode(SGL_FILL);
+
+    for (int depthTest = 0; depthTest < 2; ++depthTest)
+    {
+        if (depthTest)
+        {
+            sglEnable(SGL_DEPTH_TEST);
+        }
+        else
+        {
+            sglDisable(SGL_DEPTH_TEST);
+        }
+
+        // The floor is seen up to its far edge, which lies below the horizon at the middle row
+        sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+        sglBegin(SGL_POLYGON);
+        sglVertex3f(-100, -1, 5);
+        sglVertex3f(100, -1, 5);
+        sglVertex3f(100, -1, -50);
+        sglVertex3f(-100, -1, -50);
+        sglEnd();
+        const std::vector<float> floor = colorBuffer();
+        const int bottomRow = drawnInRow(floor, 0);
+        const int farRow = drawnInRow(floor, HEIGHT / 2 - 3);
+        assert(bottomRow == WIDTH && farRow == WIDTH);
+        for (int y = HEIGHT / 2; y < HEIGHT; ++y)
+        {
+            const int aboveHorizon = drawnInRow(floor, y);
+            assert(aboveHorizon == 0);
+        }
+
+        // Nothing behind the camera is drawn
+        sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+        sglBegin(SGL_TRIANGLES);
+        sglVertex3f(-1, -1, 2);
+        sglVertex3f(1, -1, 2);
+        sglVertex3f(0, 1, 2);
+        sglEnd();
+        sglAreaMode(SGL_LINE);
+        sglBegin(SGL_LINES);
+        sglVertex3f(-1, 0.1f, 3);
+        sglVertex3f(1, 0.1f, 3);
+        sglEnd();
+        sglBegin(SGL_POINTS);
+        sglVertex3f(0, 0, 3);
+        sglEnd();
+        sglAreaMode(SGL_FILL);
+        const int behind = drawnPixels(colorBuffer());
+        assert(behind == 0);
+    }
+    sglDisable(SGL_DEPTH_TEST);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglClearColor(0, 0, 0, 1);
+
+    screenSpace();
+    behindCamera();
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Primitives are clipped at the near plane and the guard band" << std::endl;
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "sgl.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static const int WIDTH = 120;
+static const int HEIGHT = 100;
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+static void polygon(std::mt19937& rng, int count)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    // Stars go to the scanline fill, which like circles only draws rows inside the buffer
+    const float margin = count > 6 ? 30.f : -10.f;
+    const float cx = margin + (WIDTH - 2 * margin) * unit(rng);
+    const float cy = margin + (HEIGHT - 2 * margin) * unit(rng);
+    const float radius = 3.f + (count > 6 ? 25.f : 50.f) * unit(rng);
+    const float z = unit(rng);
+    sglBegin(SGL_POLYGON);
+    for (int i = 0; i < count; ++i)
+    {
+        // Even corners further out than odd ones make stars of the longer polygons
+        const float angle = 6.2831853f * i / count;
+        const float r = count > 6 && i % 2 ? 0.4f * radius : radius;
+        sglVertex3f(cx + r * std::cos(angle), cy + r * std::sin(angle), -z - 0.1f * std::cos(angle));
+    }
+    sglEnd();
+}
+
+// Polygons, triangles and stars mixed with lines, points, circles and clears, depth tested or not
+static void drawScene(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    sglClearColor(0, 0, 0, 1);
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    for (int i = 0; i < 400; ++i)
+    {
+        sglColor3f(unit(rng), unit(rng), unit(rng));
+        const unsigned kind = rng() % 20;
+        if (kind == 0)
+        {
+            sglEnable(SGL_DEPTH_TEST);
+        }
+        else if (kind == 1)
+        {
+            sglDisable(SGL_DEPTH_TEST);
+        }
+        else if (kind == 2)
+        {
+            sglBegin(SGL_LINES);
+            sglVertex2f(WIDTH * unit(rng), HEIGHT * unit(rng));
+            sglVertex2f(WIDTH * unit(rng), HEIGHT * unit(rng));
+            sglEnd();
+        }
+        else if (kind == 3)
+        {
+            sglCircle(10.f + (WIDTH - 20.f) * unit(rng), 10.f + (HEIGHT - 20.f) * unit(rng), -0.5f, 9.f * unit(rng));
+        }
+        else if (kind == 4 && i % 50 == 4)
+        {
+            sglClear(SGL_DEPTH_BUFFER_BIT);
+        }
+        else if (kind == 5)
+        {
+            polygon(rng, 10);
+        }
+        else if (kind < 10)
+        {
+            sglBegin(SGL_TRIANGLES);
+            for (int v = 0; v < 6; ++v)
+            {
+                sglVertex3f(WIDTH * unit(rng), HEIGHT * unit(rng), -unit(rng));
+            }
+            sglEnd();
+        }
+        else
+        {
+            polygon(rng, 3 + rng() % 4);
+        }
+    }
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    int other = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+
+    // Object coordinates are pixel coordinates
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglOrtho(0, WIDTH, 0, HEIGHT, -1, 1);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglAreaMode(SGL_FILL);
+    sglRenderParameteri(SGL_RENDER_THREADS, 3);
+
+    // Tiles rasterized in parallel leave the buffers drawing right away does
+    for (unsigned seed = 1; seed <= 4; ++seed)
+    {
+        sglDisable(SGL_DEFERRED_RASTER);
+        drawScene(seed);
+        const std::vector<float> expected = colorBuffer();
+
+        sglEnable(SGL_DEFERRED_RASTER);
+        drawScene(seed);
+        sglFlush();
+        const std::vector<float> deferred = colorBuffer();
+        assert(deferred == expected);
+    }
+
+    // Deferring and depth testing are enabled and disabled independently of each other, without the
+    // depth test the polygon drawn last covers the other one
+    sglDisable(SGL_DEPTH_TEST);
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    sglColor3f(1, 0, 0);
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(10, 10, 0.5f);
+    sglVertex3f(60, 10, 0.5f);
+    sglVertex3f(60, 70, 0.5f);
+    sglEnd();
+    sglColor3f(0, 1, 0);
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(10, 10, -0.5f);
+    sglVertex3f(60, 10, -0.5f);
+    sglVertex3f(60, 70, -0.5f);
+    sglEnd();
+    const float* undepthed = sglGetColorBufferPointer();
+    const int inside = 3 * (20 * WIDTH + 50);
+    assert(undepthed[inside] == 0 && undepthed[inside + 1] == 1);
+
+    // Lines behind a polygon are hidden by the depth test
+    sglEnable(SGL_DEPTH_TEST);
+    sglDisable(SGL_DEFERRED_RASTER);
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(10, 10, 0.5f);
+    sglVertex3f(60, 10, 0.5f);
+    sglVertex3f(60, 70, 0.5f);
+    sglEnd();
+    sglColor3f(0, 0, 1);
+    sglBegin(SGL_LINES);
+    sglVertex3f(0, 20.5f, -0.5f);
+    sglVertex3f(WIDTH, 20.5f, -0.5f);
+    sglEnd();
+    const float* depthTested = sglGetColorBufferPointer();
+    const int outside = 3 * (20 * WIDTH + 80);
+    assert(depthTested[inside + 1] == 1 && depthTested[inside + 2] == 0);
+    assert(depthTested[outside + 2] == 1);
+    sglEnable(SGL_DEFERRED_RASTER);
+
+    // Polygons wait for the flush, reading the buffer flushes them too
+    sglEnable(SGL_DEPTH_TEST);
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    const float* data = sglGetColorBufferPointer();
+    sglColor3f(1, 1, 1);
+    sglBegin(SGL_POLYGON);
+    sglVertex2f(10, 10);
+    sglVertex2f(60, 10);
+    sglVertex2f(60, 70);
+    sglEnd();
+    const int idx = 3 * (20 * WIDTH + 50);
+    assert(data[idx] == 0);
+    sglFlush();
+    assert(data[idx] == 1);
+
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    sglBegin(SGL_POLYGON);
+    sglVertex2f(10, 10);
+    sglVertex2f(60, 10);
+    sglVertex2f(60, 70);
+    sglEnd();
+    const float* flushed = sglGetColorBufferPointer();
+    assert(flushed[idx] == 1);
+
+    // sglFinish flushes contexts that are not current as well
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    sglBegin(SGL_POLYGON);
+    sglVertex2f(10, 10);
+    sglVertex2f(60, 10);
+    sglVertex2f(60, 70);
+    sglEnd();
+    assert(data[idx] == 0);
+    sglSetContext(other);
+    sglFinish();
+    assert(data[idx] == 1);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Deferred polygons rasterize by tiles to what drawing them right away does" << std::endl;
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "sgl.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 80;
+static const int HEIGHT = 64;
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+// Coordinates and transformations are multiples of powers of two, so that transforming vertices by
+// the matrices of the list first and by the camera then rounds nothing either way
+static void drawContent()
+{
+    static const float strip[] = { -0.75f, -0.75f, 0, -0.5f, -0.625f, 0.25f, -0.25f, -0.75f, 0.5f, 0, -0.625f, 0.75f };
+    static const unsigned indices[] = { 0, 1, 2, 1, 2, 3 };
+
+    sglEnable(SGL_DEPTH_TEST);
+    sglAreaMode(SGL_FILL);
+    sglColor3f(1, 0, 0);
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(-0.5f, -0.5f, 0.5f);
+    sglVertex3f(0.5f, -0.5f, 0.5f);
+    sglVertex3f(0.5f, 0.5f, -0.5f);
+    sglVertex3f(-0.5f, 0.5f, -0.5f);
+    sglEnd();
+
+    sglPushMatrix();
+    sglTranslate(0.25f, 0.125f, 0);
+    sglScale(0.5f, 0.5f, 1);
+    sglColor3f(0, 1, 0);
+    sglBegin(SGL_TRIANGLES);
+    sglVertex3f(-1, -1, 0.25f);
+    sglVertex3f(1, -1, -0.75f);
+    sglVertex3f(0, 1, 0);
+    sglEnd();
+    sglAreaMode(SGL_LINE);
+    sglColor3f(0, 0, 1);
+    sglCircle(0, 0, 0, 0.75f);
+    sglEllipse(-0.5f, 0.5f, 0, 0.5f, 0.25f);
+    sglPopMatrix();
+
+    sglDisable(SGL_DEPTH_TEST);
+    sglVertexPointer(3, 0, strip);
+    sglColor3f(1, 1, 0);
+    sglDrawElements(SGL_TRIANGLES, 6, indices);
+    sglAreaMode(SGL_FILL);
+    sglArc(0.5f, -0.5f, 0, 0.25f, 0, 3);
+    sglPointSize(3);
+    sglColor3f(1, 0, 1);
+    sglBegin(SGL_POINTS);
+    sglVertex3f(0.75f, 0.75f, 0);
+    sglVertex3f(-0.75f, 0.875f, 0);
+    sglEnd();
+    sglBegin(SGL_LINE_STRIP);
+    sglVertex3f(-1, 0, 0);
+    sglVertex3f(0, 0.25f, 0);
+    sglVertex3f(1, -0.125f, 0);
+    sglEnd();
+}
+
+static void setCamera()
+{
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglOrtho(-1, 1, -1, 1, -1, 1);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0.125f, -0.25f, 0);
+    sglScale(1, 0.5f, 1);
+}
+
+static void resetState()
+{
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    sglColor3f(0, 0, 0);
+    sglAreaMode(SGL_LINE);
+    sglPointSize(1);
+    sglDisable(SGL_DEPTH_TEST);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglClearColor(0, 0, 0, 1);
+
+    resetState();
+    setCamera();
+    drawContent();
+    const std::vector<float> immediate = colorBuffer();
+
+    // Recording draws nothing and leaves the matrices and the state as they were
+    resetState();
+    setCamera();
+    const int list = sglNewList();
+    assert(list >= 0);
+    drawContent();
+    sglTranslate(0.5f, 0, 0);
+    sglEndList();
+    const std::vector<float> cleared(3 * WIDTH * HEIGHT, 0);
+    const std::vector<float> recorded = colorBuffer();
+    assert(recorded == cleared);
+    sglBegin(SGL_POINTS);
+    sglVertex3f(0, 0, 0);
+    sglEnd();
+    const std::vector<float> black = colorBuffer();
+    assert(black == cleared);
+    // The camera maps the origin to x = 1.125 * WIDTH / 2, y = 0.75 * HEIGHT / 2
+    const int origin = 3 * (24 * WIDTH + 45);
+
+    // Called with the camera, the list draws what the calls drew
+    resetState();
+    setCamera();
+    sglCallList(list);
+    const std::vector<float> replayed = colorBuffer();
+    assert(replayed == immediate);
+
+    // The state the list set stays, the modelview it ended with is applied to the current one
+    sglBegin(SGL_POINTS);
+    sglVertex3f(-0.5f, 0, 0);
+    sglEnd();
+    const std::vector<float> magenta = colorBuffer();
+    assert(magenta[origin] == 1 && magenta[origin + 1] == 0 && magenta[origin + 2] == 1);
+
+    // Lists are called any number of times
+    resetState();
+    setCamera();
+    sglCallList(list);
+    const std::vector<float> replayedAgain = colorBuffer();
+    assert(replayedAgain == immediate);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Display lists replay what they recorded" << std::endl;
+    return 0;
+}
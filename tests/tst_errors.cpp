@@ -0,0 +1,36 @@
+#include "sgl.h"
+#include <cassert>
+#include <iostream>
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(32, 32);
+    sglSetContext(id);
+    const sglEErrorCode initial = sglGetError();
+    assert(initial == SGL_NO_ERROR);
+
+    // The first error is kept, the ones after it are dropped until it is read
+    sglEndMesh();
+    sglBeginScene();
+    sglInstance(42);
+    sglEndScene();
+    const sglEErrorCode first = sglGetError();
+    assert(first == SGL_INVALID_OPERATION);
+
+    // Reading the error clears it
+    const sglEErrorCode cleared = sglGetError();
+    assert(cleared == SGL_NO_ERROR);
+
+    sglBeginScene();
+    sglInstance(42);
+    sglEndScene();
+    const sglEErrorCode next = sglGetError();
+    assert(next == SGL_INVALID_VALUE);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "sglGetError reports the first error" << std::endl;
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "sgl.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Not multiples of the tile size, so that tiles are cut by the buffer
+static const int WIDTH = 101;
+static const int HEIGHT = 77;
+
+struct Shape
+{
+    std::vector<float> xy;
+    float z;
+    float color[3];
+};
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+// Quads, triangles and stars of a single depth each, no two at the same depth
+static std::vector<Shape> makeShapes(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<Shape> shapes(300);
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        Shape& shape = shapes[i];
+        shape.z = -0.9f + 1.8f * i / shapes.size();
+        for (float& c : shape.color)
+        {
+            c = unit(rng);
+        }
+        const float cx = -10.f + (WIDTH + 20.f) * unit(rng);
+        const float cy = -10.f + (HEIGHT + 20.f) * unit(rng);
+        const float size = 2.f + 60.f * unit(rng) * unit(rng);
+        const unsigned kind = rng() % 8;
+        if (kind == 0 && cx > 20 && cx < WIDTH - 20 && cy > 20 && cy < HEIGHT - 20)
+        {
+            // Stars go to the scanline fill, which only draws rows inside the buffer
+            for (int k = 0; k < 10; ++k)
+            {
+                const float r = (k % 2 ? 7.f : 18.f) * unit(rng);
+                shape.xy.push_back(cx + r * std::cos(0.6283185f * k));
+                shape.xy.push_back(cy + r * std::sin(0.6283185f * k));
+            }
+        }
+        else if (kind < 4)
+        {
+            shape.xy = { cx, cy, cx + size, cy, cx + size, cy + size, cx, cy + size };
+        }
+        else
+        {
+            shape.xy = { cx, cy, cx + size * unit(rng), cy + size, cx - size * unit(rng), cy + size * unit(rng) };
+        }
+    }
+    std::shuffle(shapes.begin(), shapes.end(), rng);
+    return shapes;
+}
+
+static std::vector<float> draw(const std::vector<Shape>& shapes, const std::vector<size_t>& order)
+{
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+    for (size_t i : order)
+    {
+        const Shape& shape = shapes[i];
+        sglColor3f(shape.color[0], shape.color[1], shape.color[2]);
+        sglBegin(SGL_POLYGON);
+        for (size_t k = 0; k < shape.xy.size(); k += 2)
+        {
+            sglVertex3f(shape.xy[k], shape.xy[k + 1], shape.z);
+        }
+        sglEnd();
+    }
+    return colorBuffer();
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+
+    // Object coordinates are pixel coordinates
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglOrtho(0, WIDTH, 0, HEIGHT, -1, 1);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglAreaMode(SGL_FILL);
+    sglEnable(SGL_DEPTH_TEST);
+    sglRenderParameteri(SGL_RENDER_THREADS, 3);
+
+    // Shapes at distinct depths leave the same image in any order. Drawn from the nearest one, the
+    // farther ones are rejected by the tiles, drawn from the farthest one, every one of them passes.
+    for (unsigned seed = 1; seed <= 4; ++seed)
+    {
+        const std::vector<Shape> shapes = makeShapes(seed);
+        std::vector<size_t> order(shapes.size());
+        std::iota(order.begin(), order.end(), 0);
+        const std::vector<float> expected = draw(shapes, order);
+
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return shapes[a].z < shapes[b].z; });
+        const std::vector<float> nearFirst = draw(shapes, order);
+        assert(nearFirst == expected);
+        std::reverse(order.begin(), order.end());
+        const std::vector<float> farFirst = draw(shapes, order);
+        assert(farFirst == expected);
+
+        sglEnable(SGL_DEFERRED_RASTER);
+        std::reverse(order.begin(), order.end());
+        const std::vector<float> deferredNearFirst = draw(shapes, order);
+        assert(deferredNearFirst == expected);
+        std::reverse(order.begin(), order.end());
+        const std::vector<float> deferredFarFirst = draw(shapes, order);
+        assert(deferredFarFirst == expected);
+        sglDisable(SGL_DEFERRED_RASTER);
+    }
+
+    // Clearing depth uncovers what the tiles hid
+    const std::vector<size_t> one = { 0 };
+    const Shape nearQuad = { { -1, -1, WIDTH + 1.f, -1, WIDTH + 1.f, HEIGHT + 1.f, -1, HEIGHT + 1.f }, -0.5f, { 1, 0, 0 } };
+    const Shape farQuad = { { -1, -1, WIDTH + 1.f, -1, WIDTH + 1.f, HEIGHT + 1.f, -1, HEIGHT + 1.f }, 0.5f, { 0, 1, 0 } };
+    const int center = 3 * (HEIGHT / 2 * WIDTH + WIDTH / 2);
+    const std::vector<float> hidden = draw({ nearQuad }, one);
+    assert(hidden[center] == 1 && hidden[center + 1] == 0);
+    sglClear(SGL_DEPTH_BUFFER_BIT);
+    sglColor3f(0, 1, 0);
+    sglBegin(SGL_POLYGON);
+    for (size_t k = 0; k < farQuad.xy.size(); k += 2)
+    {
+        sglVertex3f(farQuad.xy[k], farQuad.xy[k + 1], farQuad.z);
+    }
+    sglEnd();
+    const std::vector<float> uncovered = colorBuffer();
+    assert(uncovered[center] == 0 && uncovered[center + 1] == 1);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Hierarchical Z rejects only what the depth test would" << std::endl;
+    return 0;
+}
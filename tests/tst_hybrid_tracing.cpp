@@ -0,0 +1,104 @@
+#include "sgl.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 96;
+static const int HEIGHT = 64;
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+// Two triangles, scenes take no other polygons
+static void square(float x, float y, float z, float size)
+{
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(x - size, y - size, z);
+    sglVertex3f(x + size, y - size, z);
+    sglVertex3f(x + size, y + size, z);
+    sglEnd();
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(x - size, y - size, z);
+    sglVertex3f(x + size, y + size, z);
+    sglVertex3f(x - size, y + size, z);
+    sglEnd();
+}
+
+// A mirror sphere and a glass one casting shadows on a wall, with an instanced square in front
+static void buildScene()
+{
+    sglMatrixMode(SGL_MODELVIEW);
+    const int mesh = sglBeginMesh();
+    sglMaterial(0.3f, 0.9f, 0.3f, 0.8f, 0, 1, 0, 1);
+    square(0, 0, 0, 0.6f);
+    sglEndMesh();
+
+    sglBeginScene();
+    sglLoadIdentity();
+    sglMaterial(0.9f, 0.4f, 0.2f, 0.5f, 0.5f, 20, 0, 1);
+    sglSphere(-1, 0, 0, 1.5f);
+    sglMaterial(0.2f, 0.5f, 0.9f, 0.2f, 0.1f, 20, 0.7f, 1.5f);
+    sglSphere(2, 1, 1, 0.8f);
+    sglMaterial(0.8f, 0.8f, 0.8f, 0.9f, 0, 1, 0, 1);
+    square(0, 0, -3, 4);
+    sglTranslate(1.5f, -1.5f, 2);
+    sglInstance(mesh);
+    sglLoadIdentity();
+    sglPointLight(4, 5, 10, 1, 1, 1);
+    sglEndScene();
+
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.3f, 0.3f, -0.2f, 0.2f, 1, 100);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0, 0, -10);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglClearColor(0, 0, 0, 1);
+    sglRenderParameteri(SGL_RENDER_THREADS, 3);
+    // A single sample through the center of each pixel
+    sglRenderParameteri(SGL_RENDER_MAX_SAMPLES, 1);
+    buildScene();
+
+    sglRayTraceScene();
+    const std::vector<float> traced = colorBuffer();
+
+    // Tracing from the rasterized hits leaves the image tracing primary rays does, edges and
+    // silhouettes included
+    sglRenderParameteri(SGL_RENDER_HYBRID, 1);
+    sglRayTraceScene();
+    const std::vector<float> hybrid = colorBuffer();
+    assert(hybrid == traced);
+
+    // Shadow rays are the same whether traced in packets or not
+    sglRenderParameteri(SGL_RENDER_PACKETS, 0);
+    sglRayTraceScene();
+    const std::vector<float> unpacked = colorBuffer();
+    assert(unpacked == hybrid);
+
+    // Jittered samples take the rasterized hits only inside a surface, the image stays the same
+    sglRenderParameteri(SGL_RENDER_PACKETS, 1);
+    sglRenderParameteri(SGL_RENDER_MAX_SAMPLES, 16);
+    sglRayTraceScene();
+    const std::vector<float> sampled = colorBuffer();
+    sglRenderParameteri(SGL_RENDER_HYBRID, 0);
+    sglRayTraceScene();
+    const std::vector<float> tracedSampled = colorBuffer();
+    assert(sampled == tracedSampled);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Hybrid tracing starts from rasterized hits where primary rays would" << std::endl;
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "sgl.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 64;
+static const int HEIGHT = 48;
+static const float ROTATION = 0.7853982f;
+
+static void setupCamera()
+{
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.4f, 0.4f, -0.3f, 0.3f, 1, 100);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0, 0, -12);
+}
+
+// Square facing the camera with a sphere in front of it, given by its center and half size
+static void square(float x, float y, float z, float size)
+{
+    sglMaterial(0.2f, 0.8f, 0.3f, 0.8f, 0.2f, 10, 0, 1);
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(x - size, y - size, z);
+    sglVertex3f(x + size, y - size, z);
+    sglVertex3f(x + size, y + size, z);
+    sglEnd();
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(x - size, y - size, z);
+    sglVertex3f(x + size, y + size, z);
+    sglVertex3f(x - size, y + size, z);
+    sglEnd();
+    sglMaterial(0.9f, 0.3f, 0.1f, 0.7f, 0.3f, 20, 0, 1);
+    sglSphere(x, y, z + size * 0.5f, size * 0.5f);
+}
+
+// Triangle rotated around the y axis the same way sglRotateY() does
+static void triangle(float x, float y, float z, float angle)
+{
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    const float vertices[3][2] = { { -1, -1 }, { 1, -1 }, { 0, 1 } };
+    sglMaterial(0.3f, 0.3f, 0.9f, 0.8f, 0.2f, 10, 0, 1);
+    sglBegin(SGL_POLYGON);
+    for (const auto& vertex : vertices)
+    {
+        sglVertex3f(x + c * vertex[0], y + vertex[1], z + s * vertex[0]);
+    }
+    sglEnd();
+}
+
+static void light()
+{
+    sglPointLight(4, 6, 10, 1, 1, 1);
+}
+
+static std::vector<float> render(int packets)
+{
+    setupCamera();
+    sglRenderParameteri(SGL_RENDER_PACKETS, packets);
+    sglRayTraceScene();
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglRenderParameteri(SGL_RENDER_THREADS, 1);
+
+    // Same geometry placed by instances and specified directly in world space
+    sglMatrixMode(SGL_MODELVIEW);
+    const int squares = sglBeginMesh();
+    square(0, 0, 0, 1);
+    sglEndMesh();
+    const int triangles = sglBeginMesh();
+    triangle(0, 0, 0, 0);
+    sglEndMesh();
+    assert(squares == 0 && triangles == 1);
+
+    sglBeginScene();
+    light();
+    sglLoadIdentity();
+    sglTranslate(-3, 1.5f, 0);
+    const int first = sglInstance(squares);
+    sglLoadIdentity();
+    sglTranslate(2, 1, -2);
+    sglScale(2, 2, 2);
+    sglInstance(squares);
+    sglLoadIdentity();
+    sglTranslate(-1, -2, 1);
+    sglRotateY(ROTATION);
+    const int last = sglInstance(triangles);
+    assert(first == 0 && last == 2);
+    // Unknown meshes are not placed, instances are not moved while the scene is being specified
+    const int unknown = sglInstance(2);
+    const int negative = sglInstance(-1);
+    assert(unknown == -1 && negative == -1);
+    sglGetError();
+    sglInstanceTransform(first);
+    const sglEErrorCode sceneError = sglGetError();
+    assert(sceneError == SGL_INVALID_OPERATION);
+    sglEndScene();
+    std::vector<float> instanced = render(1);
+    std::vector<float> instancedScalar = render(0);
+    assert(instancedScalar == instanced);
+
+    // Moving an instance and changing a mesh renders the same as specifying everything again
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(-2, 0.5f, 1);
+    sglInstanceTransform(first);
+    sglUpdateMesh(triangles);
+    triangle(0.5f, 0, 0, 0);
+    // While a mesh is being specified instances stay in place and nothing is rendered, the mesh has no
+    // hierarchy yet
+    sglInstanceTransform(first);
+    const sglEErrorCode transformError = sglGetError();
+    assert(transformError == SGL_INVALID_OPERATION);
+    sglRayTraceScene();
+    const sglEErrorCode traceError = sglGetError();
+    sglRayTraceSceneProgressive(1);
+    const sglEErrorCode progressiveError = sglGetError();
+    sglRasterizeScene();
+    const sglEErrorCode rasterizeError = sglGetError();
+    assert(traceError == SGL_INVALID_OPERATION);
+    assert(progressiveError == SGL_INVALID_OPERATION);
+    assert(rasterizeError == SGL_INVALID_OPERATION);
+    sglEndMesh();
+    sglInstanceTransform(5);
+    const sglEErrorCode unknownError = sglGetError();
+    assert(unknownError == SGL_INVALID_VALUE);
+    std::vector<float> updated = render(1);
+    assert(updated != instanced);
+
+    const int moved = sglBeginMesh();
+    triangle(0.5f, 0, 0, 0);
+    sglEndMesh();
+    sglBeginScene();
+    light();
+    sglLoadIdentity();
+    sglTranslate(-2, 0.5f, 1);
+    sglInstance(squares);
+    sglLoadIdentity();
+    sglTranslate(2, 1, -2);
+    sglScale(2, 2, 2);
+    sglInstance(squares);
+    sglLoadIdentity();
+    sglTranslate(-1, -2, 1);
+    sglRotateY(ROTATION);
+    sglInstance(moved);
+    sglEndScene();
+    std::vector<float> respecified = render(1);
+    std::vector<float> respecifiedScalar = render(0);
+    assert(respecified == updated && respecifiedScalar == updated);
+
+    sglBeginScene();
+    light();
+    square(-3, 1.5f, 0, 1);
+    square(2, 1, -2, 2);
+    triangle(-1, -2, 1, ROTATION);
+    sglEndScene();
+    std::vector<float> baked = render(1);
+
+    // Transforms round differently than vertices given in world space, only silhouettes may differ
+    size_t covered = 0;
+    size_t different = 0;
+    for (size_t i = 0; i < baked.size(); ++i)
+    {
+        covered += baked[i] != 0;
+        different += std::fabs(baked[i] - instanced[i]) > 0.02f;
+    }
+    assert(covered > baked.size() / 10);
+    assert(different < baked.size() / 100);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Instanced and baked images differ in " << different << " of " << baked.size() << " values" << std::endl;
+
+    return 0;
+}
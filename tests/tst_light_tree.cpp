@@ -0,0 +1,119 @@
+#include "context/light.h"
+#include "context/light_tree.h"
+#include "math/sampler.h"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace sgl;
+
+static float random01()
+{
+    return static_cast<float>(std::rand()) / RAND_MAX;
+}
+
+int main()
+{
+    std::srand(5);
+
+    // A tessellated panel of emitters, plus a faint one far away
+    std::vector<std::unique_ptr<AreaLight>> lights;
+    for (int i = 0; i < 40; ++i)
+    {
+        vec3 v0(random01() * 100, 50, random01() * 100);
+        lights.push_back(std::make_unique<AreaLight>(v0, v0 + vec3(5, 0, 0), v0 + vec3(0, 0, 5), vec3(1 + random01() * 10), 0.f, 0.f, 1.f));
+    }
+    lights.push_back(std::make_unique<AreaLight>(vec3(1e4f), vec3(1e4f) + vec3(1, 0, 0), vec3(1e4f) + vec3(0, 0, 1), vec3(0.1f), 1.f, 0.f, 1.f));
+    const uint32_t farLight = static_cast<uint32_t>(lights.size() - 1);
+
+    std::vector<const AreaLight*> pointers;
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        pointers.push_back(lights[i].get());
+        indices.push_back(static_cast<uint32_t>(i) + 10);
+    }
+
+    LightTree tree;
+    assert(tree.isEmpty());
+    tree.build(pointers, indices);
+    assert(!tree.isEmpty());
+
+    for (int p = 0; p < 20; ++p)
+    {
+        vec3 point(random01() * 100, random01() * 40, random01() * 100);
+
+        // Selection frequencies follow the reported probabilities, which sum to one
+        const int sampleCount = 20000;
+        std::map<uint32_t, int> frequency;
+        std::map<uint32_t, float> probability;
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            uint32_t index;
+            float pdf;
+            bool picked = tree.sample(point, (i + 0.5f) / sampleCount, index, pdf);
+            assert(picked);
+            assert(index >= 10 && index < 10 + lights.size());
+            assert(pdf > 0 && pdf <= 1);
+            ++frequency[index];
+            assert(probability.count(index) == 0 || probability[index] == pdf);
+            probability[index] = pdf;
+        }
+
+        float total = 0;
+        for (const auto& [index, pdf] : probability)
+        {
+            total += pdf;
+            assert(std::abs(frequency[index] / float(sampleCount) - pdf) < 1e-3f);
+        }
+        assert(std::abs(total - 1) < 1e-4f);
+
+        // The faint light cannot contribute anything visible and is culled
+        assert(frequency.count(farLight + 10) == 0);
+        assert(probability.size() == lights.size() - 1);
+    }
+
+    tree.clear();
+    uint32_t index;
+    float pdf;
+    assert(!tree.sample(vec3(0), 0.5f, index, pdf));
+
+    // Area light samples draw their positions and then their light choices, the samples choosing a
+    // light still spread over all of it. Of two lights mirrored about the point, either takes about
+    // half of the samples of a pixel, and those fall on both halves of the light.
+    const AreaLight left(vec3(-5, 10, 0), vec3(-3, 10, 0), vec3(-5, 10, 2), vec3(1), 0.f, 0.f, 1.f);
+    const AreaLight right(vec3(3, 10, 0), vec3(5, 10, 0), vec3(3, 10, 2), vec3(1), 0.f, 0.f, 1.f);
+    tree.build({ &left, &right }, { 0, 1 });
+    int oneSided = 0;
+    for (uint32_t pixel = 0; pixel < 256; ++pixel)
+    {
+        Sampler sampler(pixel, 0);
+        vec2 positions[AreaLight::SAMPLE_NUMBER];
+        float selections[AreaLight::SAMPLE_NUMBER];
+        sampler.next2D(positions, AreaLight::SAMPLE_NUMBER);
+        sampler.next1D(selections, AreaLight::SAMPLE_NUMBER);
+        int chosen[2] = {};
+        int lowerHalf[2] = {};
+        for (int i = 0; i < AreaLight::SAMPLE_NUMBER; ++i)
+        {
+            const bool picked = tree.sample(vec3(0), selections[i], index, pdf);
+            assert(picked && pdf == 0.5f);
+            ++chosen[index];
+            lowerHalf[index] += positions[i].x < 0.5f;
+        }
+        assert(chosen[0] == AreaLight::SAMPLE_NUMBER / 2 && chosen[1] == AreaLight::SAMPLE_NUMBER / 2);
+        for (int light = 0; light < 2; ++light)
+        {
+            oneSided += lowerHalf[light] == 0 || lowerHalf[light] == chosen[light];
+        }
+    }
+    assert(oneSided < 512 / 16);
+
+    std::cout << "Light selection probabilities match frequencies" << std::endl;
+
+    return 0;
+}
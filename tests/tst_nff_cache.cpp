@@ -0,0 +1,88 @@
+#include "nffcache.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static bool parse(const char* fileName, NFFStore& store)
+{
+    FILE* f = fopen(fileName, "rt");
+    if (!f)
+    {
+        return false;
+    }
+    char errstring[4000];
+    const bool ok = ReadNFF(f, errstring, &store) >= 0;
+    fclose(f);
+    return ok;
+}
+
+int main()
+{
+    const char* sceneName = "cornell-blocks-arealight.nff";
+    const char* cacheName = "tst_nff_cache.cache";
+
+    NFFStore store(false);
+    const bool parsed = parse(sceneName, store);
+    assert(parsed);
+    uint64_t hash = 0;
+    const bool hashed = NFFCache::HashFile(sceneName, hash);
+    assert(hashed);
+
+    std::vector<char> buffer = NFFCache::Serialize(store, store.hdrName, hash);
+    const bool written = NFFCache::Write(cacheName, buffer);
+    assert(written);
+
+    // The mapped cache holds the scene as parsed, in the order it was specified
+    NFFCache cache;
+    const bool opened = cache.Open(cacheName, hash);
+    assert(opened);
+    const NFFCacheHeader& header = cache.Header();
+    assert(header.materialCount == store.matgroups.size());
+    assert(header.lightGroupCount == store.lightgroups.size());
+    assert(header.pointLightCount == store.pointLights.size());
+    assert(header.lightGroupCount > 0);
+    assert(header.angle == store.angle && header.from[1] == store.from.y);
+
+    uint32_t triangle = 0;
+    uint32_t g = 0;
+    for (const NFFStore::MaterialGroup& group : store.matgroups)
+    {
+        const NFFCacheMaterial& material = cache.Materials()[g++];
+        assert(material.col[0] == group.material.col.r && material.shine == group.material.shine);
+        assert(material.firstTriangle == triangle && material.triangleCount == group.geometry.size());
+        for (const NFFStore::Triangle& t : group.geometry)
+        {
+            assert(cache.Triangles()[triangle].vertices[2][1] == t.vertices[2].y);
+            ++triangle;
+        }
+    }
+    g = 0;
+    for (const NFFStore::LightGroup& group : store.lightgroups)
+    {
+        const NFFCacheLightGroup& light = cache.LightGroups()[g++];
+        assert(light.intensity[0] == group.intensity.r && light.atten[2] == group.atten.z);
+        assert(light.firstTriangle == triangle && light.triangleCount == group.geometry.size());
+        triangle += light.triangleCount;
+    }
+    assert(header.triangleCount == triangle);
+
+    // Caches of other files are stale
+    const bool openedStale = cache.Open(cacheName, hash + 1);
+    assert(!openedStale);
+
+    // Truncated caches are rejected
+    buffer.resize(buffer.size() - sizeof(NFFCacheTriangle));
+    const bool writtenTruncated = NFFCache::Write(cacheName, buffer);
+    const bool openedTruncated = cache.Open(cacheName, hash);
+    const bool attachedTruncated = cache.Attach(buffer, hash);
+    assert(writtenTruncated && !openedTruncated && !attachedTruncated);
+
+    remove(cacheName);
+    const bool openedRemoved = cache.Open(cacheName, hash);
+    assert(!openedRemoved);
+
+    std::cout << "NFF cache holds " << triangle << " triangles of " << sceneName << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "nffread.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Records every callback as a tag followed by the bits of its values
+class Recorder : public NFFCallbacks
+{
+public:
+    std::vector<float> values;
+    std::string names;
+
+    void Background(const nff_col3& col) override { add(1, { col.r, col.g, col.b }); }
+    void HDRBackground(const char* hdr_name) override
+    {
+        add(2, {});
+        names += hdr_name;
+    }
+    void Camera(const nff_vec3& from, const nff_vec3& at, const nff_vec3& up, const float angle, const float hither, int width, int height) override
+    {
+        add(3, { from.x, from.y, from.z, at.x, at.y, at.z, up.x, up.y, up.z, angle, hither, float(width), float(height) });
+    }
+    void AddPointLight(const nff_vec3& pos, const nff_col3& intensity) override
+    {
+        add(4, { pos.x, pos.y, pos.z, intensity.r, intensity.g, intensity.b });
+    }
+    void SetMaterial(const nff_col3& col, float kd, float ks, float shine, float T, float ior) override
+    {
+        add(5, { col.r, col.g, col.b, kd, ks, shine, T, ior });
+    }
+    void AddSphere(const nff_vec3& c, float r) override { add(6, { c.x, c.y, c.z, r }); }
+    void PolyPatch(const std::vector<nff_vec3>& vertices, const std::vector<nff_vec3>& normals) override
+    {
+        add(7, { float(vertices.size()), float(normals.size()) });
+        for (const nff_vec3& v : vertices)
+        {
+            add(0, { v.x, v.y, v.z });
+        }
+        for (const nff_vec3& n : normals)
+        {
+            add(0, { n.x, n.y, n.z });
+        }
+    }
+    void AreaLightBegin(const nff_col3& intensity, const nff_vec3& atten) override
+    {
+        add(8, { intensity.r, intensity.g, intensity.b, atten.x, atten.y, atten.z });
+    }
+    void AreaLightEnd() override { add(9, {}); }
+
+    bool operator==(const Recorder& other) const
+    {
+        return names == other.names && values.size() == other.values.size()
+            && memcmp(values.data(), other.values.data(), values.size() * sizeof(float)) == 0;
+    }
+
+private:
+    void add(float tag, std::initializer_list<float> list)
+    {
+        values.push_back(tag);
+        values.insert(values.end(), list);
+    }
+};
+
+static int readStream(const char* fileName, Recorder& recorder, std::string& error)
+{
+    FILE* f = fopen(fileName, "rt");
+    assert(f);
+    char errstring[4000] = "";
+    const int ret = ReadNFF(f, errstring, &recorder);
+    fclose(f);
+    error = errstring;
+    return ret;
+}
+
+// Whether both readers, the mapped one with one and with several threads, fail as expected and
+// report the same callbacks and the same error
+static bool compare(const char* fileName, bool fails = false)
+{
+    Recorder stream;
+    std::string streamError;
+    const int streamRet = readStream(fileName, stream, streamError);
+    bool agree = (streamRet < 0) == fails;
+
+    for (int threads : { 1, 4 })
+    {
+        Recorder mapped;
+        char errstring[4000] = "";
+        const int ret = ReadNFF(fileName, errstring, &mapped, threads);
+        agree = agree && (ret < 0) == fails && (!fails || streamError == errstring) && mapped == stream;
+    }
+    return agree;
+}
+
+static void writeFile(const char* fileName, const std::string& text)
+{
+    FILE* f = fopen(fileName, "wt");
+    assert(f);
+    fputs(text.c_str(), f);
+    fclose(f);
+}
+
+// Numbers in the formats scenes are written in, and ones needing care to round correctly
+static std::string number(int i)
+{
+    const float f = float(rand()) / RAND_MAX * 200.f - 100.f;
+    char text[64];
+    switch (i % 8)
+    {
+    case 0: snprintf(text, sizeof(text), "%g", f); break;
+    case 1: snprintf(text, sizeof(text), "%.9g", f); break;
+    case 2: snprintf(text, sizeof(text), "%.17g", double(f) * 1.0000001); break;
+    case 3: snprintf(text, sizeof(text), "%e", f * 1e-30f); break;
+    case 4: snprintf(text, sizeof(text), "%.12e", double(f) * 1e35); break;
+    case 5: snprintf(text, sizeof(text), "%d", int(f)); break;
+    // Halfway between two floats, rounded to even
+    case 6: snprintf(text, sizeof(text), "%.20g", 1.0 + 0x1p-24 * (1 + 2 * (i % 3))); break;
+    default: snprintf(text, sizeof(text), "%+.3f", f); break;
+    }
+    return text;
+}
+
+int main()
+{
+    const char* scenes[] = { "basilica.nff", "cornell-blocks-arealight-color.nff", "cornell-blocks-arealight.nff",
+        "cornell-blocks.nff", "cornell-spheres.nff", "envmap.nff", "floor_sph.nff", "sphere.nff", "test.nff" };
+    for (const char* scene : scenes)
+    {
+        const bool agree = compare(scene);
+        assert(agree);
+    }
+
+    // Long runs of polygons are read by several threads
+    const char* fileName = "tst_nff_read.nff";
+    std::string text = "b 0.1 0.2 0.3\n# comment\nf 1 1 1 0.5 0.5 10 0 1\n";
+    for (int i = 0; i < 10000; ++i)
+    {
+        const bool patch = i % 5 == 0;
+        const int count = 3 + i % 2;
+        text += patch ? "pp " : "p ";
+        text += std::to_string(count) + "\n";
+        for (int j = 0; j < count * (patch ? 6 : 3); ++j)
+        {
+            text += number(i + j) + ((j % 3 == 2) ? "\n" : " ");
+        }
+        if (i == 5000)
+        {
+            text += "L 1 1 1 5 atten 0 0 1\ns 1e-3 -2.5 3 .5\nL 0 0 0 0\nl 1 2 3\n";
+        }
+    }
+
+    writeFile(fileName, text);
+    const bool agreeOnPolygons = compare(fileName);
+    assert(agreeOnPolygons);
+
+    // Errors stop the reader after the same callbacks, with the same message
+    const size_t damaged = text.find("p 3\n", text.size() / 2);
+    text.replace(damaged, 4, "p 3\n1 2 x\n");
+    writeFile(fileName, text);
+    const bool agreeOnNumber = compare(fileName, true);
+    assert(agreeOnNumber);
+
+    writeFile(fileName, "b 1 1 1\nq 1 2 3\n");
+    const bool agreeOnCommand = compare(fileName, true);
+    assert(agreeOnCommand);
+
+    writeFile(fileName, "");
+    const bool agreeOnEmpty = compare(fileName);
+    assert(agreeOnEmpty);
+
+    remove(fileName);
+    std::cout << "Stream and mapped readers agree" << std::endl;
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "nffscene.h"
+#include "nffstore.h"
+#include "sgl.h"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 48;
+static const int HEIGHT = 36;
+
+static void triangles(const NFFStore::TriangleList& list)
+{
+    for (const NFFStore::Triangle& t : list)
+    {
+        sglBegin(SGL_POLYGON);
+        for (const nff_vec3& v : t.vertices)
+        {
+            sglVertex3f(v.x, v.y, v.z);
+        }
+        sglEnd();
+    }
+}
+
+// Specifies the stored scene vertex by vertex, the way the application used to
+static void specify(const NFFStore& store)
+{
+    for (const NFFStore::MaterialGroup& group : store.matgroups)
+    {
+        const NFFStore::Material& m = group.material;
+        sglMaterial(m.col.r, m.col.g, m.col.b, m.kd, m.ks, m.shine, m.T, m.ior);
+        triangles(group.geometry);
+        for (const NFFStore::Sphere& s : group.spheres)
+        {
+            sglSphere(s.center.x, s.center.y, s.center.z, s.radius);
+        }
+    }
+    for (const NFFStore::PointLight& l : store.pointLights)
+    {
+        sglPointLight(l.position.x, l.position.y, l.position.z, l.intensity.r, l.intensity.g, l.intensity.b);
+    }
+    for (const NFFStore::LightGroup& group : store.lightgroups)
+    {
+        sglEmissiveMaterial(group.intensity.r, group.intensity.g, group.intensity.b, group.atten.x, group.atten.y, group.atten.z);
+        triangles(group.geometry);
+    }
+}
+
+static nff_vec3 cross(const nff_vec3& a, const nff_vec3& b)
+{
+    return nff_vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// Camera of the scene with a vertical field of view of its angle, as in the test application
+static std::vector<float> render(const NFFCacheHeader& header)
+{
+    const float h = std::tan(header.angle * 3.1415926f / 360.f);
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-h * WIDTH / HEIGHT, h * WIDTH / HEIGHT, -h, h, 1.0f, 1800.0f);
+
+    const nff_vec3 eye(header.from[0], header.from[1], header.from[2]);
+    const nff_vec3 z = normalize(eye - nff_vec3(header.at[0], header.at[1], header.at[2]));
+    const nff_vec3 x = normalize(cross(nff_vec3(header.up[0], header.up[1], header.up[2]), z));
+    const nff_vec3 y = cross(z, x);
+    const float view[16] = { x.x, y.x, z.x, 0, x.y, y.y, z.y, 0, x.z, y.z, z.z, 0,
+        -eye.x * x.x - eye.y * x.y - eye.z * x.z, -eye.x * y.x - eye.y * y.y - eye.z * y.z, -eye.x * z.x - eye.y * z.y - eye.z * z.z, 1 };
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadMatrix(view);
+
+    sglRayTraceScene();
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+static void compare(const char* sceneName)
+{
+    char errstring[4000];
+
+    // The scene goes to the context while it is parsed
+    NFFScene scene;
+    sglBeginScene();
+    const int streamedRet = ReadNFF(sceneName, errstring, &scene);
+    assert(streamedRet >= 0);
+    scene.Finish();
+    sglEndScene();
+    const std::vector<float> streamed = render(scene.Header());
+    size_t covered = 0;
+    for (float value : streamed)
+    {
+        covered += value != 0;
+    }
+    assert(covered > streamed.size() / 2);
+
+    NFFStore store(false);
+    const int storedRet = ReadNFF(sceneName, errstring, &store);
+    assert(storedRet >= 0);
+    sglBeginScene();
+    specify(store);
+    sglEndScene();
+    const std::vector<float> specified = render(scene.Header());
+    assert(specified == streamed);
+
+    // A cache made of the streamed scene is the one made of the stored scene, and replays the same
+    NFFScene kept(true);
+    sglBeginScene();
+    const int keptRet = ReadNFF(sceneName, errstring, &kept);
+    assert(keptRet >= 0);
+    kept.Finish();
+    sglEndScene();
+    const std::vector<char> buffer = kept.Serialize(7);
+    const std::vector<char> storedBuffer = NFFCache::Serialize(store, store.hdrName, 7);
+    assert(buffer == storedBuffer);
+
+    NFFCache cache;
+    const bool attached = cache.Attach(buffer, 7);
+    assert(attached);
+    sglBeginScene();
+    NFFScene::Replay(cache);
+    sglEndScene();
+    const std::vector<float> replayed = render(cache.Header());
+    assert(replayed == streamed);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglRenderParameteri(SGL_RENDER_THREADS, 1);
+
+    compare("cornell-blocks-arealight.nff");
+    compare("cornell-spheres.nff");
+
+    // Triangles are scene geometry only
+    const float vertices[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+    sglGetError();
+    sglTriangles(1, vertices);
+    const sglEErrorCode error = sglGetError();
+    assert(error == SGL_INVALID_OPERATION);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Streamed scenes render as specified vertex by vertex" << std::endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "sgl.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 48;
+static const int HEIGHT = 32;
+
+static void setupCamera(float z)
+{
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.3f, 0.3f, -0.2f, 0.2f, 1, 100);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0, 0, z);
+}
+
+static void buildScene()
+{
+    sglBeginScene();
+    sglMaterial(1, 0.5f, 0.2f, 0.8f, 0.2f, 10, 0, 1);
+    sglSphere(0, 0, 0, 1.5f);
+    sglSphere(1.5f, 1, -2, 1);
+    sglPointLight(5, 5, 5, 1, 1, 1);
+    sglEndScene();
+}
+
+static int createScene()
+{
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    setupCamera(-10);
+    buildScene();
+    return id;
+}
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+int main()
+{
+    sglInit();
+
+    // Samples added over several calls accumulate exactly as if added at once
+    int first = createScene();
+    sglRenderParameteri(SGL_RENDER_THREADS, 1);
+    assert(sglGetSampleCount() == 0);
+    assert(sglGetNoiseEstimate() == 1.f);
+
+    sglRayTraceSceneProgressive(1);
+    assert(sglGetSampleCount() == 1);
+    assert(sglGetNoiseEstimate() == 1.f);
+    sglRayTraceSceneProgressive(3);
+    sglRayTraceSceneProgressive(4);
+    assert(sglGetSampleCount() == 8);
+    const float noise = sglGetNoiseEstimate();
+    assert(noise > 0 && noise < 1);
+    std::vector<float> incremental = colorBuffer();
+
+    int second = createScene();
+    sglRenderParameteri(SGL_RENDER_THREADS, 3);
+    sglRenderParameteri(SGL_RENDER_TILE_SIZE, 5);
+    sglRayTraceSceneProgressive(8);
+    assert(sglGetSampleCount() == 8);
+    assert(colorBuffer() == incremental);
+
+    // Moving the camera starts the accumulation over
+    setupCamera(-12);
+    sglRayTraceSceneProgressive(2);
+    assert(sglGetSampleCount() == 2);
+
+    // So does a new scene
+    sglBeginScene();
+    sglSphere(0, 0, 0, 1);
+    sglPointLight(5, 5, 5, 1, 1, 1);
+    sglEndScene();
+    assert(sglGetSampleCount() == 0);
+
+    // Invalid sample counts are rejected without touching the accumulation
+    sglRayTraceSceneProgressive(0);
+    assert(sglGetSampleCount() == 0);
+
+    sglSetContext(first);
+    assert(sglGetSampleCount() == 8);
+
+    // Without extra samples the adaptive sampler leaves the first pass, which is the first progressive sample
+    sglRenderParameteri(SGL_RENDER_MAX_SAMPLES, 1);
+    sglRayTraceScene();
+    std::vector<float> centers = colorBuffer();
+    buildScene();
+    sglRayTraceSceneProgressive(1);
+    assert(colorBuffer() == centers);
+
+    // Extra samples only go to pixels that did not converge
+    sglRenderParameteri(SGL_RENDER_MAX_SAMPLES, 16);
+    sglRenderParameterf(SGL_RENDER_NOISE_TARGET, 0.1f);
+    sglRayTraceScene();
+    std::vector<float> adaptive = colorBuffer();
+    size_t changed = 0;
+    for (size_t i = 0; i < adaptive.size(); ++i)
+    {
+        changed += adaptive[i] != centers[i];
+    }
+    assert(changed > 0 && changed < adaptive.size() / 2);
+
+    sglDestroyContext(first);
+    sglDestroyContext(second);
+    sglFinish();
+
+    std::cout << "Noise estimate after 8 samples: " << noise << std::endl;
+
+    return 0;
+}
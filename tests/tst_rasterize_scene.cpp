@@ -0,0 +1,137 @@
+#include "sgl.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 96;
+static const int HEIGHT = 64;
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+// Two triangles, scenes take no other polygons
+static void square(float x, float y, float z, float size)
+{
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(x - size, y - size, z);
+    sglVertex3f(x + size, y - size, z);
+    sglVertex3f(x + size, y + size, z);
+    sglEnd();
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(x - size, y - size, z);
+    sglVertex3f(x + size, y + size, z);
+    sglVertex3f(x - size, y + size, z);
+    sglEnd();
+}
+
+// Spheres in front of a wall and an instanced square, lit from the camera so that the shadows the
+// ray tracer casts stay hidden behind what casts them. Nothing reflects or refracts.
+static void buildScene(int mesh)
+{
+    sglMatrixMode(SGL_MODELVIEW);
+    sglBeginScene();
+    sglLoadIdentity();
+    sglMaterial(0.9f, 0.4f, 0.2f, 0.8f, 0, 1, 0, 1);
+    sglSphere(0, 0, 0, 1.5f);
+    sglMaterial(0.2f, 0.5f, 0.9f, 0.7f, 0, 1, 0, 1);
+    sglSphere(2.5f, 1, -1, 0.8f);
+    sglMaterial(0.8f, 0.8f, 0.8f, 0.9f, 0, 1, 0, 1);
+    square(0, 0, -4, 3);
+    sglTranslate(-2.2f, -1, 1);
+    sglInstance(mesh);
+    sglLoadIdentity();
+    sglPointLight(0, 0, 10, 1, 1, 1);
+    sglEndScene();
+
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.3f, 0.3f, -0.2f, 0.2f, 1, 100);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0, 0, -10);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglRenderParameteri(SGL_RENDER_THREADS, 3);
+    sglClearColor(0, 0, 0, 1);
+
+    sglMatrixMode(SGL_MODELVIEW);
+    const int mesh = sglBeginMesh();
+    sglMaterial(0.3f, 0.9f, 0.3f, 0.8f, 0, 1, 0, 1);
+    square(0, 0, 0, 0.6f);
+    sglEndMesh();
+    buildScene(mesh);
+
+    sglRayTraceSceneProgressive(1);
+    const std::vector<float> traced = colorBuffer();
+    sglClear(SGL_COLOR_BUFFER_BIT);
+    sglRasterizeScene();
+    const std::vector<float> rasterized = colorBuffer();
+
+    // The preview covers the pixels a sample through their center does, up to the edges where the
+    // coverage of the rasterizer takes in pixels the center misses, and shades them alike
+    int covered = 0;
+    int mismatched = 0;
+    int different = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; ++i)
+    {
+        const bool isTraced = traced[3 * i] + traced[3 * i + 1] + traced[3 * i + 2] > 0;
+        const bool isRasterized = rasterized[3 * i] + rasterized[3 * i + 1] + rasterized[3 * i + 2] > 0;
+        if (isTraced != isRasterized)
+        {
+            ++mismatched;
+            continue;
+        }
+        if (isTraced)
+        {
+            ++covered;
+            float error = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                error = std::fmax(error, std::fabs(traced[3 * i + c] - rasterized[3 * i + c]));
+            }
+            different += error > 0.02f;
+        }
+    }
+    assert(covered > WIDTH * HEIGHT / 2);
+    assert(mismatched < WIDTH * HEIGHT / 50);
+    assert(different < covered / 20);
+
+    // The corners see past the wall
+    assert(rasterized[0] == 0 && rasterized[3 * (WIDTH * HEIGHT - 1)] == 0);
+    // The instance is drawn in front of the wall
+    const int instancePixel = 3 * (14 * WIDTH + 9);
+    assert(rasterized[instancePixel] + rasterized[instancePixel + 1] + rasterized[instancePixel + 2] > 0);
+    for (int c = 0; c < 3; ++c)
+    {
+        assert(std::fabs(traced[instancePixel + c] - rasterized[instancePixel + c]) < 0.02f);
+    }
+
+    // The depth buffer holds the scene, polygons drawn afterwards show only in front of it
+    const int center = 3 * (HEIGHT / 2 * WIDTH + WIDTH / 2);
+    sglEnable(SGL_DEPTH_TEST);
+    sglAreaMode(SGL_FILL);
+    sglColor3f(1, 1, 1);
+    square(0, 0, -0.5f, 0.2f);
+    const std::vector<float> behind = colorBuffer();
+    assert(behind == rasterized);
+    square(0, 0, 2, 0.2f);
+    const std::vector<float> inFront = colorBuffer();
+    assert(inFront[center] == 1 && inFront[center + 1] == 1 && inFront[center + 2] == 1);
+    sglDisable(SGL_DEPTH_TEST);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Rasterized scenes preview the ray traced ones" << std::endl;
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include "sgl.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Not multiples of the block size, so that block rows are cut by the buffer
+static const int WIDTH = 70;
+static const int HEIGHT = 45;
+
+struct Vertex
+{
+    float x, y, z;
+};
+
+struct Buffers
+{
+    std::vector<float> color = std::vector<float>(3 * WIDTH * HEIGHT, 0.f);
+    std::vector<float> depth = std::vector<float>(WIDTH * HEIGHT, std::numeric_limits<float>::max());
+};
+
+// Scanline fill the rasterizer has to match, pixels of a row are covered from the floor of the
+// left edge to the ceiling of the right one and depth steps along them
+static void scanline(const std::vector<Vertex>& vertices, const float color[3], bool depthTest, Buffers& buffers)
+{
+    struct Edge
+    {
+        int yMin, yMax;
+        float x, inverseSlope, z, zSlope;
+    };
+
+    std::vector<Edge> edges;
+    int minY = std::numeric_limits<int>::max();
+    int maxY = std::numeric_limits<int>::min();
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        Vertex p1 = vertices[i];
+        Vertex p2 = vertices[(i + 1) % vertices.size()];
+        minY = std::min(minY, static_cast<int>(p1.y));
+        maxY = std::max(maxY, static_cast<int>(p1.y));
+        if (static_cast<int>(p1.y) == static_cast<int>(p2.y))
+        {
+            continue;
+        }
+        if (p1.y > p2.y)
+        {
+            std::swap(p1, p2);
+        }
+        edges.push_back({ static_cast<int>(p1.y), static_cast<int>(p2.y), p1.x, (p2.x - p1.x) / (p2.y - p1.y), p1.z, (p2.z - p1.z) / (p2.y - p1.y) });
+    }
+
+    std::vector<Edge> active;
+    for (int y = minY; y < maxY; ++y)
+    {
+        for (const Edge& edge : edges)
+        {
+            if (edge.yMin == y)
+            {
+                active.push_back(edge);
+            }
+        }
+        active.erase(std::remove_if(active.begin(), active.end(), [y](const Edge& edge) { return edge.yMax <= y; }), active.end());
+        std::sort(active.begin(), active.end(), [](const Edge& e1, const Edge& e2) { return e1.x < e2.x; });
+
+        for (size_t i = 1; y >= 0 && y < HEIGHT && i < active.size(); i += 2)
+        {
+            const int startX = std::max(static_cast<int>(std::floor(active[i - 1].x)), 0);
+            const int endX = std::min(static_cast<int>(std::ceil(active[i].x)), WIDTH);
+            const float zStep = (active[i].z - active[i - 1].z) / (endX - startX);
+            float z = active[i - 1].z;
+            for (int x = startX; x < endX; ++x, z += zStep)
+            {
+                const int idx = y * WIDTH + x;
+                if (depthTest && !(z < buffers.depth[idx]))
+                {
+                    continue;
+                }
+                buffers.depth[idx] = z;
+                std::copy(color, color + 3, buffers.color.begin() + 3 * idx);
+            }
+        }
+
+        for (Edge& edge : active)
+        {
+            edge.x += edge.inverseSlope;
+            edge.z += edge.zSlope;
+        }
+    }
+}
+
+static float cross(const Vertex& o, const Vertex& a, const Vertex& b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Convex hull of random points on a plane of random depth, in either orientation
+static std::vector<Vertex> convexPolygon(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> x(-12.f, WIDTH + 12.f);
+    std::uniform_real_distribution<float> y(-12.f, HEIGHT + 12.f);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::vector<Vertex> points(3 + rng() % 8);
+    const float zx = 0.01f * unit(rng);
+    const float zy = 0.01f * unit(rng);
+    const float z0 = 0.5f * unit(rng);
+    for (Vertex& p : points)
+    {
+        p.x = x(rng);
+        p.y = y(rng);
+        p.z = z0 + zx * p.x + zy * p.y;
+    }
+
+    std::sort(points.begin(), points.end(), [](const Vertex& a, const Vertex& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+    std::vector<Vertex> hull;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const size_t start = hull.size();
+        for (const Vertex& p : points)
+        {
+            while (hull.size() >= start + 2 && cross(hull[hull.size() - 2], hull.back(), p) <= 0)
+            {
+                hull.pop_back();
+            }
+            hull.push_back(p);
+        }
+        hull.pop_back();
+        std::reverse(points.begin(), points.end());
+    }
+    if (rng() % 2)
+    {
+        std::reverse(hull.begin(), hull.end());
+    }
+    return hull;
+}
+
+// Star inside the buffer, which the rasterizer leaves to the scanline fill
+static std::vector<Vertex> starPolygon(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    const float cx = 20.f + 30.f * unit(rng);
+    const float cy = 15.f + 15.f * unit(rng);
+    std::vector<Vertex> star;
+    for (int i = 0; i < 10; ++i)
+    {
+        const float angle = 0.6283185f * i + unit(rng);
+        const float radius = (i % 2 ? 4.f : 14.f) * (0.5f + unit(rng));
+        star.push_back({ std::min(std::max(cx + radius * std::cos(angle), 0.f), WIDTH - 1.f), std::min(std::max(cy + radius * std::sin(angle), 0.f), HEIGHT - 1.f), unit(rng) });
+    }
+    return star;
+}
+
+static void draw(sglEElementType mode, const std::vector<Vertex>& vertices, const float color[3])
+{
+    sglColor3f(color[0], color[1], color[2]);
+    sglBegin(mode);
+    for (const Vertex& v : vertices)
+    {
+        // The orthographic projection maps depth to half its opposite, exactly, which keeps the
+        // depths of the polygons within the frustum
+        sglVertex3f(v.x, v.y, -v.z);
+    }
+    sglEnd();
+}
+
+// Whether the color buffer holds exactly the expected colors
+static bool matches(const Buffers& expected)
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::equal(expected.color.begin(), expected.color.end(), data);
+}
+
+static void compare(bool depthTest, std::mt19937& rng)
+{
+    if (depthTest)
+    {
+        sglEnable(SGL_DEPTH_TEST);
+    }
+    else
+    {
+        sglDisable(SGL_DEPTH_TEST);
+    }
+    sglClearColor(0, 0, 0, 1);
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+
+    Buffers expected;
+    for (int i = 0; i < 300; ++i)
+    {
+        const float color[3] = { (i % 7) / 7.f, (i % 11) / 11.f, (i % 13) / 13.f + 0.01f };
+        std::vector<Vertex> polygon = i % 10 == 9 ? starPolygon(rng) : convexPolygon(rng);
+        if (i % 3 == 0)
+        {
+            polygon.resize(3);
+            draw(SGL_TRIANGLES, polygon, color);
+        }
+        else
+        {
+            draw(SGL_POLYGON, polygon, color);
+        }
+        scanline(polygon, color, depthTest, expected);
+    }
+
+    const bool matched = matches(expected);
+    assert(matched);
+    size_t covered = 0;
+    for (float value : expected.color)
+    {
+        covered += value != 0;
+    }
+    assert(covered > expected.color.size() / 2);
+}
+
+// Edges whose slope is halfway between two steps of their x, the scanline fill rounds each step to
+// the even x and so lands on whole pixels from the first or the second row
+static void halfwaySlopes()
+{
+    sglDisable(SGL_DEPTH_TEST);
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+
+    Buffers expected;
+    const float color[3] = { 1, 1, 1 };
+    const float even = 40.f;
+    const float odd = 40.f + std::ldexp(1.f, -18);
+    const std::vector<Vertex> triangles[2] = {
+        { { even, 0.5f, 0 }, { 60, 4, 0 }, { even - 8 - std::ldexp(1.f, -16), 8.5f, 0 } },
+        { { odd, 20.5f, 0 }, { 20, 24, 0 }, { odd - 8 - std::ldexp(1.f, -16), 28.5f, 0 } }
+    };
+    for (const std::vector<Vertex>& triangle : triangles)
+    {
+        draw(SGL_POLYGON, triangle, color);
+        scanline(triangle, color, false, expected);
+    }
+    const bool matched = matches(expected);
+    assert(matched);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+
+    // Object coordinates are pixel coordinates
+    sglViewport(0, 0, 64, 64);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglOrtho(0, 64, 0, 64, -2, 2);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglAreaMode(SGL_FILL);
+
+    std::mt19937 rng(19);
+    compare(false, rng);
+    compare(true, rng);
+    halfwaySlopes();
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Edge function rasterization covers what the scanline fill does" << std::endl;
+    return 0;
+}
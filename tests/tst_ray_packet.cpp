@@ -0,0 +1,188 @@
+#include "math/vector.h"
+#include "math/utils.h"
+#include "context/bvh.h"
+#include "context/material.h"
+#include "context/primitive.h"
+#include "context/ray_packet.h"
+#include "context/scene_geometry.h"
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace sgl;
+
+static float random01()
+{
+    return static_cast<float>(std::rand()) / RAND_MAX;
+}
+
+static vec3 randomPoint(float scale)
+{
+    return vec3(random01() * scale, random01() * scale, random01() * scale);
+}
+
+int main()
+{
+    std::srand(11);
+    std::shared_ptr<Material> mat = std::make_shared<Material>();
+
+    std::vector<std::shared_ptr<Primitive>> primitives;
+    for (int i = 0; i < 300; ++i)
+    {
+        vec3 v0 = randomPoint(50);
+        primitives.push_back(std::make_shared<Triangle>(mat, v0, v0 + randomPoint(8), v0 + randomPoint(8)));
+    }
+    for (int i = 0; i < 30; ++i)
+    {
+        primitives.push_back(std::make_shared<Sphere>(mat, randomPoint(50), 1 + random01() * 3));
+    }
+
+    std::vector<AABB> bounds;
+    for (const auto& primitive : primitives)
+    {
+        bounds.push_back(primitive->getBounds());
+    }
+
+    Bvh bvh;
+    bvh.build(bounds);
+
+    SceneGeometry geometry;
+    geometry.build(primitives, bvh);
+    const std::vector<uint32_t>& order = bvh.getPrimitiveIndices();
+
+    int hits = 0;
+    for (int i = 0; i < 500; ++i)
+    {
+        // Coherent packet: common origin, directions spread around a random one
+        const int count = 1 + i % RayPacket::SIZE;
+        vec3 origins[RayPacket::SIZE];
+        vec3 dirs[RayPacket::SIZE];
+        float tMax[RayPacket::SIZE];
+        vec3 origin = randomPoint(50);
+        vec3 mainDir = randomPoint(2) - vec3(1);
+        for (int lane = 0; lane < count; ++lane)
+        {
+            origins[lane] = origin;
+            dirs[lane] = math::normalize(mainDir + (randomPoint(0.2f) - vec3(0.1f)));
+            tMax[lane] = std::numeric_limits<float>::max();
+        }
+        RayPacket packet(origins, dirs, tMax, count);
+
+        // Every primitive reports exactly the scalar front face hits for each lane
+        float closest[RayPacket::SIZE];
+        uint32_t closestPrimitive[RayPacket::SIZE];
+        for (int lane = 0; lane < count; ++lane)
+        {
+            closest[lane] = std::numeric_limits<float>::max();
+            closestPrimitive[lane] = ~0u;
+        }
+        for (uint32_t position = 0; position < order.size(); ++position)
+        {
+            const auto& primitive = primitives[order[position]];
+            assert(geometry.getPrimitiveIndex(position) == order[position]);
+
+            vec3x4 points;
+            float4 distances;
+            int mask = geometry.intersect(position, packet, false, points, distances);
+            for (int lane = 0; lane < count; ++lane)
+            {
+                auto [isIntersected, point, t] = primitive->intersect(Ray(origins[lane], dirs[lane]));
+                if (isIntersected && t < closest[lane])
+                {
+                    closest[lane] = t;
+                    closestPrimitive[lane] = order[position];
+                }
+                bool isFront = isIntersected && math::dotProduct(dirs[lane], primitive->getNormal(point)) <= 0;
+                assert(isFront == ((mask & (1 << lane)) != 0));
+                if (isFront)
+                {
+                    assert(point == vec3(points.x[lane], points.y[lane], points.z[lane]));
+                    assert(math::distance(origins[lane], point) == distances[lane]);
+                }
+            }
+        }
+
+        // Four primitives at a time give the same hits as single primitive tests
+        const vec3x4 sharedOrigin = vec3x4::broadcast(origins[0]);
+        const vec3x4 sharedDir = vec3x4::broadcast(dirs[0]);
+        const float occlusionLimit = random01() * 60;
+        for (uint32_t first = 0; first < order.size(); first += 3)
+        {
+            const uint32_t lanes = std::min<uint32_t>(order.size() - first, 4);
+            vec3x4 points;
+            float4 distances;
+            int mask = geometry.intersect(first, lanes, sharedOrigin, sharedDir, false, false, points, distances);
+            int blocked = geometry.occlude(first, lanes, sharedOrigin, sharedDir, float4(occlusionLimit), false);
+            for (uint32_t lane = 0; lane < lanes; ++lane)
+            {
+                auto [isIntersected, point, t] = primitives[order[first + lane]]->intersect(Ray(origins[0], dirs[0]));
+                assert(((mask & (1 << lane)) != 0) == isIntersected);
+                assert(((blocked & (1 << lane)) != 0) == (isIntersected && t < occlusionLimit));
+                if (isIntersected)
+                {
+                    assert(point == vec3(points.x[lane], points.y[lane], points.z[lane]));
+                    assert(math::distance(origins[0], point) == distances[lane]);
+                }
+            }
+        }
+
+        // Occlusion of a packet limited by tMax agrees with single primitive tests
+        float limits[RayPacket::SIZE];
+        for (int lane = 0; lane < count; ++lane)
+        {
+            limits[lane] = random01() * 60;
+        }
+        RayPacket shadowPacket(origins, dirs, limits, count);
+        for (uint32_t position = 0; position < order.size(); ++position)
+        {
+            const auto& primitive = primitives[order[position]];
+            int blocked = geometry.occlude(position, shadowPacket);
+            for (int lane = 0; lane < count; ++lane)
+            {
+                auto [isIntersected, point, t] = primitive->intersect(Ray(origins[lane], dirs[lane]));
+                bool isFront = isIntersected && math::dotProduct(dirs[lane], primitive->getNormal(point)) <= 0;
+                assert(((blocked & (1 << lane)) != 0) == (isFront && t < limits[lane]));
+            }
+        }
+
+        // Packet traversal reaches the closest hit of every lane, on the same primitive
+        float found[RayPacket::SIZE];
+        uint32_t foundPrimitive[RayPacket::SIZE];
+        for (int lane = 0; lane < count; ++lane)
+        {
+            found[lane] = std::numeric_limits<float>::max();
+            foundPrimitive[lane] = ~0u;
+        }
+        bvh.traverse(packet, [&](uint32_t first, uint32_t leafCount, RayPacket& packet) {
+            for (uint32_t position = first; position < first + leafCount; ++position)
+            {
+                const uint32_t index = bvh.getPrimitiveIndices()[position];
+                for (int lane = 0; lane < count; ++lane)
+                {
+                    auto [isIntersected, point, t] = primitives[index]->intersect(Ray(origins[lane], dirs[lane]));
+                    if (isIntersected && t < found[lane])
+                    {
+                        found[lane] = t;
+                        foundPrimitive[lane] = index;
+                        packet.tMax.set(lane, t);
+                    }
+                }
+            }
+        });
+
+        for (int lane = 0; lane < count; ++lane)
+        {
+            assert(found[lane] == closest[lane]);
+            assert(foundPrimitive[lane] == closestPrimitive[lane]);
+            hits += closest[lane] != std::numeric_limits<float>::max();
+        }
+    }
+
+    std::cout << "Packet hits: " << hits << std::endl;
+    assert(hits > 0);
+
+    return 0;
+}
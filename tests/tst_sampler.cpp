@@ -0,0 +1,107 @@
+#include "math/sampler.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using namespace sgl;
+
+// Every point lies in the unit square and every elementary interval of area 1/count (count columns
+// by one row up to one column by count rows) holds exactly one of them
+static bool isStratified(const vec2* points, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!(points[i].x >= 0 && points[i].x < 1 && points[i].y >= 0 && points[i].y < 1))
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t columns = 1; columns <= count; columns *= 2)
+    {
+        const uint32_t rows = count / columns;
+        std::vector<int> cells(count, 0);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t column = static_cast<uint32_t>(points[i].x * columns);
+            uint32_t row = static_cast<uint32_t>(points[i].y * rows);
+            if (++cells[row * columns + column] > 1)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    for (uint32_t pixel : { 0u, 1u, 77u, 123456u })
+    {
+        for (uint32_t sampleIndex = 0; sampleIndex < 8; ++sampleIndex)
+        {
+            Sampler sampler(pixel, sampleIndex);
+            vec2 first[16];
+            vec2 second[16];
+            sampler.next2D(first, 16);
+            sampler.next2D(second, 16);
+            assert(isStratified(first, 16));
+            assert(isStratified(second, 16));
+
+            // Single values are the first coordinates of the points the dimension would give
+            float values[16];
+            Sampler(pixel, sampleIndex).next1D(values, 16);
+            for (int i = 0; i < 16; ++i)
+            {
+                assert(values[i] == first[i].x);
+            }
+
+            // The same pixel sample always gives the same points
+            Sampler again(pixel, sampleIndex);
+            vec2 repeated[16];
+            again.next2D(repeated, 16);
+            for (int i = 0; i < 16; ++i)
+            {
+                assert(repeated[i].x == first[i].x && repeated[i].y == first[i].y);
+            }
+        }
+
+        // Single points of consecutive sample indices are stratified together
+        vec2 points[64];
+        for (uint32_t sampleIndex = 0; sampleIndex < 64; ++sampleIndex)
+        {
+            points[sampleIndex] = Sampler(pixel, sampleIndex, Sampler::PIXEL_DIMENSION).next2D();
+        }
+        assert(isStratified(points, 4));
+        assert(isStratified(points, 16));
+        assert(isStratified(points, 64));
+    }
+
+    // A sample pairs unrelated points of different dimensions. Binned into 4 x 4 cells, the first
+    // coordinates of 16 samples of two dimensions spread over 11 of them on average, where points of
+    // one dimension XOR shifted into the other would fill only 4.
+    int occupied = 0;
+    const int pixels = 256;
+    for (int pixel = 0; pixel < pixels; ++pixel)
+    {
+        Sampler sampler(pixel, 0);
+        vec2 first[16];
+        vec2 second[16];
+        sampler.next2D(first, 16);
+        sampler.next2D(second, 16);
+        bool cells[16] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            cells[static_cast<int>(first[i].x * 4) * 4 + static_cast<int>(second[i].x * 4)] = true;
+        }
+        for (bool cell : cells)
+        {
+            occupied += cell;
+        }
+    }
+    assert(occupied > 10 * pixels);
+
+    std::cout << "Sample sets are stratified and reproducible" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "sgl.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 64;
+static const int HEIGHT = 48;
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+// A wall lit by a point light just above it, with a small sphere between the two whose shadow falls
+// on the middle of the wall
+static void buildScene(bool occluder)
+{
+    sglMatrixMode(SGL_MODELVIEW);
+    sglBeginScene();
+    sglLoadIdentity();
+    sglMaterial(0.8f, 0.8f, 0.8f, 0.9f, 0, 1, 0, 1);
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(-2, -2, 0);
+    sglVertex3f(2, -2, 0);
+    sglVertex3f(2, 2, 0);
+    sglEnd();
+    sglBegin(SGL_POLYGON);
+    sglVertex3f(-2, -2, 0);
+    sglVertex3f(2, 2, 0);
+    sglVertex3f(-2, 2, 0);
+    sglEnd();
+    if (occluder)
+    {
+        sglSphere(0.25f, 0, 0.3f, 0.1f);
+    }
+    sglPointLight(0.5f, 0, 0.6f, 1, 1, 1);
+    sglEndScene();
+
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.3f, 0.3f, -0.2f, 0.2f, 1, 100);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0, 0, -10);
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglClearColor(0, 0, 0, 1);
+    sglRenderParameteri(SGL_RENDER_MAX_SAMPLES, 1);
+    const int center = 3 * (HEIGHT / 2 * WIDTH + WIDTH / 2);
+
+    buildScene(false);
+    sglRayTraceScene();
+    const std::vector<float> lit = colorBuffer();
+    assert(lit[center] > 0);
+
+    // Shadow rays reach up to the light however close it is, so what lies between blocks it
+    buildScene(true);
+    sglRayTraceScene();
+    const std::vector<float> shadowed = colorBuffer();
+    assert(shadowed[center] == 0 && shadowed[center + 1] == 0 && shadowed[center + 2] == 0);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Shadow rays end at their light" << std::endl;
+    return 0;
+}
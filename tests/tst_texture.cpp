@@ -0,0 +1,76 @@
+#include "context/texture.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace sgl;
+
+static bool near(const vec3& a, const vec3& b, float eps = 1e-5f)
+{
+    return std::fabs(a.x - b.x) < eps && std::fabs(a.y - b.y) < eps && std::fabs(a.z - b.z) < eps;
+}
+
+int main()
+{
+    // Odd sizes leave partially filled tiles and repeat texels when reduced
+    const int width = 13;
+    const int height = 6;
+    std::vector<uint8_t> texels(width * height * 3);
+    for (int i = 0; i < width * height; ++i)
+    {
+        texels[i * 3] = static_cast<uint8_t>(i * 3);
+        texels[i * 3 + 1] = static_cast<uint8_t>(255 - i);
+        texels[i * 3 + 2] = static_cast<uint8_t>((i * 37) % 256);
+    }
+
+    Texture texture(texels.data(), width, height);
+    assert(texture.getWidth() == width);
+    assert(texture.getHeight() == height);
+    // 13x6, 6x3, 3x1, 1x1
+    assert(texture.getLevelCount() == 4);
+
+    // The tiled layout returns every texel where it was given
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const uint8_t* rgb = &texels[(y * width + x) * 3];
+            assert(near(texture.fetch(0, x, y), vec3(rgb[0], rgb[1], rgb[2]) / 255.f));
+
+            // Texel centers are sampled exactly without a footprint
+            const vec2 center((x + 0.5f) / width, (y + 0.5f) / height);
+            assert(near(texture.sample(center, 0), texture.fetch(0, x, y)));
+        }
+    }
+
+    // Bilinear filtering halfway between two texels
+    const vec2 between(1.f / width, 0.5f / height);
+    assert(near(texture.sample(between, 0), 0.5f * (texture.fetch(0, 0, 0) + texture.fetch(0, 1, 0))));
+
+    // Levels average their parent
+    const vec3 quad = texture.fetch(0, 2, 2) + texture.fetch(0, 3, 2) + texture.fetch(0, 2, 3) + texture.fetch(0, 3, 3);
+    assert(near(texture.fetch(1, 1, 1), quad / 4, 1.f / 255));
+
+    // A footprint covering the whole texture reads the last level
+    assert(near(texture.sample(vec2(0.3f, 0.7f), 1.f), texture.fetch(3, 0, 0)));
+    // Halfway between levels blends them
+    const vec2 uv(0.5f, 0.5f);
+    const float footprint = std::pow(2.f, 1.5f) / width;
+    assert(near(texture.sample(uv, footprint), 0.5f * (texture.sample(uv, 2.f / width) + texture.sample(uv, 4.f / width))));
+
+    // Every image is loaded once and shared
+    TextureCache& cache = TextureCache::getInstance();
+    std::shared_ptr<const Texture> first = cache.load("test.jpeg");
+    std::shared_ptr<const Texture> again = cache.load("test.jpeg");
+    std::shared_ptr<const Texture> missing = cache.load("missing.jpeg");
+    assert(first && again == first);
+    assert(!missing);
+    cache.clear();
+    std::shared_ptr<const Texture> reloaded = cache.load("test.jpeg");
+    assert(reloaded && reloaded != first);
+
+    std::cout << "Textures keep their texels and filter their mip chain" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "context/thread_pool.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using namespace sgl;
+
+int main()
+{
+    for (uint32_t threadCount : { 1u, 2u, 4u, 7u })
+    {
+        ThreadPool pool(threadCount);
+        assert(pool.getThreadCount() == threadCount);
+
+        // Reuse the same workers for several jobs of different sizes
+        for (uint32_t taskCount : { 0u, 1u, 5u, 1000u })
+        {
+            std::vector<std::atomic<int>> visits(taskCount);
+            std::atomic<bool> validThreadIdx(true);
+            pool.parallelFor(taskCount, [&](uint32_t taskIdx, uint32_t threadIdx) {
+                ++visits[taskIdx];
+                if (threadIdx >= threadCount)
+                {
+                    validThreadIdx = false;
+                }
+            });
+
+            for (const auto& count : visits)
+            {
+                assert(count == 1);
+            }
+            assert(validThreadIdx);
+        }
+    }
+
+    std::cout << "Every task was run exactly once" << std::endl;
+
+    return 0;
+}
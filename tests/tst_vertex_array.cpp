@@ -0,0 +1,168 @@
+#include "sgl.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+static const int WIDTH = 64;
+static const int HEIGHT = 48;
+
+// Positions with a padding float after each of them, so that the stride is not the packed one
+static std::vector<float> positions(int count)
+{
+    std::vector<float> data;
+    for (int i = 0; i < count; ++i)
+    {
+        const float angle = 6.2831853f * i / count;
+        data.push_back(std::cos(angle) * (0.5f + 0.4f * (i % 2)));
+        data.push_back(std::sin(angle) * (0.5f + 0.4f * (i % 2)));
+        data.push_back(-0.2f * i);
+        data.push_back(-1);
+    }
+    return data;
+}
+
+static std::vector<float> colorBuffer()
+{
+    const float* data = sglGetColorBufferPointer();
+    return std::vector<float>(data, data + 3 * WIDTH * HEIGHT);
+}
+
+static void clear()
+{
+    sglClearColor(0, 0, 0, 1);
+    sglClear(SGL_COLOR_BUFFER_BIT | SGL_DEPTH_BUFFER_BIT);
+}
+
+static void immediate(sglEElementType mode, const std::vector<float>& data, const std::vector<unsigned>& indices)
+{
+    sglBegin(mode);
+    for (unsigned index : indices)
+    {
+        sglVertex3f(data[4 * index], data[4 * index + 1], data[4 * index + 2]);
+    }
+    sglEnd();
+}
+
+int main()
+{
+    sglInit();
+    int id = sglCreateContext(WIDTH, HEIGHT);
+    sglSetContext(id);
+
+    sglViewport(0, 0, WIDTH, HEIGHT);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglOrtho(-1.2f, 1.2f, -0.9f, 0.9f, -10, 10);
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglRotate2D(0.3f, 0.1f, 0);
+    sglEnable(SGL_DEPTH_TEST);
+    sglColor3f(0.2f, 0.7f, 0.9f);
+
+    const int count = 12;
+    const std::vector<float> data = positions(count);
+    std::vector<unsigned> all;
+    for (int i = 0; i < count; ++i)
+    {
+        all.push_back(i);
+    }
+    const std::vector<unsigned> fan = { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5, 6, 7, 8 };
+
+    // Arrays draw exactly what the same vertices given one by one do
+    sglVertexPointer(3, 4 * sizeof(float), data.data());
+    const sglEAreaMode areaModes[] = { SGL_POINT, SGL_LINE, SGL_FILL };
+    for (sglEAreaMode areaMode : areaModes)
+    {
+        sglAreaMode(areaMode);
+        for (int mode = SGL_POINTS; mode <= SGL_POLYGON; ++mode)
+        {
+            const sglEElementType element = static_cast<sglEElementType>(mode);
+            clear();
+            immediate(element, data, all);
+            const std::vector<float> expected = colorBuffer();
+            clear();
+            sglDrawArrays(element, 0, count);
+            assert(colorBuffer() == expected);
+
+            clear();
+            immediate(element, data, fan);
+            const std::vector<float> indexed = colorBuffer();
+            clear();
+            sglDrawElements(element, static_cast<int>(fan.size()), fan.data());
+            assert(colorBuffer() == indexed);
+        }
+    }
+
+    // Triangles are independent, the last one is not continued by the leftover vertices
+    sglAreaMode(SGL_FILL);
+    clear();
+    sglDrawArrays(SGL_TRIANGLES, 0, 3);
+    const std::vector<float> one = colorBuffer();
+    clear();
+    sglDrawArrays(SGL_TRIANGLES, 0, 5);
+    assert(colorBuffer() == one);
+    size_t covered = 0;
+    for (float value : one)
+    {
+        covered += value != 0;
+    }
+    assert(covered > 0);
+
+    // Arrays of two coordinates, and calls that are rejected
+    const float square[] = { -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f };
+    sglVertexPointer(2, 0, square);
+    clear();
+    sglBegin(SGL_POLYGON);
+    for (int i = 0; i < 4; ++i)
+    {
+        sglVertex2f(square[2 * i], square[2 * i + 1]);
+    }
+    sglEnd();
+    const std::vector<float> expected = colorBuffer();
+    clear();
+    sglDrawArrays(SGL_POLYGON, 0, 4);
+    assert(colorBuffer() == expected);
+    sglDrawArrays(SGL_AREA_LIGHT, 0, 4);
+    sglDrawArrays(SGL_POLYGON, -1, 4);
+    sglVertexPointer(5, 0, square);
+    sglVertexPointer(2, 0, nullptr);
+    sglDrawArrays(SGL_POLYGON, 0, 4);
+    assert(colorBuffer() == expected);
+
+    // Scene triangles from arrays are the ones given vertex by vertex
+    sglMatrixMode(SGL_MODELVIEW);
+    sglLoadIdentity();
+    sglTranslate(0, 0, -4);
+    sglMatrixMode(SGL_PROJECTION);
+    sglLoadIdentity();
+    sglFrustum(-0.4f, 0.4f, -0.3f, 0.3f, 1, 100);
+    sglRenderParameteri(SGL_RENDER_THREADS, 1);
+
+    sglBeginScene();
+    sglPointLight(2, 3, 5, 1, 1, 1);
+    sglMaterial(0.8f, 0.4f, 0.2f, 0.8f, 0.2f, 10, 0, 1);
+    for (size_t i = 0; i + 2 < fan.size(); i += 3)
+    {
+        immediate(SGL_POLYGON, data, { fan[i], fan[i + 1], fan[i + 2] });
+    }
+    sglEndScene();
+    sglRayTraceScene();
+    const std::vector<float> specified = colorBuffer();
+
+    sglVertexPointer(4, 0, data.data());
+    sglBeginScene();
+    sglPointLight(2, 3, 5, 1, 1, 1);
+    sglMaterial(0.8f, 0.4f, 0.2f, 0.8f, 0.2f, 10, 0, 1);
+    sglDrawElements(SGL_LINES, 2, fan.data());
+    sglDrawElements(SGL_TRIANGLES, static_cast<int>(fan.size()), fan.data());
+    sglEndScene();
+    sglRayTraceScene();
+    assert(colorBuffer() == specified);
+
+    sglDestroyContext(id);
+    sglFinish();
+
+    std::cout << "Vertex arrays draw as vertices given one by one" << std::endl;
+    return 0;
+}